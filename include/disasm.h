@@ -0,0 +1,106 @@
+#ifndef DISASM_H
+#define DISASM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * C interface of libdisasm, for disassembling in-process instead of running disasm per file.
+ *
+ * Call disasm_init once to load the opcode reference, which every image then shares. An open
+ * image is never modified, so any number of threads may decode and format it at once.
+ * Strings and buffers are always owned by the caller or by the image they came from.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__GNUC__)
+#define DISASM_API __attribute__((visibility("default")))
+#else
+#define DISASM_API
+#endif
+
+/* Bumped whenever a declaration in this header changes incompatibly */
+#define DISASM_API_VERSION 1
+
+typedef enum disasm_status
+{
+	DISASM_OK = 0,
+	DISASM_ERROR_ARGUMENT, /* A null pointer, or a section or offset out of range */
+	DISASM_ERROR_NOT_INITIALISED, /* disasm_init hasn't succeeded yet */
+	DISASM_ERROR_REFERENCE, /* The reference CSVs couldn't be read */
+	DISASM_ERROR_FORMAT, /* The buffer isn't a supported executable */
+	DISASM_ERROR_BUFFER_TOO_SMALL,
+	DISASM_ERROR_INTERNAL
+} disasm_status;
+
+typedef enum disasm_flow
+{
+	DISASM_FLOW_SEQUENTIAL = 0,
+	DISASM_FLOW_CALL,
+	DISASM_FLOW_JUMP,
+	DISASM_FLOW_CONDITIONAL_JUMP,
+	DISASM_FLOW_INDIRECT_JUMP,
+	DISASM_FLOW_RETURN,
+	DISASM_FLOW_HALT
+} disasm_flow;
+
+typedef struct disasm_image disasm_image;
+
+typedef struct disasm_section
+{
+	const char * name; /* Valid until the image is closed */
+	uint64_t address; /* Virtual address of the first byte */
+	uint64_t size;
+	int code; /* Non-zero for sections holding code */
+} disasm_section;
+
+typedef struct disasm_instruction
+{
+	uint64_t address;
+	uint64_t target; /* Destination of a relative jump or call, 0 if there isn't one */
+	uint32_t offset; /* From the start of the section */
+	uint16_t reference_id; /* Position in the opcode reference, 0 if the bytes didn't decode */
+	uint8_t size;
+	uint8_t prefix_count;
+	uint8_t flow; /* A disasm_flow */
+	uint8_t resolved; /* Zero if the bytes aren't a known instruction */
+	char mnemonic[16]; /* NUL-terminated, cut short if need be */
+} disasm_instruction;
+
+/* Loads the opcode reference from the directory holding x86.csv and secopcd.csv, or from
+ * ../data/ when data_path is null. Once it has succeeded, later calls do nothing */
+DISASM_API disasm_status disasm_init(const char * data_path);
+
+DISASM_API const char * disasm_status_string(disasm_status status);
+
+/* Parses an ELF or PE image, copying what it needs so the buffer can be freed afterwards */
+DISASM_API disasm_status disasm_image_open(const uint8_t * data, size_t size, disasm_image ** image);
+/* Wraps raw machine code as an image with a single code section at the address */
+DISASM_API disasm_status disasm_image_open_raw(const uint8_t * code, size_t size, uint64_t address, disasm_image ** image);
+DISASM_API void disasm_image_close(disasm_image * image);
+
+/* Code sections come first, each group sorted by address */
+DISASM_API size_t disasm_section_count(const disasm_image * image);
+DISASM_API disasm_status disasm_section_get(const disasm_image * image, size_t index, disasm_section * section);
+
+/* Decodes up to capacity instructions from the section, starting at offset, which must be an
+ * instruction boundary. Decoding continues from the end of the last instruction, and *count
+ * is 0 once the section has been decoded to its end */
+DISASM_API disasm_status disasm_decode(const disasm_image * image, size_t section, uint64_t offset,
+	disasm_instruction * instructions, size_t capacity, size_t * count);
+
+/* Writes the Intel syntax listing of the instructions starting in [offset, offset + size) of
+ * the section as NUL-terminated lines, each ending in a newline. *length is set to the length
+ * of the listing without the NUL, and if it doesn't fit, nothing is written and
+ * DISASM_ERROR_BUFFER_TOO_SMALL is returned */
+DISASM_API disasm_status disasm_format(const disasm_image * image, size_t section, uint64_t offset, uint64_t size,
+	char * buffer, size_t capacity, size_t * length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <tuple>
+#include <unordered_map>
+
+#include "diff.h"
+
+// Features found in more functions than this aren't used to find candidate pairs
+const std::size_t MAX_FEATURE_CANDIDATES = 256;
+
+double FingerprintSimilarity(const FunctionFingerprint &a, const FunctionFingerprint &b)
+{
+	if (a.features.empty() && b.features.empty())
+	{
+		return 1.0;
+	}
+
+	// Both are sorted, so the multiset intersection is a single merge
+	std::size_t common = 0;
+	auto i = a.features.begin();
+	auto j = b.features.begin();
+	while (i != a.features.end() && j != b.features.end())
+	{
+		if (*i < *j)
+		{
+			i++;
+		}
+		else if (*j < *i)
+		{
+			j++;
+		}
+		else
+		{
+			common++;
+			i++;
+			j++;
+		}
+	}
+
+	return static_cast<double>(common) / (a.features.size() + b.features.size() - common);
+}
+
+std::vector<FunctionDiff> DiffFunctions(const std::vector<FunctionFingerprint> &oldFuncs,
+	const std::vector<FunctionFingerprint> &newFuncs, double threshold)
+{
+	std::vector<FunctionDiff> diffs {};
+	std::vector<bool> oldMatched(oldFuncs.size());
+	std::vector<bool> newMatched(newFuncs.size());
+
+	// Exact matches, where functions with the same hash are paired up in address order
+	std::unordered_map<uint64_t, std::vector<uint32_t>> byHash {};
+	for (uint32_t n = newFuncs.size(); n-- > 0;)
+	{
+		byHash[newFuncs[n].hash].push_back(n);
+	}
+
+	for (uint32_t o = 0; o < oldFuncs.size(); o++)
+	{
+		auto candidates = byHash.find(oldFuncs[o].hash);
+		if (candidates == byHash.end() || candidates->second.empty())
+		{
+			continue;
+		}
+
+		uint32_t n = candidates->second.back();
+		candidates->second.pop_back();
+		oldMatched[o] = true;
+		newMatched[n] = true;
+		diffs.push_back({DiffStatus::UNCHANGED, oldFuncs[o].address, newFuncs[n].address, 1.0});
+	}
+
+	// Similar functions, only comparing pairs that share at least one feature
+	std::unordered_map<uint64_t, std::vector<uint32_t>> byFeature {};
+	for (uint32_t n = 0; n < newFuncs.size(); n++)
+	{
+		if (newMatched[n])
+		{
+			continue;
+		}
+
+		auto &features = newFuncs[n].features;
+		for (std::size_t f = 0; f < features.size(); f++)
+		{
+			if (f == 0 || features[f] != features[f - 1])
+			{
+				byFeature[features[f]].push_back(n);
+			}
+		}
+	}
+
+	std::vector<std::tuple<double, uint32_t, uint32_t>> pairs {};
+	std::vector<uint32_t> seen(newFuncs.size(), UINT32_MAX);
+	for (uint32_t o = 0; o < oldFuncs.size(); o++)
+	{
+		if (oldMatched[o])
+		{
+			continue;
+		}
+
+		for (auto feature : oldFuncs[o].features)
+		{
+			// Features shared by many functions (a lone ret block) don't narrow anything down
+			auto candidates = byFeature.find(feature);
+			if (candidates == byFeature.end() || candidates->second.size() > MAX_FEATURE_CANDIDATES)
+			{
+				continue;
+			}
+
+			for (auto n : candidates->second)
+			{
+				if (seen[n] == o)
+				{
+					continue;
+				}
+				seen[n] = o;
+
+				double similarity = FingerprintSimilarity(oldFuncs[o], newFuncs[n]);
+				if (similarity >= threshold)
+				{
+					pairs.emplace_back(similarity, o, n);
+				}
+			}
+		}
+	}
+
+	// Most similar pairs claim their functions first
+	std::sort(pairs.begin(), pairs.end(), [](const std::tuple<double, uint32_t, uint32_t> &a, const std::tuple<double, uint32_t, uint32_t> &b)
+	{
+		return std::get<0>(a) > std::get<0>(b) || (std::get<0>(a) == std::get<0>(b) && std::get<1>(a) < std::get<1>(b));
+	});
+
+	for (auto &pair : pairs)
+	{
+		uint32_t o = std::get<1>(pair);
+		uint32_t n = std::get<2>(pair);
+		if (!oldMatched[o] && !newMatched[n])
+		{
+			oldMatched[o] = true;
+			newMatched[n] = true;
+			diffs.push_back({DiffStatus::CHANGED, oldFuncs[o].address, newFuncs[n].address, std::get<0>(pair)});
+		}
+	}
+
+	for (uint32_t o = 0; o < oldFuncs.size(); o++)
+	{
+		if (!oldMatched[o])
+		{
+			diffs.push_back({DiffStatus::REMOVED, oldFuncs[o].address, 0, 0.0});
+		}
+	}
+
+	for (uint32_t n = 0; n < newFuncs.size(); n++)
+	{
+		if (!newMatched[n])
+		{
+			diffs.push_back({DiffStatus::ADDED, 0, newFuncs[n].address, 0.0});
+		}
+	}
+
+	return diffs;
+}
+
+std::string DiffStatusName(DiffStatus status)
+{
+	switch (status)
+	{
+		case DiffStatus::UNCHANGED:
+			return "unchanged";
+		case DiffStatus::CHANGED:
+			return "changed";
+		case DiffStatus::ADDED:
+			return "added";
+		case DiffStatus::REMOVED:
+			return "removed";
+	}
+
+	return "unknown";
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../util/common.h"
+
+// Address independent summary of a function, used to match functions across builds
+struct FunctionFingerprint
+{
+	uint64_t address {};
+	uint64_t hash {}; // Equal for functions that only differ in addresses and immediates
+	uint32_t instrCount {};
+	uint32_t blockCount {};
+	uint32_t edgeCount {};
+	std::vector<uint64_t> features {}; // Sorted, compared as a multiset for similarity
+	std::vector<uint64_t> shingles {}; // Hashes of instruction n-grams, sorted and unique, for MinHash
+};
+
+// Functions with less in common than this are reported as removed and added, not changed
+const double DEFAULT_DIFF_THRESHOLD = 0.5;
+
+enum class DiffStatus : uint8_t
+{
+	UNCHANGED,
+	CHANGED,
+	ADDED,
+	REMOVED
+};
+
+struct FunctionDiff
+{
+	DiffStatus status {};
+	uint64_t oldAddress {}; // Not set for added functions
+	uint64_t newAddress {}; // Not set for removed functions
+	double similarity {};
+};
+
+// Jaccard similarity of the feature multisets, from 0 to 1
+double FingerprintSimilarity(const FunctionFingerprint &a, const FunctionFingerprint &b);
+
+// Pairs functions with identical hashes first, then the remaining functions by similarity
+std::vector<FunctionDiff> DiffFunctions(const std::vector<FunctionFingerprint> &oldFuncs,
+	const std::vector<FunctionFingerprint> &newFuncs, double threshold = DEFAULT_DIFF_THRESHOLD);
+
+std::string DiffStatusName(DiffStatus status);
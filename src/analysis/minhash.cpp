@@ -0,0 +1,357 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "minhash.h"
+#include "../util/hash.h"
+
+namespace
+{
+
+const char INDEX_MAGIC[8] = {'D', 'S', 'M', 'H', 'I', 'D', 'X', '\0'};
+const uint32_t INDEX_VERSION = 1;
+const char CORRUPT_INDEX[] = "A record in the similarity index points outside the file";
+
+uint64_t BandHash(const MinHashSketch &sketch, int band)
+{
+	uint64_t hash = HashMix(band + 1);
+	for (int r = 0; r < LSH_ROWS; r++)
+	{
+		hash = HashCombine(hash, sketch.values[band * LSH_ROWS + r]);
+	}
+
+	return hash;
+}
+
+// Whether count records of recordSize bytes starting at offset end inside a file of the size,
+// worked out so that no product or sum can wrap
+bool Fits(uint64_t offset, uint64_t count, uint64_t recordSize, uint64_t size)
+{
+	return offset <= size && count <= (size - offset) / recordSize;
+}
+
+};
+
+// The file is read in place, so these are laid out without padding surprises: every field is
+// naturally aligned and every record size is a multiple of 8
+struct SimilarityIndex::Header
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t sketchSize;
+	uint32_t bandCount;
+	uint32_t binaryCount;
+	uint64_t functionCount;
+	uint64_t binariesOffset;
+	uint64_t functionsOffset;
+	uint64_t bandsOffset; // bandCount tables of functionCount entries each
+	uint64_t stringsOffset;
+	uint64_t stringsSize;
+};
+
+struct SimilarityIndex::BinaryRecord
+{
+	uint32_t nameOffset;
+	uint32_t nameLength;
+};
+
+struct SimilarityIndex::FunctionRecord
+{
+	uint64_t address;
+	uint32_t binary;
+	uint32_t instrCount;
+	uint32_t nameOffset;
+	uint32_t nameLength;
+	uint32_t sketch[MINHASH_SIZE];
+};
+
+struct SimilarityIndex::BandEntry
+{
+	uint64_t hash;
+	uint32_t function;
+	uint32_t reserved;
+};
+
+MinHashSketch ComputeSketch(const std::vector<uint64_t> &shingles)
+{
+	MinHashSketch sketch {};
+	sketch.values.fill(UINT32_MAX);
+
+	// Each hash function is the shingle mixed with a different seed
+	for (auto shingle : shingles)
+	{
+		for (int h = 0; h < MINHASH_SIZE; h++)
+		{
+			uint32_t value = static_cast<uint32_t>(HashMix(shingle ^ (0x9E3779B97F4A7C15ULL * (h + 1))));
+			sketch.values[h] = std::min(sketch.values[h], value);
+		}
+	}
+
+	return sketch;
+}
+
+double EstimateSimilarity(const MinHashSketch &a, const MinHashSketch &b)
+{
+	int agree = 0;
+	for (int h = 0; h < MINHASH_SIZE; h++)
+	{
+		agree += (a.values[h] == b.values[h]);
+	}
+
+	return static_cast<double>(agree) / MINHASH_SIZE;
+}
+
+// ***** SimilarityIndex *****
+SimilarityIndex::SimilarityIndex(std::string path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	struct stat info {};
+	if (fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(Header))
+	{
+		close(fd);
+		throw std::runtime_error(path + " is not a similarity index");
+	}
+
+	size = info.st_size;
+	void * mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		throw std::runtime_error("Failed to map " + path);
+	}
+
+	data = static_cast<const byte *>(mapping);
+	header = reinterpret_cast<const Header *>(data);
+
+	bool valid = std::memcmp(header->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 && header->version == INDEX_VERSION
+		&& header->sketchSize == MINHASH_SIZE && header->bandCount == LSH_BANDS
+		&& Fits(header->binariesOffset, header->binaryCount, sizeof(BinaryRecord), size)
+		&& Fits(header->functionsOffset, header->functionCount, sizeof(FunctionRecord), size)
+		&& header->functionCount <= UINT32_MAX
+		&& Fits(header->bandsOffset, static_cast<uint64_t>(header->bandCount) * header->functionCount, sizeof(BandEntry), size)
+		&& Fits(header->stringsOffset, header->stringsSize, 1, size);
+
+	if (valid)
+	{
+		binaries = reinterpret_cast<const BinaryRecord *>(data + header->binariesOffset);
+		functions = reinterpret_cast<const FunctionRecord *>(data + header->functionsOffset);
+		bands = reinterpret_cast<const BandEntry *>(data + header->bandsOffset);
+		strings = reinterpret_cast<const char *>(data + header->stringsOffset);
+	}
+
+	if (!valid)
+	{
+		munmap(mapping, size);
+		throw std::runtime_error(path + " is not a similarity index");
+	}
+}
+
+SimilarityIndex::~SimilarityIndex()
+{
+	munmap(const_cast<byte *>(data), size);
+}
+
+void SimilarityIndex::Add(std::string path, std::string binary, const std::vector<IndexedFunction> &functions)
+{
+	std::vector<std::string> binaryNames {};
+	std::vector<uint32_t> owners {};
+	std::vector<IndexedFunction> all {};
+
+	std::ifstream existing {path};
+	if (existing.good())
+	{
+		existing.close();
+		SimilarityIndex index(path);
+		for (uint32_t b = 0; b < index.header->binaryCount; b++)
+		{
+			binaryNames.push_back(index.Name(index.binaries[b].nameOffset, index.binaries[b].nameLength));
+		}
+
+		for (uint32_t f = 0; f < index.header->functionCount; f++)
+		{
+			all.push_back(index.Function(f));
+			owners.push_back(index.Record(f).binary);
+		}
+	}
+
+	uint32_t binaryId = binaryNames.size();
+	binaryNames.push_back(binary);
+	for (auto &func : functions)
+	{
+		all.push_back(func);
+		owners.push_back(binaryId);
+	}
+
+	// Names go into one string blob after the tables
+	std::string blob {};
+	std::vector<BinaryRecord> binaryRecords {};
+	for (auto &name : binaryNames)
+	{
+		binaryRecords.push_back({static_cast<uint32_t>(blob.size()), static_cast<uint32_t>(name.size())});
+		blob += name;
+	}
+
+	std::vector<FunctionRecord> functionRecords(all.size());
+	for (std::size_t f = 0; f < all.size(); f++)
+	{
+		auto &record = functionRecords[f];
+		record.address = all[f].address;
+		record.binary = owners[f];
+		record.instrCount = all[f].instrCount;
+		record.nameOffset = blob.size();
+		record.nameLength = all[f].name.size();
+		std::copy(all[f].sketch.values.begin(), all[f].sketch.values.end(), record.sketch);
+		blob += all[f].name;
+	}
+
+	std::vector<BandEntry> bandEntries {};
+	bandEntries.reserve(LSH_BANDS * all.size());
+	for (int band = 0; band < LSH_BANDS; band++)
+	{
+		auto first = bandEntries.size();
+		for (std::size_t f = 0; f < all.size(); f++)
+		{
+			bandEntries.push_back({BandHash(all[f].sketch, band), static_cast<uint32_t>(f), 0});
+		}
+
+		std::sort(bandEntries.begin() + first, bandEntries.end(), [](const BandEntry &a, const BandEntry &b)
+		{
+			return a.hash < b.hash || (a.hash == b.hash && a.function < b.function);
+		});
+	}
+
+	Header header {};
+	std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+	header.version = INDEX_VERSION;
+	header.sketchSize = MINHASH_SIZE;
+	header.bandCount = LSH_BANDS;
+	header.binaryCount = binaryRecords.size();
+	header.functionCount = functionRecords.size();
+	header.binariesOffset = sizeof(Header);
+	header.functionsOffset = (header.binariesOffset + binaryRecords.size() * sizeof(BinaryRecord) + 7) & ~7ULL;
+	header.bandsOffset = header.functionsOffset + functionRecords.size() * sizeof(FunctionRecord);
+	header.stringsOffset = header.bandsOffset + bandEntries.size() * sizeof(BandEntry);
+	header.stringsSize = blob.size();
+
+	// Written next to the index and renamed over it, so a failed write leaves the old index intact
+	std::string temporary = path + ".tmp";
+	std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+	out.write(reinterpret_cast<const char *>(binaryRecords.data()), binaryRecords.size() * sizeof(BinaryRecord));
+	out.write("\0\0\0\0\0\0\0", header.functionsOffset - header.binariesOffset - binaryRecords.size() * sizeof(BinaryRecord));
+	out.write(reinterpret_cast<const char *>(functionRecords.data()), functionRecords.size() * sizeof(FunctionRecord));
+	out.write(reinterpret_cast<const char *>(bandEntries.data()), bandEntries.size() * sizeof(BandEntry));
+	out.write(blob.data(), blob.size());
+	out.close();
+
+	if (out.fail() || std::rename(temporary.c_str(), path.c_str()) != 0)
+	{
+		throw std::runtime_error("Failed to write " + path);
+	}
+}
+
+std::vector<IndexMatch> SimilarityIndex::Query(const MinHashSketch &sketch, double threshold, std::size_t limit) const
+{
+	std::vector<uint32_t> candidates {};
+	for (int band = 0; band < LSH_BANDS; band++)
+	{
+		uint64_t hash = BandHash(sketch, band);
+		const BandEntry * first = bands + band * header->functionCount;
+		const BandEntry * last = first + header->functionCount;
+
+		auto pos = std::lower_bound(first, last, hash, [](const BandEntry &e, uint64_t h)
+		{
+			return e.hash < h;
+		});
+
+		for (; pos != last && pos->hash == hash; pos++)
+		{
+			if (pos->function >= header->functionCount)
+			{
+				throw std::runtime_error(CORRUPT_INDEX);
+			}
+
+			candidates.push_back(pos->function);
+		}
+	}
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	std::vector<IndexMatch> matches {};
+	for (auto f : candidates)
+	{
+		MinHashSketch other {};
+		std::copy(functions[f].sketch, functions[f].sketch + MINHASH_SIZE, other.values.begin());
+
+		double similarity = EstimateSimilarity(sketch, other);
+		if (similarity >= threshold)
+		{
+			matches.push_back({similarity, f});
+		}
+	}
+
+	std::sort(matches.begin(), matches.end(), [](const IndexMatch &a, const IndexMatch &b)
+	{
+		return a.similarity > b.similarity || (a.similarity == b.similarity && a.function < b.function);
+	});
+
+	if (matches.size() > limit)
+	{
+		matches.resize(limit);
+	}
+
+	return matches;
+}
+
+IndexedFunction SimilarityIndex::Function(uint32_t function) const
+{
+	auto &record = Record(function);
+
+	IndexedFunction func {};
+	func.address = record.address;
+	func.instrCount = record.instrCount;
+	func.name = Name(record.nameOffset, record.nameLength);
+	std::copy(record.sketch, record.sketch + MINHASH_SIZE, func.sketch.values.begin());
+
+	return func;
+}
+
+std::string SimilarityIndex::BinaryName(uint32_t function) const
+{
+	auto &record = binaries[Record(function).binary];
+	return Name(record.nameOffset, record.nameLength);
+}
+
+// Records are only checked when they're read, so that opening an index stays constant time
+const SimilarityIndex::FunctionRecord & SimilarityIndex::Record(uint32_t function) const
+{
+	if (function >= header->functionCount || functions[function].binary >= header->binaryCount)
+	{
+		throw std::runtime_error(CORRUPT_INDEX);
+	}
+
+	return functions[function];
+}
+
+std::string SimilarityIndex::Name(uint32_t offset, uint32_t length) const
+{
+	if (static_cast<uint64_t>(offset) + length > header->stringsSize)
+	{
+		throw std::runtime_error(CORRUPT_INDEX);
+	}
+
+	return std::string(strings + offset, length);
+}
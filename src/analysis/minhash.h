@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "../util/common.h"
+
+// Number of hash functions in a sketch, split into bands of rows for locality-sensitive hashing.
+// Two functions become candidates when all the rows of any one band agree
+const int MINHASH_SIZE = 64;
+const int LSH_BANDS = 16;
+const int LSH_ROWS = MINHASH_SIZE / LSH_BANDS;
+
+// Functions shorter than this are too generic to be worth indexing
+const uint32_t MIN_INDEXED_INSTRUCTIONS = 8;
+
+struct MinHashSketch
+{
+	std::array<uint32_t, MINHASH_SIZE> values {};
+};
+
+MinHashSketch ComputeSketch(const std::vector<uint64_t> &shingles);
+// Fraction of agreeing values, an estimate of the Jaccard similarity of the shingle sets
+double EstimateSimilarity(const MinHashSketch &a, const MinHashSketch &b);
+
+struct IndexedFunction
+{
+	uint64_t address {};
+	uint32_t instrCount {};
+	std::string name {};
+	MinHashSketch sketch {};
+};
+
+struct IndexMatch
+{
+	double similarity {};
+	uint32_t function {}; // Position in the index
+};
+
+class SimilarityIndex
+// On-disk LSH index of function sketches from many binaries. Queries memory-map the file and
+// binary search a table per band that is sorted by band hash, so nothing is copied up front
+{
+public:
+	// Maps an existing index for querying. Only the header is checked here, records are checked
+	// as they're read
+	explicit SimilarityIndex(std::string path);
+	~SimilarityIndex();
+	SimilarityIndex(const SimilarityIndex &) = delete;
+	SimilarityIndex & operator=(const SimilarityIndex &) = delete;
+
+	// Adds the functions of one binary, creating the index if it doesn't exist. The file is
+	// rewritten, so adding is linear in the size of the index
+	static void Add(std::string path, std::string binary, const std::vector<IndexedFunction> &functions);
+
+	std::vector<IndexMatch> Query(const MinHashSketch &sketch, double threshold, std::size_t limit) const;
+
+	// Details of a function returned by Query
+	IndexedFunction Function(uint32_t function) const;
+	std::string BinaryName(uint32_t function) const;
+
+private:
+	struct Header;
+	struct BinaryRecord;
+	struct FunctionRecord;
+	struct BandEntry;
+
+	const FunctionRecord & Record(uint32_t function) const;
+	std::string Name(uint32_t offset, uint32_t length) const;
+
+	const byte * data {};
+	std::size_t size {};
+
+	const Header * header {};
+	const BinaryRecord * binaries {};
+	const FunctionRecord * functions {};
+	const BandEntry * bands {};
+	const char * strings {};
+};
@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <map>
+#include <queue>
+#include <sstream>
+#include <stdexcept>
+
+#include "search.h"
+
+namespace
+{
+
+std::string Trim(const std::string &str)
+{
+	auto begin = str.find_first_not_of(" \t\r");
+	if (begin == std::string::npos)
+	{
+		return "";
+	}
+
+	auto end = str.find_last_not_of(" \t\r");
+	return str.substr(begin, end - begin + 1);
+}
+
+std::vector<std::string> Split(const std::string &str, char sep)
+{
+	std::vector<std::string> parts {};
+	std::stringstream stream(str);
+	for (std::string part {}; std::getline(stream, part, sep); parts.push_back(Trim(part)));
+	return parts;
+}
+
+bool ParseBytePattern(std::stringstream &line, BytePattern &pattern)
+{
+	for (std::string token {}; line >> token;)
+	{
+		if (token == "??" || token == "?")
+		{
+			pattern.bytes.push_back(0);
+			pattern.mask.push_back(false);
+			continue;
+		}
+
+		if (token.size() != 2 || !std::isxdigit(token[0]) || !std::isxdigit(token[1]))
+		{
+			return false;
+		}
+
+		pattern.bytes.push_back(std::stoi(token, nullptr, 16));
+		pattern.mask.push_back(true);
+	}
+
+	return std::find(pattern.mask.begin(), pattern.mask.end(), true) != pattern.mask.end();
+}
+
+bool ParseInstructionPattern(std::stringstream &line, InstructionPattern &pattern)
+{
+	std::string rest {};
+	std::getline(line, rest);
+
+	for (auto &part : Split(rest, ';'))
+	{
+		InstructionPatternElement element {};
+		if (part.empty())
+		{
+			return false;
+		}
+
+		if (part != "*")
+		{
+			auto sep = part.find_first_of(" \t");
+			element.mnemonic = part.substr(0, sep);
+			if (sep != std::string::npos)
+			{
+				element.operands = Split(Trim(part.substr(sep)), ',');
+			}
+		}
+
+		pattern.elements.push_back(element);
+	}
+
+	return !pattern.elements.empty();
+}
+
+};
+
+void LoadSearchPatterns(std::string path, std::vector<BytePattern> &bytePatterns, std::vector<InstructionPattern> &instrPatterns)
+{
+	std::ifstream file {path};
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	int lineNumber = 0;
+	for (std::string text {}; std::getline(file, text);)
+	{
+		lineNumber++;
+		text = Trim(text);
+		if (text.empty() || text[0] == '#')
+		{
+			continue;
+		}
+
+		std::stringstream line(text);
+		std::string kind {};
+		std::string name {};
+		line >> kind >> name;
+
+		bool valid = false;
+		if (kind == "bytes")
+		{
+			BytePattern pattern {name};
+			valid = ParseBytePattern(line, pattern);
+			bytePatterns.push_back(pattern);
+		}
+
+		else if (kind == "insns")
+		{
+			InstructionPattern pattern {name};
+			valid = ParseInstructionPattern(line, pattern);
+			instrPatterns.push_back(pattern);
+		}
+
+		if (!valid || name.empty())
+		{
+			throw std::runtime_error("Invalid pattern on line " + std::to_string(lineNumber) + " of " + path);
+		}
+	}
+}
+
+// ***** PatternMatcher *****
+void PatternMatcher::Add(const BytePattern &pattern)
+{
+	// The longest run of literal bytes makes for the fewest false candidates
+	Anchor anchor {};
+	for (uint32_t i = 0; i < pattern.mask.size();)
+	{
+		if (!pattern.mask[i])
+		{
+			i++;
+			continue;
+		}
+
+		uint32_t end = i;
+		while (end < pattern.mask.size() && pattern.mask[end])
+		{
+			end++;
+		}
+
+		if (end - i > anchor.length)
+		{
+			anchor = {i, end - i};
+		}
+		i = end;
+	}
+
+	if (anchor.length == 0)
+	{
+		throw std::runtime_error("Pattern '" + pattern.name + "' has no literal bytes");
+	}
+
+	patterns.push_back(pattern);
+	anchors.push_back(anchor);
+}
+
+void PatternMatcher::Compile()
+{
+	// Build the trie with maps first, then flatten it
+	std::vector<std::map<byte, uint32_t>> children(1);
+	states = std::vector<State>(1);
+
+	for (uint32_t p = 0; p < patterns.size(); p++)
+	{
+		uint32_t state = 0;
+		for (uint32_t i = anchors[p].offset; i < anchors[p].offset + anchors[p].length; i++)
+		{
+			byte value = patterns[p].bytes[i];
+			auto child = children[state].find(value);
+			if (child == children[state].end())
+			{
+				children[state][value] = children.size();
+				state = children.size();
+				children.emplace_back();
+				states.emplace_back();
+			}
+
+			else
+			{
+				state = child->second;
+			}
+		}
+
+		states[state].patterns.push_back(p);
+	}
+
+	// Failure links in breadth-first order, so a state's failure target is always done before it
+	std::queue<uint32_t> queue {};
+	for (auto &child : children[0])
+	{
+		states[child.second].fail = 0;
+		queue.push(child.second);
+	}
+
+	while (!queue.empty())
+	{
+		uint32_t state = queue.front();
+		queue.pop();
+
+		states[state].output = states[state].patterns.empty() ? states[states[state].fail].output : state;
+
+		for (auto &child : children[state])
+		{
+			uint32_t fail = states[state].fail;
+			while (fail != 0 && children[fail].count(child.first) == 0)
+			{
+				fail = states[fail].fail;
+			}
+
+			auto next = children[fail].find(child.first);
+			states[child.second].fail = (next != children[fail].end()) ? next->second : 0;
+			queue.push(child.second);
+		}
+	}
+
+	edges.clear();
+	for (uint32_t state = 0; state < states.size(); state++)
+	{
+		states[state].edgesBegin = edges.size();
+		for (auto &child : children[state])
+		{
+			edges.push_back({child.first, child.second});
+		}
+		states[state].edgesEnd = edges.size();
+	}
+
+	rootNext.fill(0);
+	for (auto &child : children[0])
+	{
+		rootNext[child.first] = child.second;
+	}
+}
+
+uint32_t PatternMatcher::Next(uint32_t state, byte value) const
+{
+	while (state != 0)
+	{
+		auto first = edges.begin() + states[state].edgesBegin;
+		auto last = edges.begin() + states[state].edgesEnd;
+		auto edge = std::lower_bound(first, last, value, [](const Edge &e, byte v)
+		{
+			return e.value < v;
+		});
+
+		if (edge != last && edge->value == value)
+		{
+			return edge->target;
+		}
+
+		state = states[state].fail;
+	}
+
+	// The root has a transition for every byte
+	return rootNext[value];
+}
+
+bool PatternMatcher::Verify(const BytePattern &pattern, const byte * data) const
+{
+	for (std::size_t i = 0; i < pattern.bytes.size(); i++)
+	{
+		if (pattern.mask[i] && data[i] != pattern.bytes[i])
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void PatternMatcher::Search(const byte * data, std::size_t size, uint64_t address, std::vector<SearchMatch> &matches) const
+{
+	if (states.empty())
+	{
+		return;
+	}
+
+	uint32_t state = 0;
+	for (std::size_t i = 0; i < size; i++)
+	{
+		state = Next(state, data[i]);
+
+		for (uint32_t out = states[state].output; out != NO_STATE; out = states[states[out].fail].output)
+		{
+			for (auto p : states[out].patterns)
+			{
+				// Line the anchor back up with the start of its pattern
+				std::size_t anchorEnd = anchors[p].offset + anchors[p].length;
+				if (i + 1 < anchorEnd)
+				{
+					continue;
+				}
+
+				std::size_t start = i + 1 - anchorEnd;
+				if (start + patterns[p].bytes.size() <= size && Verify(patterns[p], data + start))
+				{
+					matches.push_back({address + start, p});
+				}
+			}
+		}
+	}
+}
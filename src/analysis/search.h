@@ -0,0 +1,90 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "../util/common.h"
+
+// Byte signature with wildcards, where mask is false for bytes that match anything
+struct BytePattern
+{
+	std::string name {};
+	std::vector<byte> bytes {};
+	std::vector<bool> mask {};
+};
+
+// One instruction of an instruction pattern. An empty mnemonic matches any instruction, and
+// empty operands match any operands, otherwise each operand is compared with its listing text
+// ("*" matches any single operand)
+struct InstructionPatternElement
+{
+	std::string mnemonic {};
+	std::vector<std::string> operands {};
+};
+
+struct InstructionPattern
+{
+	std::string name {};
+	std::vector<InstructionPatternElement> elements {};
+};
+
+struct SearchMatch
+{
+	uint64_t address {};
+	uint32_t pattern {}; // Index of the pattern in the list it was given in
+};
+
+// Reads a signature file, where each line is one of
+//	bytes NAME 55 89 E5 ?? ?? 83 EC
+//	insns NAME push ebp; mov ebp,esp; *; call *
+// and lines starting with # are comments
+void LoadSearchPatterns(std::string path, std::vector<BytePattern> &bytePatterns, std::vector<InstructionPattern> &instrPatterns);
+
+class PatternMatcher
+// Aho-Corasick automaton over the longest run of literal bytes in every pattern. A hit on that
+// anchor is then verified against the whole pattern, wildcards included, so any number of
+// patterns is matched in a single pass over the data
+{
+public:
+	void Add(const BytePattern &pattern);
+	// Builds the automaton, must be called after the last Add and before searching
+	void Compile();
+
+	// Appends a match for every pattern occurrence in the data, which is mapped at address
+	void Search(const byte * data, std::size_t size, uint64_t address, std::vector<SearchMatch> &matches) const;
+
+private:
+	struct Edge
+	{
+		byte value;
+		uint32_t target;
+	};
+
+	struct State
+	{
+		uint32_t fail {};
+		uint32_t output {NO_STATE}; // Nearest state on the failure chain, itself included, that ends an anchor
+		uint32_t edgesBegin {};
+		uint32_t edgesEnd {};
+		std::vector<uint32_t> patterns {}; // Patterns whose anchor ends here
+	};
+
+	struct Anchor
+	{
+		uint32_t offset {}; // Position of the anchor in the pattern
+		uint32_t length {};
+	};
+
+	static const uint32_t NO_STATE = UINT32_MAX;
+
+	std::vector<BytePattern> patterns {};
+	std::vector<Anchor> anchors {};
+
+	std::vector<State> states {};
+	std::vector<Edge> edges {}; // Sorted by value within each state
+	std::array<uint32_t, 256> rootNext {};
+
+	uint32_t Next(uint32_t state, byte value) const;
+	bool Verify(const BytePattern &pattern, const byte * data) const;
+};
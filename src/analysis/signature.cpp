@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "signature.h"
+
+namespace
+{
+
+const uint32_t NO_NODE = UINT32_MAX;
+
+bool ParseSignatureLine(const std::string &line, LibrarySignature &signature)
+{
+	std::stringstream stream(line);
+	std::string prefix {};
+	std::string crcLength {};
+	std::string crc {};
+	std::string size {};
+	std::string offset {};
+
+	if (!(stream >> prefix >> crcLength >> crc >> size >> offset >> signature.name) || prefix.size() % 2 != 0)
+	{
+		return false;
+	}
+
+	for (std::size_t i = 0; i < prefix.size(); i += 2)
+	{
+		std::string hex = prefix.substr(i, 2);
+		if (hex == "..")
+		{
+			signature.prefix.push_back(0);
+			signature.mask.push_back(false);
+		}
+
+		else if (std::isxdigit(hex[0]) && std::isxdigit(hex[1]))
+		{
+			signature.prefix.push_back(std::stoi(hex, nullptr, 16));
+			signature.mask.push_back(true);
+		}
+
+		else
+		{
+			return false;
+		}
+	}
+
+	try
+	{
+		signature.crcLength = std::stoi(crcLength, nullptr, 16);
+		signature.crc = std::stoi(crc, nullptr, 16);
+		signature.size = std::stoul(size, nullptr, 16);
+	}
+	catch (const std::exception &e)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+};
+
+uint16_t SignatureCRC16(const byte * data, std::size_t size)
+{
+	uint32_t crc = 0xFFFF;
+	for (std::size_t i = 0; i < size; i++)
+	{
+		uint32_t value = data[i];
+		for (int bit = 0; bit < 8; bit++, value >>= 1)
+		{
+			crc = ((crc ^ value) & 1) ? (crc >> 1) ^ 0x8408 : crc >> 1;
+		}
+	}
+
+	crc = ~crc & 0xFFFF;
+	return static_cast<uint16_t>((crc << 8) | (crc >> 8));
+}
+
+// ***** SignatureTrie *****
+SignatureTrie::SignatureTrie()
+{
+	nodes.emplace_back();
+}
+
+void SignatureTrie::Load(std::string path)
+{
+	std::ifstream file {path};
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open " + path);
+	}
+
+	int lineNumber = 0;
+	for (std::string line {}; std::getline(file, line);)
+	{
+		lineNumber++;
+
+		// The end of a pattern file is marked with a line of dashes
+		if (line.compare(0, 3, "---") == 0)
+		{
+			break;
+		}
+
+		if (line.empty() || line[0] == '#')
+		{
+			continue;
+		}
+
+		LibrarySignature signature {};
+		if (!ParseSignatureLine(line, signature))
+		{
+			throw std::runtime_error("Invalid signature on line " + std::to_string(lineNumber) + " of " + path);
+		}
+
+		Add(signature);
+	}
+}
+
+void SignatureTrie::Add(const LibrarySignature &signature)
+{
+	uint32_t node = 0;
+	for (std::size_t i = 0; i < signature.prefix.size(); i++)
+	{
+		uint16_t key = signature.mask[i] ? signature.prefix[i] : WILDCARD;
+		uint32_t next = Child(node, key);
+		if (next == NO_NODE)
+		{
+			next = nodes.size();
+			auto &children = nodes[node].children;
+			auto pos = std::lower_bound(children.begin(), children.end(), std::make_pair(key, uint32_t(0)));
+			children.insert(pos, {key, next});
+			nodes.emplace_back();
+		}
+
+		node = next;
+	}
+
+	nodes[node].signatures.push_back(signatures.size());
+	signatures.push_back(signature);
+}
+
+std::size_t SignatureTrie::size() const
+{
+	return signatures.size();
+}
+
+uint32_t SignatureTrie::Child(uint32_t node, uint16_t key) const
+{
+	auto &children = nodes[node].children;
+	auto pos = std::lower_bound(children.begin(), children.end(), std::make_pair(key, uint32_t(0)));
+	if (pos != children.end() && pos->first == key)
+	{
+		return pos->second;
+	}
+
+	return NO_NODE;
+}
+
+bool SignatureTrie::VerifyTail(const LibrarySignature &signature, const byte * data, std::size_t available) const
+{
+	std::size_t tailEnd = signature.prefix.size() + signature.crcLength;
+	if (tailEnd > available)
+	{
+		return false;
+	}
+
+	return signature.crcLength == 0 || SignatureCRC16(data + signature.prefix.size(), signature.crcLength) == signature.crc;
+}
+
+void SignatureTrie::Walk(uint32_t node, std::size_t depth, const byte * data, std::size_t available, const LibrarySignature * &best) const
+{
+	// Longer prefixes are more specific, so a match found deeper in the trie wins
+	for (auto s : nodes[node].signatures)
+	{
+		auto &signature = signatures[s];
+		if (VerifyTail(signature, data, available) && (best == nullptr || signature.prefix.size() > best->prefix.size()))
+		{
+			best = &signature;
+		}
+	}
+
+	if (depth >= available)
+	{
+		return;
+	}
+
+	uint32_t exact = Child(node, data[depth]);
+	if (exact != NO_NODE)
+	{
+		Walk(exact, depth + 1, data, available, best);
+	}
+
+	uint32_t wildcard = Child(node, WILDCARD);
+	if (wildcard != NO_NODE)
+	{
+		Walk(wildcard, depth + 1, data, available, best);
+	}
+}
+
+const LibrarySignature * SignatureTrie::Match(const byte * data, std::size_t available) const
+{
+	const LibrarySignature * best = nullptr;
+	Walk(0, 0, data, available, best);
+	return best;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../util/common.h"
+
+// A library function as described by one line of a FLIRT-style .pat file:
+//	558BEC83EC..A1........33C5 1F 6A2B 00A4 :0000 _memcpy
+// The hex prefix has .. where relocations make the byte unknown. The CRC16 covers the given number
+// of bytes directly after the prefix, and the size is the length of the whole function
+struct LibrarySignature
+{
+	std::string name {};
+	std::vector<byte> prefix {};
+	std::vector<bool> mask {}; // False for relocated bytes
+	uint8_t crcLength {};
+	uint16_t crc {};
+	uint32_t size {};
+};
+
+// A function start that matched a signature
+struct LibraryFunction
+{
+	AddressRange range {};
+	std::string name {};
+};
+
+// The CRC16 used by FLIRT pattern files
+uint16_t SignatureCRC16(const byte * data, std::size_t size);
+
+class SignatureTrie
+// Signature prefixes merged into one trie, so matching a function start costs one walk down the
+// trie instead of a comparison against every signature. Relocated bytes are wildcard edges
+{
+public:
+	SignatureTrie();
+
+	// Adds every signature in a .pat file
+	void Load(std::string path);
+	void Add(const LibrarySignature &signature);
+	std::size_t size() const;
+
+	// Returns the most specific signature matching the code at data, or nullptr if none does
+	const LibrarySignature * Match(const byte * data, std::size_t available) const;
+
+private:
+	static const uint16_t WILDCARD = 256;
+
+	struct Node
+	{
+		std::vector<std::pair<uint16_t, uint32_t>> children {}; // Sorted by byte, wildcard last
+		std::vector<uint32_t> signatures {}; // Signatures whose prefix ends here
+	};
+
+	std::vector<Node> nodes {};
+	std::vector<LibrarySignature> signatures {};
+
+	uint32_t Child(uint32_t node, uint16_t key) const;
+	void Walk(uint32_t node, std::size_t depth, const byte * data, std::size_t available, const LibrarySignature * &best) const;
+	bool VerifyTail(const LibrarySignature &signature, const byte * data, std::size_t available) const;
+};
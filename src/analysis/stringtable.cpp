@@ -0,0 +1,158 @@
+#include <algorithm>
+#include <iterator>
+
+#include "stringtable.h"
+#include "../util/simd.h"
+
+namespace
+{
+
+bool TestBit(const std::vector<uint64_t> &bits, std::size_t i)
+{
+	return (bits[i / 64] >> (i % 64)) & 1;
+}
+
+// Index of the first bit at or after from that equals value, or size if there is none
+std::size_t FindBit(const std::vector<uint64_t> &bits, std::size_t from, std::size_t size, bool value)
+{
+	while (from < size)
+	{
+		uint64_t word = value ? bits[from / 64] : ~bits[from / 64];
+		word &= ~0ULL << (from % 64);
+		if (word != 0)
+		{
+			return std::min(size, (from & ~std::size_t(63)) + __builtin_ctzll(word));
+		}
+
+		// Whole words of text or non-text are skipped at once
+		from = (from & ~std::size_t(63)) + 64;
+	}
+
+	return size;
+}
+
+};
+
+// ***** StringTable *****
+void StringTable::Scan(const Segment &data, unsigned int minLength)
+{
+	entries.clear();
+
+	for (auto &section : *data.index)
+	{
+		ScanSection(data.seg->at(section.name), section.range.begin, minLength);
+	}
+
+	std::sort(entries.begin(), entries.end(), [](const StringEntry &a, const StringEntry &b)
+	{
+		return a.address < b.address;
+	});
+}
+
+void StringTable::ScanSection(const std::vector<byte> &data, uint64_t address, unsigned int minLength)
+{
+	std::vector<uint64_t> printable {};
+	std::vector<uint64_t> zero {};
+	ClassifyText(data.data(), data.size(), printable, zero);
+
+	std::size_t size = data.size();
+
+	// ASCII: runs of consecutive printable bytes
+	std::size_t begin = FindBit(printable, 0, size, true);
+	while (begin < size)
+	{
+		std::size_t end = FindBit(printable, begin, size, false);
+		if (end - begin >= minLength)
+		{
+			auto first = data.begin() + begin;
+			entries.push_back({address + begin, static_cast<uint32_t>(end - begin), StringEncoding::ASCII, std::string(first, data.begin() + end)});
+		}
+
+		begin = FindBit(printable, end, size, true);
+	}
+
+	// UTF-16: a bit is set for every printable byte followed by a null byte, and a string is a
+	// run of those bits two bytes apart. A printable byte before one is the end of an ASCII string
+	std::vector<uint64_t> wide(printable.size());
+	for (std::size_t w = 0; w < wide.size(); w++)
+	{
+		uint64_t next = (w + 1 < zero.size()) ? zero[w + 1] << 63 : 0;
+		uint64_t prev = (w > 0) ? printable[w - 1] >> 63 : 0;
+		wide[w] = printable[w] & ((zero[w] >> 1) | next) & ~((printable[w] << 1) | prev);
+	}
+
+	begin = FindBit(wide, 0, size, true);
+	while (begin < size)
+	{
+		std::string text {};
+		std::size_t end = begin;
+		while (end < size && TestBit(wide, end))
+		{
+			text.push_back(data[end]);
+			end += 2;
+		}
+
+		if (text.size() >= minLength)
+		{
+			entries.push_back({address + begin, static_cast<uint32_t>(end - begin), StringEncoding::UTF16, text});
+		}
+
+		begin = FindBit(wide, end, size, true);
+	}
+}
+
+const StringEntry * StringTable::Find(uint64_t address) const
+{
+	auto pos = std::upper_bound(entries.begin(), entries.end(), address, [](uint64_t a, const StringEntry &e)
+	{
+		return a < e.address;
+	});
+
+	if (pos == entries.begin())
+	{
+		return nullptr;
+	}
+
+	pos--;
+	if (address < pos->address + pos->size)
+	{
+		return &(*pos);
+	}
+
+	return nullptr;
+}
+
+const std::vector<StringEntry> & StringTable::Entries() const
+{
+	return entries;
+}
+
+std::string QuoteString(const std::string &text)
+{
+	std::string quoted = "\"";
+	for (char c : text)
+	{
+		switch (c)
+		{
+			case '\n':
+				quoted += "\\n";
+				break;
+			case '\r':
+				quoted += "\\r";
+				break;
+			case '\t':
+				quoted += "\\t";
+				break;
+			case '"':
+				quoted += "\\\"";
+				break;
+			case '\\':
+				quoted += "\\\\";
+				break;
+			default:
+				quoted += c;
+		}
+	}
+
+	return quoted + "\"";
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../util/common.h"
+#include "../format/format.h"
+
+// Shorter runs of printable characters are too likely to be coincidence
+const unsigned int DEFAULT_MIN_STRING_LENGTH = 4;
+
+enum class StringEncoding : uint8_t
+{
+	ASCII,
+	UTF16 // Little-endian, ASCII range only
+};
+
+struct StringEntry
+{
+	uint64_t address {};
+	uint32_t size {}; // In bytes, without the terminator
+	StringEncoding encoding {};
+	std::string text {}; // Narrowed to ASCII for UTF-16 strings
+};
+
+class StringTable
+// Strings found in the data sections of an image, sorted by address
+{
+public:
+	void Scan(const Segment &data, unsigned int minLength = DEFAULT_MIN_STRING_LENGTH);
+
+	// Returns the string containing the address, or nullptr if there is none
+	const StringEntry * Find(uint64_t address) const;
+	const std::vector<StringEntry> & Entries() const;
+
+private:
+	std::vector<StringEntry> entries {};
+
+	void ScanSection(const std::vector<byte> &data, uint64_t address, unsigned int minLength);
+};
+
+// Quoted, with control characters escaped, for listings
+std::string QuoteString(const std::string &text);
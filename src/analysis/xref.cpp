@@ -0,0 +1,84 @@
+#include <algorithm>
+#include <numeric>
+
+#include "xref.h"
+
+void XrefIndex::Add(uint64_t source, uint64_t target, XrefType type)
+{
+	refs.push_back({source, target, type});
+}
+
+void XrefIndex::Finalize()
+{
+	// References are added in decode order, so this is usually already sorted
+	auto bySource = [](const Xref &a, const Xref &b)
+	{
+		return a.source < b.source || (a.source == b.source && a.target < b.target);
+	};
+
+	if (!std::is_sorted(refs.begin(), refs.end(), bySource))
+	{
+		std::stable_sort(refs.begin(), refs.end(), bySource);
+	}
+
+	byTarget.resize(refs.size());
+	std::iota(byTarget.begin(), byTarget.end(), 0);
+	std::stable_sort(byTarget.begin(), byTarget.end(), [&](uint32_t a, uint32_t b)
+	{
+		return refs[a].target < refs[b].target;
+	});
+}
+
+std::vector<Xref> XrefIndex::To(uint64_t target) const
+{
+	auto first = std::lower_bound(byTarget.begin(), byTarget.end(), target, [&](uint32_t i, uint64_t t)
+	{
+		return refs[i].target < t;
+	});
+
+	std::vector<Xref> found {};
+	for (auto i = first; i != byTarget.end() && refs[*i].target == target; i++)
+	{
+		found.push_back(refs[*i]);
+	}
+
+	return found;
+}
+
+std::vector<Xref> XrefIndex::From(uint64_t source) const
+{
+	auto first = std::lower_bound(refs.begin(), refs.end(), source, [](const Xref &x, uint64_t s)
+	{
+		return x.source < s;
+	});
+
+	std::vector<Xref> found {};
+	for (auto i = first; i != refs.end() && i->source == source; i++)
+	{
+		found.push_back(*i);
+	}
+
+	return found;
+}
+
+std::size_t XrefIndex::size() const
+{
+	return refs.size();
+}
+
+std::string XrefTypeName(XrefType type)
+{
+	switch (type)
+	{
+		case XrefType::JUMP:
+			return "jump";
+		case XrefType::CALL:
+			return "call";
+		case XrefType::MEMORY:
+			return "memory";
+		case XrefType::IMMEDIATE:
+			return "immediate";
+	}
+
+	return "unknown";
+}
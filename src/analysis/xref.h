@@ -0,0 +1,41 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../util/common.h"
+
+enum class XrefType : uint8_t
+{
+	JUMP,
+	CALL,
+	MEMORY, // Memory operand addressed by an absolute displacement
+	IMMEDIATE // Immediate value that falls inside a mapped section
+};
+
+struct Xref
+{
+	uint64_t source {}; // Address of the referencing instruction
+	uint64_t target {};
+	XrefType type {};
+};
+
+class XrefIndex
+// Cross references stored once, sorted by source, with an index of positions sorted by target
+// so that both directions are answered with a binary search
+{
+public:
+	void Add(uint64_t source, uint64_t target, XrefType type);
+	// Sorts the references, must be called after the last Add and before any query
+	void Finalize();
+
+	std::vector<Xref> To(uint64_t target) const;
+	std::vector<Xref> From(uint64_t source) const;
+	std::size_t size() const;
+
+private:
+	std::vector<Xref> refs {};
+	std::vector<uint32_t> byTarget {}; // Positions in refs, ordered by target then source
+};
+
+std::string XrefTypeName(XrefType type);
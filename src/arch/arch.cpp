@@ -1,8 +1,45 @@
 #include <iostream>
+#include <algorithm>
+#include <iterator>
 
 #include "arch.h"
 #include "x86/x86.h"
 
+void Arch::SetMappedSections(std::vector<SectionRange> sections)
+{
+	mappedSections = sections;
+}
+
+void Arch::SetStringTable(const StringTable * strings)
+{
+	this->strings = strings;
+}
+
+void Arch::SetLibraryFunctions(const std::vector<LibraryFunction> * library)
+{
+	this->library = library;
+}
+
+void Arch::SetEntryPoints(std::vector<uint64_t> entryPoints)
+{
+	this->entryPoints = entryPoints;
+}
+
+void Arch::SetDataSegment(Segment data)
+{
+	this->data = data;
+}
+
+bool Arch::IsMapped(uint64_t address)
+{
+	auto pos = std::upper_bound(mappedSections.begin(), mappedSections.end(), address, [](uint64_t a, const SectionRange &s)
+	{
+		return a < s.range.begin;
+	});
+
+	return pos != mappedSections.begin() && std::prev(pos)->range.Contains(address);
+}
+
 std::unique_ptr<Arch> Arch::NewArch(Segment seg, ArchType type)
 {
 	switch (type)
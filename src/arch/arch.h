@@ -6,16 +6,69 @@
 
 #include "../util/common.h"
 #include "../format/format.h"
+#include "../analysis/xref.h"
+#include "../analysis/stringtable.h"
+#include "../analysis/search.h"
+#include "../analysis/signature.h"
+#include "../analysis/diff.h"
 
 class Arch
 {
 public:
 	static std::unique_ptr<Arch> NewArch(Segment seg, ArchType type);
+
+	// Sections that references may point into, including data
+	void SetMappedSections(std::vector<SectionRange> sections);
+	// Strings that listings annotate references to, owned by the caller
+	void SetStringTable(const StringTable * strings);
+	// Recognised library functions that listings name, sorted by address and owned by the caller
+	void SetLibraryFunctions(const std::vector<LibraryFunction> * library);
+	// Where recursive decoding starts, and the data that jump tables may be read from
+	void SetEntryPoints(std::vector<uint64_t> entryPoints);
+	void SetDataSegment(Segment data);
+
+	// Decodes the code segment without translating it
+	virtual void Decode() = 0;
 	
 	virtual std::vector<std::string> TranslateToAssembly() = 0;
-	virtual std::vector<std::string> TranslateToSource() = 0;
+	// Decodes from the boundary, which must be a known instruction start at or before
+	// range.begin, but only translates the instructions inside the range
+	virtual std::vector<std::string> TranslateToAssembly(AddressRange range, uint64_t boundary) = 0;
+	// Lifts each function to IR and prints it as pseudo-C, with the functions split across threads
+	virtual std::vector<std::string> TranslateToSource(const std::vector<AddressRange> &functions, unsigned int threadCount) = 0;
+
+	// Likely function start addresses, for images without symbols or unwind metadata
+	virtual std::vector<uint64_t> FindFunctionStarts() = 0;
+
+	// References made by the decoded code, only valid after decoding
+	virtual const XrefIndex & GetXrefs() = 0;
+
+	// Decodes every code section without translating it and returns a JSON histogram of what was
+	// decoded. The work is split across threads at the boundaries, which must be instruction starts
+	virtual std::string CollectStatistics(const std::vector<uint64_t> &boundaries, unsigned int threadCount) = 0;
+
+	// Decodes the code and fingerprints each function, with the functions split across threads
+	virtual std::vector<FunctionFingerprint> FingerprintFunctions(const std::vector<AddressRange> &functions, unsigned int threadCount) = 0;
+
+	// Registers live on entry to each function and the register writes that are never read,
+	// one listing line per function, with the functions split across threads
+	virtual std::vector<std::string> RegisterLiveness(const std::vector<AddressRange> &functions, unsigned int threadCount) = 0;
+
+	// Instruction sequences of up to depth instructions that end in a return or an indirect
+	// jump or call, one listing line each
+	virtual std::vector<std::string> FindGadgets(unsigned int depth, unsigned int threadCount) = 0;
+
+	// Matches instruction patterns against the decoded code, only valid after decoding
+	virtual std::vector<SearchMatch> SearchInstructions(const std::vector<InstructionPattern> &patterns) = 0;
 
 protected:
 	Segment segment;
+	std::vector<SectionRange> mappedSections;
+	const StringTable * strings {};
+	const std::vector<LibraryFunction> * library {};
+	std::vector<uint64_t> entryPoints;
+	Segment data;
+
+	bool IsMapped(uint64_t address);
 };
 
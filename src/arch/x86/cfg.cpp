@@ -0,0 +1,174 @@
+#include <algorithm>
+
+#include "cfg.h"
+
+namespace ISet_x86
+{
+
+ControlFlowGraph::ControlFlowGraph(const std::vector<Instruction> &instrs, uint32_t first, uint32_t last,
+	uint64_t sectionAddress, const BranchTargets &targets, Arena &arena)
+{
+	if (last > instrs.size())
+	{
+		last = instrs.size();
+	}
+
+	if (first >= last)
+	{
+		edgeOffsets = arena.AllocateArray<uint32_t>(1);
+		return;
+	}
+
+	auto address = [&](uint32_t i)
+	{
+		return sectionAddress + instrs[i].attrib.runtime.segmentByteOffset;
+	};
+
+	// Mark the first instruction of every block. Instructions and targets are both sorted
+	// by address, so the targets are merged in with a single walk
+	uint32_t count = last - first;
+	bool * leader = arena.AllocateArray<bool>(count);
+	leader[0] = true;
+
+	auto target = std::lower_bound(targets.Addresses().begin(), targets.Addresses().end(), address(first));
+	for (uint32_t i = 0; i < count; i++)
+	{
+		while (target != targets.Addresses().end() && *target < address(first + i))
+		{
+			target++;
+		}
+
+		if (target != targets.Addresses().end() && *target == address(first + i))
+		{
+			leader[i] = true;
+		}
+
+		auto flow = instrs[first + i].attrib.intrinsic.flow;
+		if (flow != ControlFlow::SEQUENTIAL && flow != ControlFlow::CALL && i + 1 < count)
+		{
+			leader[i + 1] = true;
+		}
+	}
+
+	blockCount = std::count(leader, leader + count, true);
+	blocks = arena.AllocateArray<BasicBlock>(blockCount);
+
+	uint32_t id = 0;
+	for (uint32_t i = 0; i < count; i++)
+	{
+		if (leader[i])
+		{
+			blocks[id].address = address(first + i);
+			blocks[id].firstInstr = first + i;
+			id++;
+		}
+
+		blocks[id - 1].instrCount++;
+		blocks[id - 1].size += instrs[first + i].attrib.runtime.size;
+	}
+
+	// Edges are counted before they are stored so the adjacency arrays are allocated once
+	auto successors = [&](uint32_t b, uint32_t * out)
+	{
+		const auto &lastInstr = instrs[blocks[b].firstInstr + blocks[b].instrCount - 1];
+		auto flow = lastInstr.attrib.intrinsic.flow;
+		uint32_t n = 0;
+
+		if ((flow == ControlFlow::JUMP || flow == ControlFlow::CONDITIONAL_JUMP) && lastInstr.HasRelativeTarget())
+		{
+			uint32_t succ = BlockAt(lastInstr.RelativeTarget(sectionAddress));
+			if (succ != NO_BLOCK)
+			{
+				if (out != nullptr)
+				{
+					out[n] = succ;
+				}
+				n++;
+			}
+		}
+
+		bool fallsThrough = flow == ControlFlow::SEQUENTIAL || flow == ControlFlow::CALL || flow == ControlFlow::CONDITIONAL_JUMP;
+		if (fallsThrough && b + 1 < blockCount)
+		{
+			if (out != nullptr)
+			{
+				out[n] = b + 1;
+			}
+			n++;
+		}
+
+		return n;
+	};
+
+	edgeOffsets = arena.AllocateArray<uint32_t>(blockCount + 1);
+	for (uint32_t b = 0; b < blockCount; b++)
+	{
+		edgeOffsets[b + 1] = edgeOffsets[b] + successors(b, nullptr);
+	}
+
+	edgeCount = edgeOffsets[blockCount];
+	edges = arena.AllocateArray<uint32_t>(edgeCount);
+	for (uint32_t b = 0; b < blockCount; b++)
+	{
+		successors(b, edges + edgeOffsets[b]);
+	}
+}
+
+uint32_t ControlFlowGraph::BlockCount() const
+{
+	return blockCount;
+}
+
+uint32_t ControlFlowGraph::EdgeCount() const
+{
+	return edgeCount;
+}
+
+const BasicBlock & ControlFlowGraph::Block(uint32_t id) const
+{
+	return blocks[id];
+}
+
+const uint32_t * ControlFlowGraph::SuccessorsBegin(uint32_t id) const
+{
+	return edges + edgeOffsets[id];
+}
+
+const uint32_t * ControlFlowGraph::SuccessorsEnd(uint32_t id) const
+{
+	return edges + edgeOffsets[id + 1];
+}
+
+uint32_t ControlFlowGraph::FindBlock(uint64_t address) const
+{
+	auto pos = std::upper_bound(blocks, blocks + blockCount, address, [](uint64_t a, const BasicBlock &b)
+	{
+		return a < b.address;
+	});
+
+	if (pos == blocks)
+	{
+		return NO_BLOCK;
+	}
+
+	pos--;
+	if (address < pos->address + pos->size)
+	{
+		return pos - blocks;
+	}
+
+	return NO_BLOCK;
+}
+
+uint32_t ControlFlowGraph::BlockAt(uint64_t address) const
+{
+	uint32_t id = FindBlock(address);
+	if (id != NO_BLOCK && blocks[id].address == address)
+	{
+		return id;
+	}
+
+	return NO_BLOCK;
+}
+
+};
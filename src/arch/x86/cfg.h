@@ -0,0 +1,55 @@
+#pragma once
+
+#include <vector>
+
+#include "../../util/common.h"
+#include "../../util/arena.h"
+#include "instruction.h"
+#include "targets.h"
+
+namespace ISet_x86
+{
+
+struct BasicBlock
+{
+	uint64_t address {}; // Virtual address of the first instruction
+	uint32_t firstInstr {}; // Index of the first instruction in the decoded stream
+	uint32_t instrCount {};
+	uint32_t size {}; // Size of the block in bytes
+};
+
+class ControlFlowGraph
+// Basic blocks of a decoded instruction stream. Blocks and edges are stored as flat arrays
+// in an arena, with the successors of block i at edges[edgeOffsets[i]] to edges[edgeOffsets[i + 1]]
+{
+public:
+	static const uint32_t NO_BLOCK = UINT32_MAX;
+
+	// Builds the graph for instrs[first, last), splitting blocks after control transfers and
+	// at every address in targets. The arena must outlive the graph
+	ControlFlowGraph(const std::vector<Instruction> &instrs, uint32_t first, uint32_t last,
+		uint64_t sectionAddress, const BranchTargets &targets, Arena &arena);
+
+	uint32_t BlockCount() const;
+	uint32_t EdgeCount() const;
+	const BasicBlock & Block(uint32_t id) const;
+
+	const uint32_t * SuccessorsBegin(uint32_t id) const;
+	const uint32_t * SuccessorsEnd(uint32_t id) const;
+
+	// Block containing the address, or NO_BLOCK
+	uint32_t FindBlock(uint64_t address) const;
+
+private:
+	BasicBlock * blocks {};
+	uint32_t blockCount {};
+
+	uint32_t * edgeOffsets {}; // blockCount + 1 entries
+	uint32_t * edges {};
+	uint32_t edgeCount {};
+
+	// Block starting exactly at the address, or NO_BLOCK
+	uint32_t BlockAt(uint64_t address) const;
+};
+
+};
@@ -0,0 +1,99 @@
+#include <algorithm>
+
+#include "context.h"
+#include "csv.h"
+
+namespace ISet_x86
+{
+
+// ***** InstructionReference *****
+bool InstructionReference::Contains(const Opcode &opkey) const
+{
+	return references.find(opkey) != references.end();
+}
+
+bool InstructionReference::ContainsPrimary(byte b) const
+{
+	return primaries[b];
+}
+
+const Instruction & InstructionReference::GetReference(const Opcode &opkey) const
+{
+	auto found = references.find(opkey);
+	if (found != references.end())
+	{
+		return found->second;
+	}
+
+	// Used for instructions which have an opcode extension, as otherwise
+	// they would not be located at this stage properly
+	auto copyWithOpcodeExtension = opkey;
+	copyWithOpcodeExtension.extension = 0;
+
+	found = references.find(copyWithOpcodeExtension);
+	if (found != references.end())
+	{
+		return found->second;
+	}
+
+	return referencesById[NO_REFERENCE];
+}
+
+const Instruction & InstructionReference::GetReferenceById(uint16_t id) const
+{
+	if (id >= referencesById.size())
+	{
+		return referencesById[NO_REFERENCE];
+	}
+
+	return referencesById[id];
+}
+
+void InstructionReference::Emplace(Opcode opkey, Instruction instruction)
+{
+	instruction.attrib.intrinsic.referenceId = referencesById.size();
+	if (references.emplace(opkey, instruction).second)
+	{
+		referencesById.push_back(instruction);
+		if (opkey.primary >= 0 && opkey.primary < static_cast<int>(primaries.size()))
+		{
+			primaries[opkey.primary] = true;
+		}
+	}
+}
+
+int InstructionReference::size() const
+{
+	return references.size();
+}
+
+int InstructionReference::count(const Opcode &key) const
+{
+	return references.count(key);
+}
+
+// ***** DecoderContext *****
+DecoderContext::DecoderContext(const std::string &dataPath)
+{
+	x86CSVParse(references, dataPath);
+
+	std::unordered_map<ThreeByteKey, uint16_t, ThreeByteHash> threeByteReference {};
+	threeByteOpcodeCSVParse(threeByteReference, dataPath);
+
+	std::fill(&secondaries[0][0], &secondaries[0][0] + 2 * 256, INVALID);
+	for (auto &entry : threeByteReference)
+	{
+		if (entry.first.primary >= 0 && entry.first.primary < 256)
+		{
+			secondaries[entry.first.twoByte ? 1 : 0][entry.first.primary] = entry.second;
+		}
+	}
+}
+
+const DecoderContext & DecoderContext::Shared(const std::string &dataPath)
+{
+	static const DecoderContext context(dataPath);
+	return context;
+}
+
+};
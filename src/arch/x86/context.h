@@ -0,0 +1,65 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../../util/common.h"
+#include "instruction.h"
+#include "decode.h"
+
+namespace ISet_x86
+{
+
+class InstructionReference
+{
+public:
+	bool Contains(const Opcode &opkey) const;
+	// Whether any entry has this primary opcode byte, answered from a table kept as entries are added
+	bool ContainsPrimary(byte b) const;
+	// Falls back to the entry without an opcode extension, then to an unresolved instruction
+	const Instruction & GetReference(const Opcode &opkey) const;
+	// Entries are numbered in the order they are added, for use as dense array indices
+	const Instruction & GetReferenceById(uint16_t id) const;
+	void Emplace(Opcode opkey, Instruction instr);
+	int size() const;
+	int count(const Opcode &key) const;
+
+private:
+	std::unordered_map<Opcode, Instruction, OpcodeHash> references {};
+	std::vector<Instruction> referencesById {Instruction {}}; // Id 0 is NO_REFERENCE
+	std::array<bool, 256> primaries {};
+};
+
+class DecoderContext
+// Everything the decoder looks up while decoding, loaded from the reference CSVs. It is never
+// changed once built, so one context can be shared by any number of decoders on any number of
+// threads without locking
+{
+public:
+	// Reads x86.csv and secopcd.csv from the data directory, which ends in a slash
+	explicit DecoderContext(const std::string &dataPath = DATA_PATH);
+
+	DecoderContext(const DecoderContext &) = delete;
+	DecoderContext & operator=(const DecoderContext &) = delete;
+
+	// Built from the data directory of the first call. Later calls return that same context,
+	// ignoring the directory they name, and if building throws, the next call tries again
+	static const DecoderContext & Shared(const std::string &dataPath = DATA_PATH);
+
+	const InstructionReference & References() const { return references; }
+
+	// The secondary opcode byte that may follow the primary opcode, INVALID if there is none
+	int16_t Secondary(bool twoByte, byte primary) const { return secondaries[twoByte ? 1 : 0][primary]; }
+
+	// The state that reads an operand with the addressing method
+	funcptr AddrMethodState(AddrMethod method) const { return addrMethods.at(method); }
+
+private:
+	InstructionReference references {};
+	int16_t secondaries[2][256] {}; // Indexed by whether the opcode is two-byte, then by the primary
+	AddrMethodHandler addrMethods {};
+};
+
+};
@@ -0,0 +1,70 @@
+#include <iomanip>
+#include <sstream>
+
+#include "counters.h"
+
+namespace ISet_x86
+{
+
+const char * STATE_NAMES[] = {"init", "prefix", "opcode", "operands", "decode_success", "decode_failure", "end_of_segment",
+	"method_e", "method_g", "method_i", "method_j", "method_o", "method_z", "method_register", "method_unimplemented", "method_not_read"};
+const char * LOOKUP_NAMES[] = {"primary", "secondary", "reference", "addressing_method"};
+const char * EVENT_NAMES[] = {"no_opcode", "unresolved", "truncated", "secondary_reversed"};
+
+DecoderCounters & DecoderCounters::operator+=(const DecoderCounters &other)
+{
+	for (int i = 0; i < static_cast<int>(DecoderState::COUNT); i++)
+	{
+		entries[i] += other.entries[i];
+		bytes[i] += other.bytes[i];
+	}
+
+	for (int i = 0; i < static_cast<int>(ReferenceLookup::COUNT); i++)
+	{
+		lookups[i] += other.lookups[i];
+	}
+
+	for (int i = 0; i < static_cast<int>(DecoderEvent::COUNT); i++)
+	{
+		events[i] += other.events[i];
+	}
+
+	return *this;
+}
+
+std::vector<std::string> DecoderCounters::Report(const std::string &section) const
+{
+	std::vector<std::string> lines {};
+	lines.push_back("Decoder counters for " + section);
+
+	std::stringstream header {};
+	header << std::left << std::setw(24) << "state" << std::right << std::setw(14) << "entries" << std::setw(14) << "bytes";
+	lines.push_back(header.str());
+
+	for (int i = 0; i < static_cast<int>(DecoderState::COUNT); i++)
+	{
+		std::stringstream line {};
+		line << std::left << std::setw(24) << STATE_NAMES[i] << std::right << std::setw(14) << entries[i] << std::setw(14) << bytes[i];
+		lines.push_back(line.str());
+	}
+
+	std::stringstream lookupLine {};
+	lookupLine << "lookups:";
+	for (int i = 0; i < static_cast<int>(ReferenceLookup::COUNT); i++)
+	{
+		lookupLine << ' ' << LOOKUP_NAMES[i] << '=' << lookups[i];
+	}
+	lines.push_back(lookupLine.str());
+
+	std::stringstream eventLine {};
+	eventLine << "events:";
+	for (int i = 0; i < static_cast<int>(DecoderEvent::COUNT); i++)
+	{
+		eventLine << ' ' << EVENT_NAMES[i] << '=' << events[i];
+	}
+	lines.push_back(eventLine.str());
+
+	return lines;
+}
+
+};
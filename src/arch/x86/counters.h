@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Counters of what the decoder state machine does, only kept in builds configured with
+// DISASM_COUNTERS. Otherwise the DECODER_COUNT macros expand to nothing and the decoder
+// carries no counters at all
+
+namespace ISet_x86
+{
+
+enum class DecoderState : uint8_t
+{
+	INIT,
+	PREFIX,
+	OPCODE,
+	OPERANDS,
+	DECODE_SUCCESS,
+	DECODE_FAILURE,
+	END_OF_SEGMENT,
+	METHOD_E,
+	METHOD_G,
+	METHOD_I,
+	METHOD_J,
+	METHOD_O,
+	METHOD_Z,
+	METHOD_REGISTER,
+	METHOD_UNIMPLEMENTED,
+	METHOD_NOT_READ, // Addressing methods that don't read anything yet, such as M and W
+	COUNT
+};
+
+enum class ReferenceLookup : uint8_t
+{
+	PRIMARY, // Whether a byte is a primary opcode
+	SECONDARY, // Whether a primary opcode may be followed by a secondary one
+	REFERENCE, // The reference entry of a full opcode
+	ADDRESSING_METHOD, // The state that reads an operand
+	COUNT
+};
+
+enum class DecoderEvent : uint8_t
+{
+	NO_OPCODE, // Failed on a byte that isn't an opcode
+	UNRESOLVED, // Failed on an opcode without a reference entry
+	TRUNCATED, // The section ended inside an instruction
+	SECONDARY_REVERSED, // A possible secondary opcode byte wasn't one, and was read again
+	COUNT
+};
+
+struct DecoderCounters
+{
+	uint64_t entries[static_cast<int>(DecoderState::COUNT)] {};
+	uint64_t bytes[static_cast<int>(DecoderState::COUNT)] {}; // Read while in each state
+	uint64_t lookups[static_cast<int>(ReferenceLookup::COUNT)] {};
+	uint64_t events[static_cast<int>(DecoderEvent::COUNT)] {};
+	DecoderState current {DecoderState::INIT};
+
+	void Enter(DecoderState state)
+	{
+		current = state;
+		entries[static_cast<int>(state)]++;
+	}
+
+	DecoderCounters & operator+=(const DecoderCounters &other);
+
+	// Listing of the counters, headed by the name of the section they were counted in
+	std::vector<std::string> Report(const std::string &section) const;
+};
+
+};
+
+#ifdef DISASM_COUNTERS
+#define DECODER_COUNT_STATE(context, state) (context)->Counters().Enter(ISet_x86::DecoderState::state)
+#define DECODER_COUNT_BYTE(context) (context)->Counters().bytes[static_cast<int>((context)->Counters().current)]++
+#define DECODER_COUNT_LOOKUP(context, lookup) (context)->Counters().lookups[static_cast<int>(ISet_x86::ReferenceLookup::lookup)]++
+#define DECODER_COUNT_EVENT(context, event) (context)->Counters().events[static_cast<int>(ISet_x86::DecoderEvent::event)]++
+#else
+#define DECODER_COUNT_STATE(context, state) ((void)0)
+#define DECODER_COUNT_BYTE(context) ((void)0)
+#define DECODER_COUNT_LOOKUP(context, lookup) ((void)0)
+#define DECODER_COUNT_EVENT(context, event) ((void)0)
+#endif
@@ -3,6 +3,7 @@
 #include <string>
 #include <set>
 #include <cmath>
+#include <cctype>
 #include <fstream>
 #include <vector>
 #include <string>
@@ -11,6 +12,9 @@
 
 #include "x86.h"
 #include "decode.h"
+#include "context.h"
+#include "../../util/trace.h"
+#include "../../util/alloc.h"
 
 enum CSV_COLUMNS
 {
@@ -100,6 +104,176 @@ bool ParseAsBool(std::string field)
 	}
 }
 
+ControlFlow ClassifyControlFlow(const Instruction &instr)
+{
+	const auto &intrinsic = instr.attrib.intrinsic;
+
+	if (intrinsic.mnemonic == "call" || intrinsic.mnemonic == "callf")
+	{
+		return ControlFlow::CALL;
+	}
+
+	else if (intrinsic.group2 == "branch" && intrinsic.group3 == "cond")
+	{
+		return ControlFlow::CONDITIONAL_JUMP;
+	}
+
+	else if (intrinsic.mnemonic == "jmp" && instr.op1.attrib.intrinsic.addrMethod == AddrMethod::J)
+	{
+		return ControlFlow::JUMP;
+	}
+
+	else if (intrinsic.mnemonic == "jmp" || intrinsic.mnemonic == "jmpf")
+	{
+		return ControlFlow::INDIRECT_JUMP;
+	}
+
+	else if (intrinsic.mnemonic == "retn" || intrinsic.mnemonic == "retf" || intrinsic.mnemonic.compare(0, 4, "iret") == 0
+	|| intrinsic.mnemonic == "sysexit" || intrinsic.mnemonic == "sysret")
+	{
+		return ControlFlow::RETURN;
+	}
+
+	else if (intrinsic.mnemonic == "hlt" || intrinsic.mnemonic == "ud2")
+	{
+		return ControlFlow::HALT;
+	}
+
+	return ControlFlow::SEQUENTIAL;
+}
+
+uint8_t ParseFlagMask(const std::string &field, bool setOnly = false)
+// Flag fields list one letter per flag, such as "oszapc". The flag values field uses upper
+// case for the flags that are set, and lower case for those that are cleared
+{
+	uint8_t mask = 0;
+	for (char c : field)
+	{
+		if (setOnly && !std::isupper(c))
+		{
+			continue;
+		}
+
+		switch (std::tolower(c))
+		{
+			case 'o': mask |= FLAG_O; break;
+			case 'd': mask |= FLAG_D; break;
+			case 'i': mask |= FLAG_I; break;
+			case 's': mask |= FLAG_S; break;
+			case 'z': mask |= FLAG_Z; break;
+			case 'a': mask |= FLAG_A; break;
+			case 'p': mask |= FLAG_P; break;
+			case 'c': mask |= FLAG_C; break;
+			default: break;
+		}
+	}
+
+	return mask;
+}
+
+uint8_t HardcodedRegisterMask(AddrMethod method)
+{
+	int value = static_cast<int>(method);
+	if (value < static_cast<int>(AddrMethod::AH) || value > static_cast<int>(AddrMethod::ESP))
+	{
+		return 0;
+	}
+
+	// Register families in the order of the enum
+	const uint8_t families[] = {REG_EAX, REG_EBX, REG_ECX, REG_EDX, REG_ESI, REG_EDI, REG_EBP, REG_ESP};
+	return families[value / 100 - 1];
+}
+
+void ClassifyRegisterAccess(Instruction &instr)
+{
+	auto &intrinsic = instr.attrib.intrinsic;
+	const std::string &mnem = intrinsic.mnemonic;
+
+	// The first operand is read and written, and the rest are only read, apart from these
+	static const std::set<std::string> writeOnly {"mov", "movzx", "movsx", "movsxd", "movbe", "lea", "pop", "in", "ins", "stos",
+		"movs", "lds", "les", "lfs", "lgs", "lss", "bsf", "bsr", "popcnt", "lar", "lsl", "sldt", "smsw", "str", "sgdt", "sidt"};
+	static const std::set<std::string> readOnly {"cmp", "test", "push", "bt", "out", "outs", "lods", "cmps", "scas", "bound",
+		"enter", "int", "retn", "retf", "verr", "verw", "lgdt", "lidt", "lldt", "lmsw", "ltr", "invlpg"};
+	static const std::set<std::string> bothWritten {"xchg", "xadd"};
+
+	// Registers used without being named by an operand, as {read, written}
+	static const std::unordered_map<std::string, std::pair<uint8_t, uint8_t>> implicit
+	{
+		{"push", {REG_ESP, REG_ESP}}, {"pop", {REG_ESP, REG_ESP}}, {"pushf", {REG_ESP, REG_ESP}}, {"pushfd", {REG_ESP, REG_ESP}},
+		{"popf", {REG_ESP, REG_ESP}}, {"popfd", {REG_ESP, REG_ESP}}, {"call", {REG_ESP, REG_ESP}}, {"callf", {REG_ESP, REG_ESP}},
+		{"retn", {REG_ESP, REG_ESP}}, {"retf", {REG_ESP, REG_ESP}}, {"iret", {REG_ESP, REG_ESP}}, {"iretd", {REG_ESP, REG_ESP}},
+		{"int", {REG_ESP, REG_ESP}}, {"into", {REG_ESP, REG_ESP}},
+		{"pusha", {REG_ALL, REG_ESP}}, {"pushad", {REG_ALL, REG_ESP}}, {"popa", {REG_ESP, REG_ALL}}, {"popad", {REG_ESP, REG_ALL}},
+		{"enter", {REG_ESP | REG_EBP, REG_ESP | REG_EBP}}, {"leave", {REG_EBP, REG_ESP | REG_EBP}},
+		{"cbw", {REG_EAX, REG_EAX}}, {"cwde", {REG_EAX, REG_EAX}}, {"cwd", {REG_EAX, REG_EDX}}, {"cdq", {REG_EAX, REG_EDX}},
+		{"mul", {REG_EAX, REG_EAX | REG_EDX}}, {"div", {REG_EAX | REG_EDX, REG_EAX | REG_EDX}}, {"idiv", {REG_EAX | REG_EDX, REG_EAX | REG_EDX}},
+		{"aaa", {REG_EAX, REG_EAX}}, {"aas", {REG_EAX, REG_EAX}}, {"daa", {REG_EAX, REG_EAX}}, {"das", {REG_EAX, REG_EAX}},
+		{"aam", {REG_EAX, REG_EAX}}, {"aad", {REG_EAX, REG_EAX}}, {"lahf", {0, REG_EAX}}, {"sahf", {REG_EAX, 0}},
+		{"salc", {0, REG_EAX}}, {"setalc", {0, REG_EAX}}, {"xlat", {REG_EAX | REG_EBX, REG_EAX}}, {"xlatb", {REG_EAX | REG_EBX, REG_EAX}},
+		{"cmpxchg", {REG_EAX, REG_EAX}}, {"cmpxchg8b", {REG_EAX | REG_EBX | REG_ECX | REG_EDX, REG_EAX | REG_EDX}},
+		{"loop", {REG_ECX, REG_ECX}}, {"loope", {REG_ECX, REG_ECX}}, {"loopz", {REG_ECX, REG_ECX}},
+		{"loopne", {REG_ECX, REG_ECX}}, {"loopnz", {REG_ECX, REG_ECX}}, {"jcxz", {REG_ECX, 0}}, {"jecxz", {REG_ECX, 0}},
+		{"lods", {REG_ESI, REG_ESI | REG_EAX}}, {"stos", {REG_EDI | REG_EAX, REG_EDI}}, {"movs", {REG_ESI | REG_EDI, REG_ESI | REG_EDI}},
+		{"cmps", {REG_ESI | REG_EDI, REG_ESI | REG_EDI}}, {"scas", {REG_EDI | REG_EAX, REG_EDI}},
+		{"ins", {REG_EDI | REG_EDX, REG_EDI}}, {"outs", {REG_ESI | REG_EDX, REG_ESI}},
+		{"cpuid", {REG_EAX | REG_ECX, REG_EAX | REG_EBX | REG_ECX | REG_EDX}}, {"rdtsc", {0, REG_EAX | REG_EDX}},
+		{"rdtscp", {0, REG_EAX | REG_ECX | REG_EDX}}, {"rdmsr", {REG_ECX, REG_EAX | REG_EDX}}, {"rdpmc", {REG_ECX, REG_EAX | REG_EDX}},
+		{"wrmsr", {REG_EAX | REG_ECX | REG_EDX, 0}}, {"xgetbv", {REG_ECX, REG_EAX | REG_EDX}}
+	};
+
+	const Operand * ops[] = {&instr.op1, &instr.op2, &instr.op3, &instr.op4};
+	int count = 0;
+	while (count < 4 && ops[count]->attrib.intrinsic.addrMethod != AddrMethod::NOT_APPLICABLE)
+	{
+		count++;
+	}
+
+	intrinsic.operandsRead = (1 << count) - 1;
+	intrinsic.operandsWritten = (count > 0) ? 1 : 0;
+
+	bool branch = intrinsic.group2 == "branch" || intrinsic.group2 == "branchstack";
+
+	// The one operand forms of mul and imul read eax implicitly, the three operand form of imul
+	// only writes its first operand
+	bool oneOperand = count == 1 && (mnem == "mul" || mnem == "imul" || mnem == "div" || mnem == "idiv");
+	if (writeOnly.count(mnem) || mnem.compare(0, 3, "set") == 0 || (mnem == "imul" && count == 3))
+	{
+		intrinsic.operandsRead &= ~1;
+	}
+
+	else if (branch || oneOperand || readOnly.count(mnem))
+	{
+		intrinsic.operandsWritten = 0;
+	}
+
+	else if (bothWritten.count(mnem) && count > 1)
+	{
+		intrinsic.operandsWritten |= 0b10;
+	}
+
+	// String and SSE instructions share some mnemonics, such as movsd and cmpsd
+	bool general = intrinsic.group1 == "gen";
+	auto pos = implicit.find(mnem);
+	if (general && pos != implicit.end())
+	{
+		intrinsic.registersRead = pos->second.first;
+		intrinsic.registersWritten = pos->second.second;
+	}
+
+	else if (general && mnem == "imul" && oneOperand)
+	{
+		intrinsic.registersRead = REG_EAX;
+		intrinsic.registersWritten = REG_EAX | REG_EDX;
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		uint8_t reg = HardcodedRegisterMask(ops[i]->attrib.intrinsic.addrMethod);
+		intrinsic.registersRead |= (intrinsic.operandsRead >> i & 1) ? reg : 0;
+		intrinsic.registersWritten |= (intrinsic.operandsWritten >> i & 1) ? reg : 0;
+	}
+}
+
 Instruction ParseCSVLine(std::string line)
 {
 	Instruction instr {};
@@ -198,19 +372,20 @@ Instruction ParseCSVLine(std::string line)
 				instr.attrib.intrinsic.group3 = field;
 				break;
 			case CSV_COLUMNS::TEST_F:
-				instr.attrib.intrinsic.testedFlags = field;
+				instr.attrib.intrinsic.testedFlags = ParseFlagMask(field);
 				break;
 			case CSV_COLUMNS::MODIF_F:
-				instr.attrib.intrinsic.modifiedFlags = field;
+				instr.attrib.intrinsic.modifiedFlags = ParseFlagMask(field);
 				break;
 			case CSV_COLUMNS::DEF_F:
-				instr.attrib.intrinsic.definedFlags = field;
+				instr.attrib.intrinsic.definedFlags = ParseFlagMask(field);
 				break;
 			case CSV_COLUMNS::UNDEF_F:
-				instr.attrib.intrinsic.undefinedFlags = field;
+				instr.attrib.intrinsic.undefinedFlags = ParseFlagMask(field);
 				break;
 			case CSV_COLUMNS::F_VALS:
-				instr.attrib.intrinsic.flagValues = field;
+				instr.attrib.intrinsic.flagValues = ParseFlagMask(field);
+				instr.attrib.intrinsic.setFlags = ParseFlagMask(field, true);
 				break;
 			case CSV_COLUMNS::EXCLUSIVE:
 				if (field == "32")
@@ -258,12 +433,17 @@ Instruction ParseCSVLine(std::string line)
 		column++;
 	}
 
+	instr.attrib.intrinsic.flow = ClassifyControlFlow(instr);
+	ClassifyRegisterAccess(instr);
+
 	return instr;
 }
 
-void x86CSVParse(InstructionReference &instrReference)
+void x86CSVParse(InstructionReference &instrReference, const std::string &dataPath)
 {
-	std::string path = "../data/x86.csv";
+	TRACE_SPAN("x86CSVParse");
+	ALLOC_STAGE(REFERENCE);
+	std::string path = dataPath + "x86.csv";
 	std::ifstream csvFile {path};
 	if (!csvFile.is_open())
 	{
@@ -294,13 +474,14 @@ void x86CSVParse(InstructionReference &instrReference)
 	}
 }
 
-void threeByteOpcodeCSVParse()
+void threeByteOpcodeCSVParse(std::unordered_map<ThreeByteKey, uint16_t, ThreeByteHash> &threeByteReference, const std::string &dataPath)
 {
-	std::string path = "../data/secopcd.csv";
+	ALLOC_STAGE(REFERENCE);
+	std::string path = dataPath + "secopcd.csv";
 	std::ifstream csvFile {path};
 	if (!csvFile.is_open())
 	{
-		throw std::runtime_error("Failed to open x86.csv");
+		throw std::runtime_error("Failed to open secopcd.csv");
 	}
 
 	std::vector<std::string> csvLines {};
@@ -1,11 +1,19 @@
 #pragma once
 
+#include <string>
+#include <unordered_map>
+
+#include "../../util/common.h"
+#include "instruction.h"
+
 namespace ISet_x86
 {
 
 class InstructionReference;
 
-void x86CSVParse(InstructionReference &instrReference);
-void threeByteOpcodeCSVParse();
+// Both read their CSV from the data directory, which ends in a slash, and are used to build
+// a DecoderContext
+void x86CSVParse(InstructionReference &instrReference, const std::string &dataPath = DATA_PATH);
+void threeByteOpcodeCSVParse(std::unordered_map<ThreeByteKey, uint16_t, ThreeByteHash> &threeByteReference, const std::string &dataPath = DATA_PATH);
 
 };
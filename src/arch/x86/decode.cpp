@@ -4,6 +4,9 @@
 #include <algorithm>
 
 #include "decode.h"
+#include "context.h"
+#include "../../util/trace.h"
+#include "../../util/alloc.h"
 
 namespace ISet_x86
 {
@@ -12,17 +15,47 @@ using namespace State_x86;
 
 // ***** LinearDecoder *****
 LinearDecoder::LinearDecoder(std::vector<byte> * section)
+	: LinearDecoder(section, 0, section->size())
 {
+}
+
+LinearDecoder::LinearDecoder(std::vector<byte> * section, unsigned int begin, unsigned int end)
+	: LinearDecoder(section, begin, end, DecoderContext::Shared())
+{
+}
+
+LinearDecoder::LinearDecoder(std::vector<byte> * section, unsigned int begin, unsigned int end, const DecoderContext &context)
+{
+	this->context = &context;
 	this->section = section;
 
+	if (end > section->size())
+	{
+		end = section->size();
+	}
+
+	byteOffset = begin;
+	endOffset = end;
+
 	instructions = std::vector<Instruction>();
 	currentInstr = Instruction();
-	currentByte = section->at(byteOffset);
 	state = Init;
+
+	if (begin < end)
+	{
+		currentByte = section->at(byteOffset);
+	}
+	else
+	{
+		state = EndOfSegment;
+	}
 }
 
 std::vector<Instruction> LinearDecoder::DecodeSection()
 {
+	TRACE_SPAN("LinearDecoder::DecodeSection");
+	ALLOC_STAGE(DECODE);
+
 	// State machine rules
 	// ===================
 	// 1. Only call NextByte whenever the next byte is needed, and never to prepare for the
@@ -36,6 +69,13 @@ std::vector<Instruction> LinearDecoder::DecodeSection()
 		state(this, currentInstr);
 	}	
 
+	// The loop stops on reaching EndOfSegment rather than running it, so it is counted here
+	DECODER_COUNT_STATE(this, END_OF_SEGMENT);
+	if (currentInstr.attrib.runtime.prefixCount > 0 || currentInstr.attrib.runtime.opcodeLength > 0)
+	{
+		DECODER_COUNT_EVENT(this, TRUNCATED);
+	}
+
 	return instructions;
 }
 
@@ -51,10 +91,11 @@ unsigned int LinearDecoder::ByteOffset()
 
 bool __attribute__((warn_unused_result)) LinearDecoder::NextByte()
 {
-	if (byteOffset + 1 < section->size())
+	if (byteOffset + 1 < endOffset)
 	{
 		byteOffset++;
 		currentByte = section->at(byteOffset);
+		DECODER_COUNT_BYTE(this);
 		return true;
 	}
 
@@ -73,6 +114,13 @@ bool __attribute__((warn_unused_result)) LinearDecoder::ReverseByte()
 	return false;
 }
 
+#ifdef DISASM_COUNTERS
+DecoderCounters & LinearDecoder::Counters()
+{
+	return counters;
+}
+#endif
+
 void LinearDecoder::NextInstruction()
 {
 	instructions.push_back(currentInstr);
@@ -106,7 +154,7 @@ void LinearDecoder::ChangeState(funcptr newState)
 	state = newState;		
 }
 
-funcptr AddrMethodHandler::at(AddrMethod method)
+funcptr AddrMethodHandler::at(AddrMethod method) const
 {
 	if (addrMethodHandlers.count(method) > 0)
 	{
@@ -125,10 +173,6 @@ funcptr AddrMethodHandler::at(AddrMethod method)
 	}
 }
 
-AddrMethodHandler addrMethodHandler {};
-
-std::unordered_map<ThreeByteKey, uint16_t, ThreeByteHash> threeByteReference {};
-
 };
 
 
@@ -138,12 +182,14 @@ namespace State_x86
 // General states
 void Init(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, INIT);
 	instr.attrib.runtime.segmentByteOffset = context->ByteOffset();
 	context->ChangeState(Prefix);
 }
 
 void Prefix(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, PREFIX);
 	// Advance the byte pointer if the current one has already been parsed as a prefix	
 	if (instr.attrib.runtime.prefixCount > 0)
 	{
@@ -157,8 +203,18 @@ void Prefix(LinearDecoder * context, Instruction &instr)
 	// Current byte recognized as a valid prefix 
 	if (std::find(prefixes.begin(), prefixes.end(), context->CurrentByte()) != prefixes.end())
 	{
-		instr.encoded.prefix[instr.attrib.runtime.prefixCount] = context->CurrentByte();
+		// Only the first few are kept, though every one is counted
+		if (instr.attrib.runtime.prefixCount < instr.encoded.prefix.size())
+		{
+			instr.encoded.prefix[instr.attrib.runtime.prefixCount] = context->CurrentByte();
+		}
 		instr.attrib.runtime.prefixCount++;
+
+		// Prefixes alone have filled the longest possible instruction
+		if (instr.attrib.runtime.prefixCount >= MAX_INSTRUCTION_SIZE)
+		{
+			context->ChangeState(DecodeFailure);
+		}
 	}
 	
 	// Current byte not recognized as a prefix, will be checked for opcode
@@ -170,6 +226,7 @@ void Prefix(LinearDecoder * context, Instruction &instr)
 
 void Opcode(LinearDecoder * context, Instruction &instr)
 { 
+	DECODER_COUNT_STATE(context, OPCODE);
 	// Current byte signals a two-byte opcode	
 	if (context->CurrentByte() == 0x0F) 
 	{
@@ -184,15 +241,16 @@ void Opcode(LinearDecoder * context, Instruction &instr)
 	}
 
 	// Current byte is a valid primary opcode (including those that follow the two-byte signal)
-	if (instrReference.ContainsPrimary(context->CurrentByte()))
+	DECODER_COUNT_LOOKUP(context, PRIMARY);
+	if (context->Context().References().ContainsPrimary(context->CurrentByte()))
 	{
 		instr.encoded.opcode.primary = context->CurrentByte();
 		instr.attrib.runtime.opcodeLength++;
 
-		ThreeByteKey tbk = { instr.encoded.opcode.twoByte, instr.encoded.opcode.primary };
-
 		// Check whether or not a secondary opcode will be present
-		if (threeByteReference.find(tbk) != threeByteReference.end())
+		DECODER_COUNT_LOOKUP(context, SECONDARY);
+		int16_t expectedSecondary = context->Context().Secondary(instr.encoded.opcode.twoByte, context->CurrentByte());
+		if (expectedSecondary != INVALID)
 		{
 			if(!context->NextByte())
 			{
@@ -202,7 +260,7 @@ void Opcode(LinearDecoder * context, Instruction &instr)
 
 			auto secondary = context->CurrentByte();
 
-			if (threeByteReference.at(tbk) == secondary)
+			if (expectedSecondary == secondary)
 			{
 				instr.encoded.opcode.secondary = secondary;
 				instr.attrib.runtime.opcodeLength++;
@@ -210,6 +268,7 @@ void Opcode(LinearDecoder * context, Instruction &instr)
 
 			else
 			{
+				DECODER_COUNT_EVENT(context, SECONDARY_REVERSED);
 				if(!context->ReverseByte())
 				{
 					context->ChangeState(MethodError);
@@ -219,9 +278,11 @@ void Opcode(LinearDecoder * context, Instruction &instr)
 		}
 
 		// Update the instruction based upon the common attributes inferred from opcode
-		const Instruction reference = instrReference.GetReference(instr.encoded.opcode);
+		DECODER_COUNT_LOOKUP(context, REFERENCE);
+		const Instruction &reference = context->Context().References().GetReference(instr.encoded.opcode);
 		if (reference.attrib.intrinsic.mnemonic == "UNRESOLVED")
 		{
+			DECODER_COUNT_EVENT(context, UNRESOLVED);
 			context->ChangeState(DecodeFailure);
 		}
 		else
@@ -235,6 +296,7 @@ void Opcode(LinearDecoder * context, Instruction &instr)
 	// No opcode byte was found in the byte sequence, which means decoding cannot continue
 	else
 	{
+		DECODER_COUNT_EVENT(context, NO_OPCODE);
 		context->ChangeState(DecodeFailure);
 	}	
 
@@ -242,11 +304,13 @@ void Opcode(LinearDecoder * context, Instruction &instr)
 
 void Operands(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, OPERANDS);
 	// If the instruction has a first operand that hasn't been read yet
     if (instr.op1.attrib.intrinsic.type != OperandType::NOT_APPLICABLE && !instr.attrib.flags.op1Read)
 	{
 		instr.activeOperand = &instr.op1;
-        context->ChangeState(addrMethodHandler.at(instr.op1.attrib.intrinsic.addrMethod));
+		DECODER_COUNT_LOOKUP(context, ADDRESSING_METHOD);
+        context->ChangeState(context->Context().AddrMethodState(instr.op1.attrib.intrinsic.addrMethod));
 		instr.attrib.flags.op1Read = true;
 	}
 
@@ -254,7 +318,8 @@ void Operands(LinearDecoder * context, Instruction &instr)
     else if (instr.op2.attrib.intrinsic.type != OperandType::NOT_APPLICABLE && instr.attrib.flags.op1Read && !instr.attrib.flags.op2Read)
 	{
 		instr.activeOperand = &instr.op2;
-        context->ChangeState(addrMethodHandler.at(instr.op2.attrib.intrinsic.addrMethod));
+		DECODER_COUNT_LOOKUP(context, ADDRESSING_METHOD);
+        context->ChangeState(context->Context().AddrMethodState(instr.op2.attrib.intrinsic.addrMethod));
 		instr.attrib.flags.op2Read = true;
 	}
 
@@ -268,6 +333,13 @@ void Operands(LinearDecoder * context, Instruction &instr)
 
 void DecodeSuccess(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, DECODE_SUCCESS);
+	// The current byte is the last one of the instruction, so the size must be taken
+	// before advancing, and the instruction kept even if it ends the segment
+	instr.attrib.flags.resolved = true;
+	instr.attrib.runtime.size = (context->ByteOffset() - instr.attrib.runtime.segmentByteOffset) + 1;
+	context->NextInstruction(); // Handle parsed instruction and prepare for new one
+
 	// Prepare for next instruction
 	if(!context->NextByte())
 	{
@@ -275,15 +347,15 @@ void DecodeSuccess(LinearDecoder * context, Instruction &instr)
 		return;
 	}
 
-	instr.attrib.flags.resolved = true;
-	instr.attrib.runtime.size = (context->ByteOffset() - instr.attrib.runtime.segmentByteOffset) + 1;
-	context->NextInstruction(); // Handle parsed instruction and prepare for new one
-
 	context->ChangeState(Init); // Reset state
 }
 
 void DecodeFailure(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, DECODE_FAILURE);
+	instr.attrib.runtime.size = (context->ByteOffset() - instr.attrib.runtime.segmentByteOffset) + 1;
+	context->NextInstruction(); // Handle parsed instruction and prepare for new one
+
 	// Nothing useful could be done with the current byte, so advance the byte pointer
 	if(!context->NextByte())
 	{
@@ -291,9 +363,6 @@ void DecodeFailure(LinearDecoder * context, Instruction &instr)
 		return;
 	}
 
-	instr.attrib.runtime.size = (context->ByteOffset() - instr.attrib.runtime.segmentByteOffset) + 1;
-	context->NextInstruction(); // Handle parsed instruction and prepare for new one
-
 	context->ChangeState(Init); // Reset state
 }
 
@@ -313,34 +382,40 @@ void MethodError(LinearDecoder * context, Instruction &instr)
 
 void MethodUnimplemented(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_UNIMPLEMENTED);
 	context->ChangeState(Operands);
 }
 
 void MethodA(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 }
 
 void MethodB(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodC(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodD(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodE(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_E);
 	if (!instr.attrib.flags.modRMRead)
 	{
 		// Get the ModRM byte
@@ -351,7 +426,7 @@ void MethodE(LinearDecoder * context, Instruction &instr)
 		}
 
 		byte modrmByte = context->CurrentByte();
-		instr.InterpretModRMByte(modrmByte);
+		instr.InterpretModRMByte(modrmByte, context->Context().References());
 	}
 
 	if (instr.attrib.flags.hasSIB && !instr.attrib.flags.sibRead)
@@ -377,7 +452,13 @@ void MethodE(LinearDecoder * context, Instruction &instr)
 				return;
 			}
 
-			instr.encoded.disp += context->CurrentByte();
+			instr.encoded.disp += (context->CurrentByte() << (8*i));
+		}
+
+		// One-byte displacements are sign-extended
+		if (instr.attrib.runtime.displacementSize == 1)
+		{
+			instr.encoded.disp = static_cast<int8_t>(instr.encoded.disp);
 		}
 
 		instr.attrib.flags.dispRead = true;
@@ -419,12 +500,14 @@ void MethodE(LinearDecoder * context, Instruction &instr)
 
 void MethodF(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodG(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_G);
 	if (!instr.attrib.flags.modRMRead)
 	{
 
@@ -436,7 +519,7 @@ void MethodG(LinearDecoder * context, Instruction &instr)
 		}
 
 		byte modrmByte = context->CurrentByte();
-		instr.InterpretModRMByte(modrmByte);
+		instr.InterpretModRMByte(modrmByte, context->Context().References());
 	}
 
 	instr.activeOperand->attrib.runtime.encoding = Operand::Encoding::MODRM_REGISTER_REGBITS;
@@ -446,6 +529,7 @@ void MethodG(LinearDecoder * context, Instruction &instr)
  
 void MethodH(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
@@ -453,23 +537,8 @@ void MethodH(LinearDecoder * context, Instruction &instr)
 // IMMD data
 void MethodI(LinearDecoder * context, Instruction &instr)
 {
-    bool sField = instr.encoded.opcode.primary & 0b00000001;
-    bool xField = instr.encoded.opcode.primary & 0b00000010;
-	int immdSize = 0;
-
-	if (sField)
-	{
-		immdSize = 4;
-	}
-	else
-	{
-		immdSize = 1;
-	}
-	// Overrides
-	if (xField)
-	{
-		immdSize = 1;	
-	}
+	DECODER_COUNT_STATE(context, METHOD_I);
+	int immdSize = instr.OperandByteSize();
 
 	for (int i = 0; i < immdSize; i++)
 	{
@@ -487,22 +556,26 @@ void MethodI(LinearDecoder * context, Instruction &instr)
 	context->ChangeState(Operands);
 }
 
-// This one is messy, I need to come back and see if it can be fixed later
+// The displacement is relative to the end of the instruction, and is resolved to an absolute
+// address by Instruction::RelativeTarget once the instruction size is known
 void MethodJ(LinearDecoder * context, Instruction &instr)
 {
-	int immdSize;
-	// Behaves differently than the others
-	if (instr.attrib.intrinsic.mnemonic == "call")
+	DECODER_COUNT_STATE(context, METHOD_J);
+	int relSize = 4;
+	// Short jumps (and loops) take a sign-extended byte
+	if (instr.activeOperand->attrib.intrinsic.type == OperandType::b || instr.activeOperand->attrib.intrinsic.type == OperandType::bs)
 	{
-		immdSize = 4;
+		relSize = 1;
 	}
 
-	else
+	// The operand-size prefix shrinks the others to a word
+	else if (instr.HasPrefix(0x66))
 	{
-		immdSize = 1;
+		relSize = 2;
 	}
 
-	for (int i = 0; i < immdSize; i++)
+	uint32_t rel = 0;
+	for (int i = 0; i < relSize; i++)
 	{
 		if (!context->NextByte())
 		{
@@ -510,7 +583,20 @@ void MethodJ(LinearDecoder * context, Instruction &instr)
 			return;
 		}
 
-		instr.encoded.immd += (context->CurrentByte() << (8*i));
+		rel |= (static_cast<uint32_t>(context->CurrentByte()) << (8*i));
+	}
+
+	if (relSize == 1)
+	{
+		instr.encoded.rel = static_cast<int8_t>(rel);
+	}
+	else if (relSize == 2)
+	{
+		instr.encoded.rel = static_cast<int16_t>(rel);
+	}
+	else
+	{
+		instr.encoded.rel = static_cast<int32_t>(rel);
 	}
 
 	instr.activeOperand->attrib.runtime.encoding = Operand::Encoding::RELATIVE_DISPLACEMENT;
@@ -519,84 +605,116 @@ void MethodJ(LinearDecoder * context, Instruction &instr)
 
 void MethodL(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodM(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodN(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
+// No ModR/M byte, the absolute address of the operand follows the opcode
 void MethodO(LinearDecoder * context, Instruction &instr)
 {
-	context->ChangeState(Operands);
+	DECODER_COUNT_STATE(context, METHOD_O);
+	int offsetSize = instr.HasPrefix(0x67) ? 2 : 4;
+
+	for (int i = 0; i < offsetSize; i++)
+	{
+		if (!context->NextByte())
+		{
+			context->ChangeState(EndOfSegment);
+			return;
+		}
+
+		instr.encoded.disp += (context->CurrentByte() << (8*i));
+	}
 
+	instr.attrib.flags.hasDisplacement = true;
+	instr.attrib.flags.dispRead = true;
+	instr.attrib.runtime.displacementSize = offsetSize;
+	instr.activeOperand->attrib.runtime.encoding = Operand::Encoding::MEMORY_OFFSET;
+
+	context->ChangeState(Operands);
 }
 
 void MethodP(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodQ(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodR(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodS(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodU(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodV(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodW(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodX(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodY(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_NOT_READ);
 	context->ChangeState(Operands);
 
 }
 
 void MethodZ(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_Z);
 	instr.activeOperand->attrib.runtime.encoding = Operand::Encoding::OPCODE_REGISTER;
 
 	context->ChangeState(Operands);
@@ -604,6 +722,7 @@ void MethodZ(LinearDecoder * context, Instruction &instr)
 
 void MethodRegister(LinearDecoder * context, Instruction &instr)
 {
+	DECODER_COUNT_STATE(context, METHOD_REGISTER);
 	context->ChangeState(Operands);
 }
 
@@ -7,6 +7,7 @@
 #include "../../util/common.h"
 
 #include "instruction.h"
+#include "counters.h"
 
 namespace State_x86
 {
@@ -62,12 +63,19 @@ void MethodRegister(LinearDecoder * context, Instruction &instr);
 namespace ISet_x86
 {
 
+class DecoderContext;
+
 // "Linear" as opposed to recursive descent, which is the better but more complex and difficult
 // way of implementing a disassembler
 class LinearDecoder
 {
 public:
+	// Both decode with DecoderContext::Shared
 	LinearDecoder(std::vector<byte> * section);
+	// Only decode the bytes in [begin, end) of the section, where begin must be an instruction boundary
+	LinearDecoder(std::vector<byte> * section, unsigned int begin, unsigned int end);
+	// The context is shared, not copied, and must outlive the decoder
+	LinearDecoder(std::vector<byte> * section, unsigned int begin, unsigned int end, const DecoderContext &context);
 
 	std::vector<Instruction> DecodeSection();
 
@@ -80,16 +88,27 @@ public:
 	bool ReverseByte();
 	void NextInstruction();
 	void ChangeState(funcptr newState);
+	const DecoderContext & Context() const { return *context; }
+
+#ifdef DISASM_COUNTERS
+	DecoderCounters & Counters();
+#endif
 
 private:
 	funcptr state {};
 	Instruction currentInstr {};
 	byte currentByte {};
 	unsigned int byteOffset {}; // The index of the next byte to be read
+	unsigned int endOffset {}; // One past the last byte that may be read
 	unsigned int stateLoopCounter {}; // Used to check for an infinite loop
 
+	const DecoderContext * context {};
 	std::vector<byte> * section {}; // The current section (.text/.init/etc.) being parsed
 	std::vector<Instruction> instructions {}; // Decoded instructions or data segments
+
+#ifdef DISASM_COUNTERS
+	DecoderCounters counters {};
+#endif
 };
 
 using namespace State_x86;	
@@ -97,7 +116,7 @@ using namespace State_x86;
 class AddrMethodHandler
 {
 public:
-	funcptr at(AddrMethod method);
+	funcptr at(AddrMethod method) const;
 
 private:
 
@@ -142,7 +161,4 @@ private:
     };
 };
 
-extern AddrMethodHandler addrMethodHandler;
-extern std::unordered_map<ThreeByteKey, uint16_t, ThreeByteHash> threeByteReference;
-
 };
@@ -0,0 +1,93 @@
+#include <algorithm>
+
+#include "fingerprint.h"
+#include "cfg.h"
+#include "../../util/hash.h"
+
+namespace ISet_x86
+{
+
+uint64_t NormalisedToken(const Instruction &instr)
+{
+	if (!instr.attrib.flags.resolved)
+	{
+		return HashMix(UINT16_MAX);
+	}
+
+	uint64_t token = HashMix(instr.attrib.intrinsic.referenceId);
+	token = HashCombine(token, instr.HasPrefix(0x66));
+
+	for (auto op : {&instr.op1, &instr.op2, &instr.op3, &instr.op4})
+	{
+		token = HashCombine(token, static_cast<uint64_t>(op->attrib.runtime.encoding + 1));
+	}
+
+	return token;
+}
+
+FunctionFingerprint FingerprintFunction(const std::vector<Instruction> &instrs, uint32_t first, uint32_t last,
+	uint64_t sectionAddress, const BranchTargets &targets, Arena &arena)
+{
+	FunctionFingerprint print {};
+	if (first >= last)
+	{
+		return print;
+	}
+
+	ControlFlowGraph cfg(instrs, first, last, sectionAddress, targets, arena);
+
+	print.address = sectionAddress + instrs[first].attrib.runtime.segmentByteOffset;
+	print.instrCount = last - first;
+	print.blockCount = cfg.BlockCount();
+	print.edgeCount = cfg.EdgeCount();
+
+	uint64_t hash = HashCombine(HashMix(print.blockCount), print.edgeCount);
+	uint64_t previous = 0;
+	for (uint32_t b = 0; b < cfg.BlockCount(); b++)
+	{
+		auto &block = cfg.Block(b);
+
+		uint64_t blockHash = HashMix(block.instrCount);
+		for (uint32_t i = block.firstInstr; i < block.firstInstr + block.instrCount; i++)
+		{
+			uint64_t token = NormalisedToken(instrs[i]);
+			blockHash = HashCombine(blockHash, token);
+
+			// Pairs of neighbouring instructions keep some ordering in the similarity features
+			print.features.push_back(HashCombine(previous, token));
+			previous = token;
+		}
+
+		// Blocks are in address order, so successors are recorded by their distance in blocks,
+		// which stays the same when the function moves
+		hash = HashCombine(hash, blockHash);
+		for (auto succ = cfg.SuccessorsBegin(b); succ != cfg.SuccessorsEnd(b); succ++)
+		{
+			hash = HashCombine(hash, static_cast<uint64_t>(static_cast<int64_t>(*succ) - b));
+		}
+
+		print.features.push_back(blockHash);
+	}
+
+	print.hash = hash;
+	std::sort(print.features.begin(), print.features.end());
+
+	// Shingles run across block boundaries, short functions become a single shingle
+	uint32_t shingleCount = (print.instrCount > SHINGLE_LENGTH) ? print.instrCount - SHINGLE_LENGTH + 1 : 1;
+	for (uint32_t s = 0; s < shingleCount; s++)
+	{
+		uint64_t shingle = 0;
+		for (uint32_t i = first + s; i < std::min(last, first + s + SHINGLE_LENGTH); i++)
+		{
+			shingle = HashCombine(shingle, NormalisedToken(instrs[i]));
+		}
+		print.shingles.push_back(shingle);
+	}
+
+	std::sort(print.shingles.begin(), print.shingles.end());
+	print.shingles.erase(std::unique(print.shingles.begin(), print.shingles.end()), print.shingles.end());
+
+	return print;
+}
+
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <vector>
+
+#include "../../util/arena.h"
+#include "../../analysis/diff.h"
+#include "instruction.h"
+#include "targets.h"
+
+namespace ISet_x86
+{
+
+// Identifies the opcode, operand size and operand classes of an instruction, but not its
+// registers, displacements or immediates, which change with addresses and register allocation
+uint64_t NormalisedToken(const Instruction &instr);
+
+// Length of the instruction n-grams that fingerprints are shingled into
+const unsigned int SHINGLE_LENGTH = 3;
+
+// Fingerprint of instrs[first, last). Per-block hashes of the normalised tokens are combined
+// with the shape of the function's control flow graph, which is built in the arena
+FunctionFingerprint FingerprintFunction(const std::vector<Instruction> &instrs, uint32_t first, uint32_t last,
+	uint64_t sectionAddress, const BranchTargets &targets, Arena &arena);
+
+};
@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+#include "gadget.h"
+#include "decode.h"
+#include "translate.h"
+#include "../../util/simd.h"
+
+namespace ISet_x86
+{
+
+const byte RET = 0xC3;
+const byte RET_IMM16 = 0xC2;
+const byte GROUP5 = 0xFF; // call/jmp r/m32 when the ModRM reg field is 2 or 4
+
+// Written the way NASM takes them in front of an instruction
+const std::map<byte, std::string> prefixString
+{
+	{ 0xF0, "lock" },
+	{ 0xF2, "repne" },
+	{ 0xF3, "rep" },
+	{ 0x2E, "cs" },
+	{ 0x36, "ss" },
+	{ 0x3E, "ds" },
+	{ 0x26, "es" },
+	{ 0x64, "fs" },
+	{ 0x65, "gs" },
+	{ 0x66, "o16" },
+	{ 0x67, "a16" }
+};
+
+GadgetFinder::GadgetFinder(Segment segment, unsigned int depth)
+{
+	this->segment = segment;
+	this->depth = depth;
+}
+
+std::vector<GadgetFinder::Site> GadgetFinder::FindSites()
+{
+	std::vector<Site> sites {};
+
+	for (auto &range : *segment.index)
+	{
+		auto &section = segment.seg->at(range.name);
+
+		std::vector<uint32_t> positions {};
+		FindBytes(section.data(), section.size(), {RET, RET_IMM16, GROUP5}, positions);
+
+		for (auto pos : positions)
+		{
+			byte b = section[pos];
+			if (b == RET)
+			{
+				sites.push_back({&section, range.range.begin, pos, pos + 1});
+			}
+
+			else if (b == RET_IMM16 && pos + 3 <= section.size())
+			{
+				sites.push_back({&section, range.range.begin, pos, pos + 3});
+			}
+
+			else if (b == GROUP5 && pos + 1 < section.size())
+			{
+				int reg = (section[pos + 1] >> 3) & 0b111;
+				if (reg != 2 && reg != 4)
+				{
+					continue;
+				}
+
+				// The ModRM byte decides the length, so the terminator itself is decoded
+				unsigned int limit = std::min<std::size_t>(pos + MAX_INSTRUCTION_SIZE, section.size());
+				auto decoder = LinearDecoder(&section, pos, limit);
+				auto instrs = decoder.DecodeSection();
+				if (!instrs.empty() && instrs[0].attrib.flags.resolved)
+				{
+					sites.push_back({&section, range.range.begin, pos, pos + instrs[0].attrib.runtime.size});
+				}
+			}
+		}
+	}
+
+	return sites;
+}
+
+std::string GadgetFinder::GadgetText(const std::vector<Instruction> &instrs, const Site &site)
+{
+	auto translator = Translator(std::vector<Instruction>(), site.section, site.address);
+
+	std::string text {};
+	for (auto &instr : instrs)
+	{
+		if (!text.empty())
+		{
+			text += "; ";
+		}
+
+		auto operands = translator.OperandStrings(instr);
+		bool rendered = std::none_of(operands.begin(), operands.end(), [](const std::string &op)
+		{
+			return op.empty();
+		});
+
+		if (rendered)
+		{
+			// Prefixes change what the instruction does, so every one is written out
+			for (unsigned int p = 0; p < instr.attrib.runtime.prefixCount; p++)
+			{
+				text += prefixString.at(site.section->at(instr.attrib.runtime.segmentByteOffset + p)) + " ";
+			}
+
+			text += instr.attrib.intrinsic.mnemonic;
+			for (std::size_t o = 0; o < operands.size(); o++)
+			{
+				text += (o == 0 ? " " : ",") + operands[o];
+			}
+		}
+
+		// Some operands (implied registers, string operands) aren't rendered by the translator,
+		// so those instructions are given as their encoding rather than left out
+		else
+		{
+			std::stringstream bytes {};
+			bytes << "db ";
+			for (unsigned int b = 0; b < instr.attrib.runtime.size; b++)
+			{
+				bytes << (b == 0 ? "0x" : ",0x") << std::hex << (int)site.section->at(instr.attrib.runtime.segmentByteOffset + b);
+			}
+			text += bytes.str();
+		}
+	}
+
+	return text;
+}
+
+void GadgetFinder::FindGadgets(const Site &site, std::vector<Gadget> &found)
+{
+	// The terminator is one of the depth instructions
+	unsigned int maxBack = (depth - 1) * MAX_INSTRUCTION_SIZE;
+	unsigned int lowest = (site.offset > maxBack) ? site.offset - maxBack : 0;
+
+	for (unsigned int start = site.offset + 1; start-- > lowest;)
+	{
+		auto decoder = LinearDecoder(site.section, start, site.end);
+		auto instrs = decoder.DecodeSection();
+
+		// The decode has to land exactly on the terminator (or prefixes of it), and nothing
+		// before it may transfer control or fail to decode
+		if (instrs.empty() || instrs.size() > depth)
+		{
+			continue;
+		}
+
+		auto &last = instrs.back();
+		bool valid = last.attrib.flags.resolved && last.attrib.runtime.segmentByteOffset + last.attrib.runtime.prefixCount == site.offset
+			&& last.attrib.runtime.segmentByteOffset + last.attrib.runtime.size == site.end;
+
+		for (std::size_t i = 0; valid && i + 1 < instrs.size(); i++)
+		{
+			valid = instrs[i].attrib.flags.resolved && instrs[i].attrib.intrinsic.flow == ControlFlow::SEQUENTIAL;
+		}
+
+		if (valid)
+		{
+			found.push_back({site.address + start, 1, GadgetText(instrs, site)});
+		}
+	}
+}
+
+std::vector<Gadget> GadgetFinder::Find(unsigned int threadCount)
+{
+	auto sites = FindSites();
+
+	std::vector<std::vector<Gadget>> perThread(std::max(1u, std::min(threadCount, static_cast<unsigned int>(sites.size()))));
+	std::atomic<unsigned int> next {0};
+
+	// Sites are handed out in small batches, since some take far longer than others
+	const unsigned int batch = 64;
+	auto worker = [&](unsigned int t)
+	{
+		for (unsigned int i = next.fetch_add(batch); i < sites.size(); i = next.fetch_add(batch))
+		{
+			for (unsigned int s = i; s < std::min<std::size_t>(i + batch, sites.size()); s++)
+			{
+				FindGadgets(sites[s], perThread[t]);
+			}
+		}
+	};
+
+	std::vector<std::thread> threads {};
+	for (unsigned int t = 1; t < perThread.size(); t++)
+	{
+		threads.emplace_back(worker, t);
+	}
+	worker(0);
+
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	// Gadgets that read the same are merged, keeping the lowest address. Different encodings of
+	// one instruction sequence (a disp8 or disp32 of 0, the two forms of mov reg, reg) are one
+	std::unordered_map<std::string, Gadget> unique {};
+	for (auto &found : perThread)
+	{
+		for (auto &gadget : found)
+		{
+			auto entry = unique.emplace(gadget.text, gadget);
+			if (!entry.second)
+			{
+				entry.first->second.count++;
+				entry.first->second.address = std::min(entry.first->second.address, gadget.address);
+			}
+		}
+	}
+
+	std::vector<Gadget> gadgets {};
+	for (auto &entry : unique)
+	{
+		gadgets.push_back(entry.second);
+	}
+
+	std::sort(gadgets.begin(), gadgets.end(), [](const Gadget &a, const Gadget &b)
+	{
+		return a.address < b.address;
+	});
+
+	return gadgets;
+}
+
+};
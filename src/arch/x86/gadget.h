@@ -0,0 +1,48 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../../util/common.h"
+#include "../../format/format.h"
+#include "instruction.h"
+
+namespace ISet_x86
+{
+
+struct Gadget
+{
+	uint64_t address {}; // Lowest address the gadget was found at
+	uint32_t count {}; // Number of places it was found
+	std::string text {}; // Instructions separated by "; ", which merged gadgets share
+};
+
+class GadgetFinder
+// Finds instruction sequences that end in a return or an indirect jump or call. Candidate
+// terminator bytes are found with a vector scan, then every start that makes a gadget of up to
+// depth instructions is decoded forwards and kept if it runs cleanly into the terminator
+{
+public:
+	GadgetFinder(Segment segment, unsigned int depth);
+
+	// Gadgets sorted by address, identical instruction sequences reported once
+	std::vector<Gadget> Find(unsigned int threadCount);
+
+private:
+	Segment segment;
+	unsigned int depth;
+
+	struct Site
+	{
+		std::vector<byte> * section;
+		uint64_t address; // Of the section
+		uint32_t offset; // Of the terminator
+		uint32_t end; // One past the terminator
+	};
+
+	std::vector<Site> FindSites();
+	void FindGadgets(const Site &site, std::vector<Gadget> &found);
+	std::string GadgetText(const std::vector<Instruction> &instrs, const Site &site);
+};
+
+};
@@ -4,6 +4,7 @@
 #include <sstream>
 
 #include "instruction.h"
+#include "context.h"
 
 namespace ISet_x86
 {
@@ -53,7 +54,92 @@ void Instruction::UpdateAttributes(const Instruction &reference)
 	encoded.opcode.extension = reference.encoded.opcode.extension;
 }
 
-void Instruction::InterpretModRMByte(const byte modrmByte)
+bool Instruction::HasRelativeTarget() const
+{
+	return op1.attrib.runtime.encoding == Operand::RELATIVE_DISPLACEMENT
+		|| op2.attrib.runtime.encoding == Operand::RELATIVE_DISPLACEMENT;
+}
+
+uint64_t Instruction::RelativeTarget(uint64_t sectionAddress) const
+{
+	uint64_t next = sectionAddress + attrib.runtime.segmentByteOffset + attrib.runtime.size;
+	uint64_t target = next + static_cast<int64_t>(encoded.rel);
+
+	// With a 16-bit operand size the instruction pointer is cut to its low word
+	return HasPrefix(0x66) ? (target & 0xFFFF) : target;
+}
+
+bool Instruction::AbsoluteMemoryAddress(uint64_t &address) const
+{
+	bool absolute = false;
+
+	if (op1.attrib.runtime.encoding == Operand::MEMORY_OFFSET || op2.attrib.runtime.encoding == Operand::MEMORY_OFFSET)
+	{
+		absolute = true;
+	}
+
+	else if (attrib.flags.modRMRead && encoded.modrm.modBits == 0b00)
+	{
+		// [disp32], or [index*scale + disp32] when the SIB byte has no base register
+		absolute = (encoded.modrm.rmBits == 0b101 && !attrib.flags.hasSIB)
+			|| (attrib.flags.hasSIB && encoded.sib.baseBits == 0b101);
+	}
+
+	if (absolute)
+	{
+		address = encoded.disp;
+	}
+
+	return absolute;
+}
+
+bool Instruction::HasImmediate() const
+{
+	return op1.attrib.runtime.encoding == Operand::IMMD || op2.attrib.runtime.encoding == Operand::IMMD
+		|| op3.attrib.runtime.encoding == Operand::IMMD;
+}
+
+bool Instruction::HasPrefix(byte prefix) const
+{
+	for (int i = 0; i < attrib.runtime.prefixCount && i < static_cast<int>(encoded.prefix.size()); i++)
+	{
+		if (encoded.prefix[i] == prefix)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+uint8_t Instruction::OperandByteSize() const
+{
+	return OperandByteSize(*activeOperand);
+}
+
+uint8_t Instruction::OperandByteSize(const Operand &op) const
+{
+	switch (op.attrib.intrinsic.type)
+	{
+		case OperandType::b:
+		case OperandType::bs:
+		case OperandType::bss:
+			return 1;
+		case OperandType::w:
+			return 2;
+		case OperandType::v:
+		case OperandType::z:
+		case OperandType::vds:
+		case OperandType::vqp:
+		case OperandType::vs:
+			// The operand-size prefix shrinks these to a word
+			return HasPrefix(0x66) ? 2 : 4;
+		default:
+			return 4;
+	}
+}
+
+void Instruction::InterpretModRMByte(const byte modrmByte, const InstructionReference &references)
 {
 	attrib.flags.modRMRead = true;
 
@@ -105,8 +191,7 @@ void Instruction::InterpretModRMByte(const byte modrmByte)
 	if (encoded.opcode.extension != INVALID)
 	{
 		encoded.opcode.extension = encoded.modrm.regOpBits;
-		auto reference = instrReference.GetReference(encoded.opcode);
-		UpdateAttributes(reference);
+		UpdateAttributes(references.GetReference(encoded.opcode));
 	}
 
 }
@@ -125,7 +210,8 @@ void Instruction::InterpretSIBByte(byte sibByte)
 	if (encoded.sib.baseBits == 0b101 && encoded.modrm.modBits == 0b00)
 	// Displacement-only
 	{
-			
+		attrib.flags.hasDisplacement = true;
+		attrib.runtime.displacementSize = 4;
 	}
 
 	else if (encoded.sib.baseBits == 0b101 && (encoded.modrm.modBits == 0b10 && encoded.modrm.modBits == 0b01))
@@ -155,6 +241,7 @@ std::ostream & operator<<(std::ostream &out, const Instruction &instr)
 
 	out << std::hex << "displacement: " << instr.encoded.disp << '\n';
 	out << std::hex << "immd: " << instr.encoded.immd << '\n';
+	out << std::dec << "rel: " << instr.encoded.rel << '\n';
 
 	return out;
 }
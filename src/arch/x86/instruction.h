@@ -14,6 +14,7 @@ namespace ISet_x86
 
 class LinearDecoder;
 class Instruction;
+class InstructionReference;
 
 using funcptr = void (*)(LinearDecoder * context, Instruction &instr);
 
@@ -75,7 +76,8 @@ public:
 		MODRM_REGISTER_RMBITS, // When the REG and RM fields of the ModRM byte are flipped
 		MODRM_REGISTER_WITH_DISP,
 		MODRM_REGISTER_SCALED,
-		MODRM_REGISTER_SCALED_WITH_DISP
+		MODRM_REGISTER_SCALED_WITH_DISP,
+		MEMORY_OFFSET // Absolute address encoded in the instruction, without a ModRM byte
     };
 
 	struct OperandAttributes
@@ -95,6 +97,41 @@ public:
 	} attrib {};
 };
 
+// How an instruction affects the flow of execution, used to split the instruction
+// stream into basic blocks
+enum class ControlFlow : uint8_t
+{
+	SEQUENTIAL,
+	CALL, // Execution continues after the call returns
+	JUMP,
+	CONDITIONAL_JUMP,
+	INDIRECT_JUMP, // Target is only known at runtime
+	RETURN,
+	HALT
+};
+
+// Bits of the EFLAGS masks
+const uint8_t FLAG_O = 1 << 0;
+const uint8_t FLAG_D = 1 << 1;
+const uint8_t FLAG_I = 1 << 2;
+const uint8_t FLAG_S = 1 << 3;
+const uint8_t FLAG_Z = 1 << 4;
+const uint8_t FLAG_A = 1 << 5;
+const uint8_t FLAG_P = 1 << 6;
+const uint8_t FLAG_C = 1 << 7;
+
+// Bits of the register masks, one per general-purpose register at the position of its ModRM
+// number. Partial registers (al, ah, ax) set the bit of the register they are part of
+const uint8_t REG_EAX = 1 << 0;
+const uint8_t REG_ECX = 1 << 1;
+const uint8_t REG_EDX = 1 << 2;
+const uint8_t REG_EBX = 1 << 3;
+const uint8_t REG_ESP = 1 << 4;
+const uint8_t REG_EBP = 1 << 5;
+const uint8_t REG_ESI = 1 << 6;
+const uint8_t REG_EDI = 1 << 7;
+const uint8_t REG_ALL = 0xFF;
+
 class Instruction
 {
 public:
@@ -118,16 +155,29 @@ public:
 			std::string group2 {"UNRESOLVED"};
 			std::string group3 {"UNRESOLVED"};
 
-			std::string testedFlags {"UNRESOLVED"};
-			std::string modifiedFlags {"UNRESOLVED"};
-			std::string definedFlags {"UNRESOLVED"};
-			std::string undefinedFlags {"UNRESOLVED"};
-			std::string flagValues {"UNRESOLVED"};
+			// EFLAGS masks, see FLAG_O and on
+			uint8_t testedFlags {};
+			uint8_t modifiedFlags {};
+			uint8_t definedFlags {};
+			uint8_t undefinedFlags {};
+			uint8_t flagValues {}; // Flags always left with the same value
+			uint8_t setFlags {}; // The flags of flagValues that are left set, the rest are cleared
+
+			// Register masks of the registers the instruction always reads or writes, whether
+			// implicitly or as a hardcoded operand, see REG_EAX and on
+			uint8_t registersRead {};
+			uint8_t registersWritten {};
+			// Bit n is set if operand n+1 is read or written
+			uint8_t operandsRead {};
+			uint8_t operandsWritten {};
 
 			std::string brief {"UNRESOLVED"};
 
             bool x86Exclusive {};
             bool x64Exclusive {};
+
+			ControlFlow flow {ControlFlow::SEQUENTIAL};
+			uint16_t referenceId {NO_REFERENCE}; // Position in the reference table, dense from 1
 		} intrinsic {};
 
 		struct Runtime
@@ -184,6 +234,7 @@ public:
 
 		unsigned int disp {}; 	  // Displacement constant used by certain addressing modes
 		unsigned int immd {}; // Constant operand encoded after instruction
+		int32_t rel {}; // Sign-extended branch offset, relative to the end of the instruction
     } encoded {};
 
     Operand op1 {};
@@ -193,17 +244,32 @@ public:
 
 	Operand * activeOperand;
 	
-	void InterpretModRMByte(const byte modrmByte);
+	// Opcode extensions in the reg bits are resolved against the reference
+	void InterpretModRMByte(const byte modrmByte, const InstructionReference &references);
 	void InterpretSIBByte(const byte sibByte);
 
 	void UpdateAttributes(const Instruction &reference);
 
+	// Whether an operand is a relative jump/call displacement
+	bool HasRelativeTarget() const;
+	// Absolute address that the relative displacement leads to, given the address of the section
+	uint64_t RelativeTarget(uint64_t sectionAddress) const;
+
+	// Whether a memory operand is addressed by its displacement alone (or by a displacement
+	// plus a scaled index, as with jump tables), in which case address is set to it
+	bool AbsoluteMemoryAddress(uint64_t &address) const;
+
+	bool HasImmediate() const;
+	bool HasPrefix(byte prefix) const;
+	// Returns size of the active operand's immediate data in bytes based on prefix & type
+	uint8_t OperandByteSize() const;
+	uint8_t OperandByteSize(const Operand &op) const;
+
 	friend std::ostream & operator<<(std::ostream &out, const Instruction &instr);
 
 private:
 	// Gives either a 16-bit or 32-bit register based on the presence of the 0x67 prefix
 	OperandType ModRMRegValue(int rmBits);
-	uint8_t OperandByteSize(); // Returns size of operand in bytes based on prefix & type
 };
 
 };
@@ -0,0 +1,578 @@
+#include <algorithm>
+
+#include "ir.h"
+#include "cfg.h"
+#include "../../util/hash.h"
+
+namespace ISet_x86
+{
+
+namespace
+{
+
+// ModRM numbers of the hardcoded register families, in the order of the AddrMethod enum
+const uint8_t HARDCODED_FAMILIES[] = {0, 3, 1, 2, 6, 7, 5, 4};
+
+bool HardcodedRegister(AddrMethod method)
+{
+	int value = static_cast<int>(method);
+	return value >= static_cast<int>(AddrMethod::AH) && value <= static_cast<int>(AddrMethod::ESP);
+}
+
+// Code after a block that can't fall through is only reachable by a branch, so it gets a label
+bool FallsThrough(const Instruction &instr)
+{
+	auto flow = instr.attrib.intrinsic.flow;
+	return flow != ControlFlow::JUMP && flow != ControlFlow::INDIRECT_JUMP && flow != ControlFlow::RETURN && flow != ControlFlow::HALT;
+}
+
+uint8_t ConditionCode(const Instruction &instr)
+{
+	return instr.encoded.opcode.primary & 0x0F;
+}
+
+// Byte registers 4 to 7 are the high bytes of 0 to 3
+uint32_t RegisterFamily(const IRValue &value)
+{
+	return (value.size == 1) ? (value.index & 0b11) : value.index;
+}
+
+bool Overlaps(const IRValue &written, const IRValue &read)
+{
+	return written.kind == IRValue::REGISTER && read.kind == IRValue::REGISTER && RegisterFamily(written) == RegisterFamily(read);
+}
+
+};
+
+Lifter::Lifter(const std::vector<Instruction> &instrs, uint64_t sectionAddress, const BranchTargets &targets, Arena &arena)
+	: instrs(instrs), sectionAddress(sectionAddress), targets(targets), arena(arena)
+{
+}
+
+IRFunction Lifter::Lift(uint32_t first, uint32_t last)
+{
+	IRFunction func {};
+	if (first >= last)
+	{
+		return func;
+	}
+
+	// No instruction interns more than three constants
+	uint32_t maxConstants = 3 * (last - first) + 1;
+	uint32_t slotCount = 1;
+	while (slotCount < 2 * maxConstants)
+	{
+		slotCount <<= 1;
+	}
+
+	constants = arena.AllocateArray<uint32_t>(maxConstants);
+	slots = arena.AllocateArray<uint32_t>(slotCount);
+	slotMask = slotCount - 1;
+	constantCount = 0;
+	temporaryCount = 0;
+
+	ControlFlowGraph cfg(instrs, first, last, sectionAddress, targets, arena);
+	func.address = sectionAddress + instrs[first].attrib.runtime.segmentByteOffset;
+	func.blockCount = cfg.BlockCount();
+	func.blocks = arena.AllocateArray<IRBlock>(func.blockCount);
+
+	for (uint32_t b = 0; b < cfg.BlockCount(); b++)
+	{
+		const auto &block = cfg.Block(b);
+		head = nullptr;
+		tail = nullptr;
+		flags = nullptr; // Flags aren't followed across blocks
+
+		for (uint32_t i = block.firstInstr; i < block.firstInstr + block.instrCount; i++)
+		{
+			source = i;
+			auto previous = tail;
+			LiftInstruction(instrs[i]);
+			DropStaleFlags(previous == nullptr ? head : previous->next);
+		}
+
+		func.blocks[b].address = block.address;
+		func.blocks[b].labelled = targets.Contains(block.address) || (b > 0 && !FallsThrough(instrs[block.firstInstr - 1]));
+		func.blocks[b].first = head;
+	}
+
+	func.constants = constants;
+	func.constantCount = constantCount;
+	func.temporaryCount = temporaryCount;
+	return func;
+}
+
+void Lifter::DropStaleFlags(const IRInstruction * first)
+{
+	const IRValue esp {IRValue::REGISTER, 4, 4};
+
+	bool stale = false;
+	for (auto instr = first; instr != nullptr && flags != nullptr; instr = instr->next)
+	{
+		// Only writes after the compare matter
+		if (instr == flags)
+		{
+			stale = false;
+			continue;
+		}
+
+		bool movesStack = instr->op == IROp::PUSH || instr->op == IROp::POP || instr->op == IROp::CALL;
+		for (auto &read : {flags->a, flags->b})
+		{
+			stale |= Overlaps(instr->dst, read) || (movesStack && Overlaps(esp, read));
+		}
+	}
+
+	if (stale)
+	{
+		flags = nullptr;
+	}
+}
+
+IRValue Lifter::Constant(uint32_t value, uint8_t size)
+{
+	uint32_t slot = HashMix(value) & slotMask;
+	while (slots[slot] != 0 && constants[slots[slot] - 1] != value)
+	{
+		slot = (slot + 1) & slotMask;
+	}
+
+	if (slots[slot] == 0)
+	{
+		constants[constantCount++] = value;
+		slots[slot] = constantCount;
+	}
+
+	return {IRValue::CONSTANT, size, slots[slot] - 1};
+}
+
+IRValue Lifter::Temporary(uint8_t size)
+{
+	return {IRValue::TEMPORARY, size, temporaryCount++};
+}
+
+IRInstruction * Lifter::Emit(IROp op, IRValue dst, IRValue a, IRValue b)
+{
+	auto instr = arena.AllocateArray<IRInstruction>(1);
+	instr->op = op;
+	instr->dst = dst;
+	instr->a = a;
+	instr->b = b;
+	instr->source = source;
+
+	if (tail == nullptr)
+	{
+		head = instr;
+	}
+	else
+	{
+		tail->next = instr;
+	}
+
+	tail = instr;
+	return instr;
+}
+
+bool Lifter::IsMemory(const Instruction &instr, const Operand &op)
+{
+	auto method = op.attrib.intrinsic.addrMethod;
+	if (method == AddrMethod::O)
+	{
+		return true;
+	}
+
+	return (method == AddrMethod::E || method == AddrMethod::M) && instr.encoded.modrm.modBits != 0b11;
+}
+
+IRAddress Lifter::Address(const Instruction &instr, const Operand &op)
+{
+	IRAddress mem {};
+	mem.size = instr.OperandByteSize(op);
+	mem.disp = static_cast<int32_t>(instr.encoded.disp);
+
+	if (op.attrib.intrinsic.addrMethod == AddrMethod::O)
+	{
+		return mem;
+	}
+
+	const auto &modrm = instr.encoded.modrm;
+	const auto &sib = instr.encoded.sib;
+
+	if (!instr.attrib.flags.hasSIB)
+	{
+		if (!(modrm.modBits == 0b00 && modrm.rmBits == 0b101))
+		{
+			mem.base = {IRValue::REGISTER, 4, modrm.rmBits};
+		}
+
+		return mem;
+	}
+
+	if (!(modrm.modBits == 0b00 && sib.baseBits == 0b101))
+	{
+		mem.base = {IRValue::REGISTER, 4, sib.baseBits};
+	}
+
+	if (sib.indexBits != 0b100)
+	{
+		mem.index = {IRValue::REGISTER, 4, sib.indexBits};
+		mem.scale = 1 << sib.scaleBits;
+	}
+
+	return mem;
+}
+
+IRValue Lifter::Read(const Instruction &instr, const Operand &op, uint8_t size)
+{
+	auto method = op.attrib.intrinsic.addrMethod;
+	const auto &modrm = instr.encoded.modrm;
+	uint8_t opSize = instr.OperandByteSize(op);
+
+	// With byte registers, 4 to 7 are ah to bh, which the value's index keeps as is
+	switch (method)
+	{
+		case AddrMethod::G:
+			return {IRValue::REGISTER, opSize, modrm.regOpBits};
+		case AddrMethod::Z:
+			return {IRValue::REGISTER, opSize, static_cast<uint32_t>(instr.encoded.opcode.primary & 0b111)};
+		case AddrMethod::E:
+		case AddrMethod::R:
+			if (modrm.modBits == 0b11)
+			{
+				return {IRValue::REGISTER, opSize, modrm.rmBits};
+			}
+			break;
+		case AddrMethod::I:
+		{
+			uint32_t value = instr.encoded.immd;
+			if (opSize == 1 && size > 1 && (op.attrib.intrinsic.type == OperandType::bs || op.attrib.intrinsic.type == OperandType::bss))
+			{
+				value = static_cast<uint32_t>(static_cast<int8_t>(value));
+			}
+			return Constant(value, size);
+		}
+		case AddrMethod::J:
+			return Constant(instr.RelativeTarget(sectionAddress));
+		default:
+			break;
+	}
+
+	if (HardcodedRegister(method))
+	{
+		int value = static_cast<int>(method);
+		uint8_t number = HARDCODED_FAMILIES[value / 100 - 1];
+		int part = value % 100;
+
+		if (value < static_cast<int>(AddrMethod::SI))
+		{
+			// ah, al, ax, or eax and its operand-size variants
+			if (part == 1)
+			{
+				return {IRValue::REGISTER, 1, static_cast<uint32_t>(number + 4)};
+			}
+			return {IRValue::REGISTER, static_cast<uint8_t>(part == 2 ? 1 : (part == 3 ? 2 : opSize)), number};
+		}
+
+		return {IRValue::REGISTER, static_cast<uint8_t>(part == 1 ? 2 : opSize), number};
+	}
+
+	if (IsMemory(instr, op))
+	{
+		auto temp = Temporary(opSize);
+		Emit(IROp::LOAD, temp)->mem = Address(instr, op);
+		return temp;
+	}
+
+	return {};
+}
+
+void Lifter::Write(const Instruction &instr, const Operand &op, IRValue value)
+{
+	if (IsMemory(instr, op))
+	{
+		Emit(IROp::STORE, {}, value)->mem = Address(instr, op);
+		return;
+	}
+
+	auto dst = Read(instr, op, value.size);
+	if (dst.kind == IRValue::REGISTER && !(dst.kind == value.kind && dst.index == value.index && dst.size == value.size))
+	{
+		Emit(IROp::ASSIGN, dst, value);
+	}
+}
+
+void Lifter::LiftBinary(const Instruction &instr, IROp op)
+{
+	uint8_t size = instr.OperandByteSize(instr.op1);
+	IRValue a = Read(instr, instr.op1, size);
+	IRValue b {};
+
+	const std::string &mnem = instr.attrib.intrinsic.mnemonic;
+	if (mnem == "inc" || mnem == "dec" || instr.op2.attrib.intrinsic.addrMethod == AddrMethod::NOT_APPLICABLE)
+	{
+		b = Constant(1, size);
+	}
+	else
+	{
+		b = Read(instr, instr.op2, size);
+	}
+
+	if (a.kind == IRValue::REGISTER)
+	{
+		Emit(op, a, a, b);
+		return;
+	}
+
+	auto result = Temporary(size);
+	Emit(op, result, a, b);
+	Write(instr, instr.op1, result);
+}
+
+void Lifter::LiftInstruction(const Instruction &instr)
+{
+	const auto &intrinsic = instr.attrib.intrinsic;
+	const std::string &mnem = intrinsic.mnemonic;
+	const auto &opcode = instr.encoded.opcode;
+
+	if (!instr.attrib.flags.resolved)
+	{
+		Emit(IROp::INTRINSIC);
+		flags = nullptr;
+		return;
+	}
+
+	// Only general-purpose register, immediate and ModRM memory operands are lifted
+	bool supported = intrinsic.group1 == "gen" && !instr.HasPrefix(0xF0) && !instr.HasPrefix(0x67);
+	for (auto op : {&instr.op1, &instr.op2, &instr.op3})
+	{
+		auto method = op->attrib.intrinsic.addrMethod;
+		supported &= method == AddrMethod::NOT_APPLICABLE || method == AddrMethod::G || method == AddrMethod::E
+			|| method == AddrMethod::M || method == AddrMethod::R || method == AddrMethod::Z || method == AddrMethod::I
+			|| method == AddrMethod::J || method == AddrMethod::O || HardcodedRegister(method);
+	}
+
+	if (!supported)
+	{
+		Emit(IROp::INTRINSIC);
+		flags = nullptr;
+		return;
+	}
+
+	uint8_t size = instr.OperandByteSize(instr.op1);
+
+	if (mnem == "nop" || mnem == "hint_nop")
+	{
+		return;
+	}
+
+	else if (mnem == "mov")
+	{
+		if (!IsMemory(instr, instr.op1) && IsMemory(instr, instr.op2))
+		{
+			Emit(IROp::LOAD, Read(instr, instr.op1, size))->mem = Address(instr, instr.op2);
+		}
+		else
+		{
+			Write(instr, instr.op1, Read(instr, instr.op2, size));
+		}
+	}
+
+	else if (mnem == "movzx" || mnem == "movsx")
+	{
+		auto value = Read(instr, instr.op2, instr.OperandByteSize(instr.op2));
+		Emit(mnem == "movzx" ? IROp::ZERO_EXTEND : IROp::SIGN_EXTEND, Read(instr, instr.op1, size), value);
+	}
+
+	else if (mnem == "lea")
+	{
+		Emit(IROp::ADDRESS, Read(instr, instr.op1, size))->mem = Address(instr, instr.op2);
+	}
+
+	else if (mnem == "add" || mnem == "inc")
+	{
+		LiftBinary(instr, IROp::ADD);
+		flags = nullptr;
+	}
+
+	else if (mnem == "sub" || mnem == "dec")
+	{
+		LiftBinary(instr, IROp::SUB);
+		flags = nullptr;
+	}
+
+	else if (mnem == "and" || mnem == "or" || mnem == "xor")
+	{
+		LiftBinary(instr, mnem == "and" ? IROp::AND : (mnem == "or" ? IROp::OR : IROp::XOR));
+
+		// The flags follow the result, as they would for a test of it with itself. A memory
+		// result is stored from a temporary
+		auto result = (tail->op == IROp::STORE) ? tail->a : tail->dst;
+		auto compare = Emit(IROp::COMPARE, {}, result, result);
+		compare->test = true;
+		flags = compare;
+	}
+
+	else if (mnem == "shl" || mnem == "sal" || mnem == "shr" || mnem == "sar")
+	{
+		LiftBinary(instr, mnem == "shr" ? IROp::SHR : (mnem == "sar" ? IROp::SAR : IROp::SHL));
+		flags = nullptr;
+	}
+
+	else if (mnem == "imul" && instr.op2.attrib.intrinsic.addrMethod != AddrMethod::NOT_APPLICABLE)
+	{
+		if (instr.op3.attrib.intrinsic.addrMethod == AddrMethod::NOT_APPLICABLE)
+		{
+			LiftBinary(instr, IROp::MUL);
+		}
+		else
+		{
+			auto a = Read(instr, instr.op2, size);
+			auto b = Read(instr, instr.op3, size);
+			Emit(IROp::MUL, Read(instr, instr.op1, size), a, b);
+		}
+		flags = nullptr;
+	}
+
+	else if (mnem == "neg" || mnem == "not")
+	{
+		auto value = Read(instr, instr.op1, size);
+		auto result = (value.kind == IRValue::REGISTER) ? value : Temporary(size);
+		Emit(mnem == "neg" ? IROp::NEG : IROp::NOT, result, value);
+		Write(instr, instr.op1, result);
+		flags = (mnem == "not") ? flags : nullptr;
+	}
+
+	else if (mnem == "cmp" || mnem == "test")
+	{
+		auto a = Read(instr, instr.op1, size);
+		auto b = Read(instr, instr.op2, size);
+		auto compare = Emit(IROp::COMPARE, {}, a, b);
+		compare->test = mnem == "test";
+		flags = compare;
+	}
+
+	else if (mnem == "push")
+	{
+		Emit(IROp::PUSH, {}, Read(instr, instr.op1, size));
+	}
+
+	else if (mnem == "pop")
+	{
+		if (IsMemory(instr, instr.op1))
+		{
+			auto value = Temporary(size);
+			Emit(IROp::POP, value);
+			Write(instr, instr.op1, value);
+		}
+		else
+		{
+			Emit(IROp::POP, Read(instr, instr.op1, size));
+		}
+	}
+
+	else if (mnem == "leave")
+	{
+		Emit(IROp::ASSIGN, {IRValue::REGISTER, 4, 4}, {IRValue::REGISTER, 4, 5});
+		Emit(IROp::POP, {IRValue::REGISTER, 4, 5});
+	}
+
+	else if (mnem == "cdq")
+	{
+		Emit(IROp::SAR, {IRValue::REGISTER, 4, 2}, {IRValue::REGISTER, 4, 0}, Constant(31));
+	}
+
+	else if (mnem == "cwde")
+	{
+		Emit(IROp::SIGN_EXTEND, {IRValue::REGISTER, 4, 0}, {IRValue::REGISTER, 2, 0});
+	}
+
+	else if (mnem == "xchg" && !IsMemory(instr, instr.op1) && !IsMemory(instr, instr.op2))
+	{
+		auto a = Read(instr, instr.op1, size);
+		auto b = Read(instr, instr.op2, size);
+		if (a.index != b.index)
+		{
+			auto temp = Temporary(size);
+			Emit(IROp::ASSIGN, temp, a);
+			Emit(IROp::ASSIGN, a, b);
+			Emit(IROp::ASSIGN, b, temp);
+		}
+	}
+
+	else if (intrinsic.flow == ControlFlow::CALL && mnem == "call")
+	{
+		Emit(IROp::CALL, {IRValue::REGISTER, 4, 0}, Read(instr, instr.op1, 4));
+		flags = nullptr;
+	}
+
+	else if (intrinsic.flow == ControlFlow::JUMP)
+	{
+		Emit(IROp::JUMP, {}, Read(instr, instr.op1, 4));
+	}
+
+	else if (intrinsic.flow == ControlFlow::INDIRECT_JUMP && mnem == "jmp")
+	{
+		Emit(IROp::INDIRECT_JUMP, {}, Read(instr, instr.op1, 4));
+	}
+
+	else if (intrinsic.flow == ControlFlow::CONDITIONAL_JUMP && mnem == "loop")
+	{
+		// ecx = ecx - 1; if (ecx != 0) goto target
+		IRValue ecx {IRValue::REGISTER, 4, 1};
+		Emit(IROp::SUB, ecx, ecx, Constant(1));
+		auto compare = Emit(IROp::COMPARE, {}, ecx, Constant(0));
+		auto branch = Emit(IROp::BRANCH, {}, Read(instr, instr.op1, 4));
+		branch->condition = 0x5;
+		branch->flags = compare;
+	}
+
+	else if (intrinsic.flow == ControlFlow::CONDITIONAL_JUMP && (mnem == "jecxz" || mnem == "jcxz"))
+	{
+		auto compare = Emit(IROp::COMPARE, {}, {IRValue::REGISTER, 4, 1}, Constant(0));
+		auto branch = Emit(IROp::BRANCH, {}, Read(instr, instr.op1, 4));
+		branch->condition = 0x4;
+		branch->flags = compare;
+	}
+
+	else if (intrinsic.flow == ControlFlow::CONDITIONAL_JUMP && (opcode.twoByte ? (opcode.primary & 0xF0) == 0x80 : (opcode.primary & 0xF0) == 0x70))
+	{
+		auto branch = Emit(IROp::BRANCH, {}, Read(instr, instr.op1, 4));
+		branch->condition = ConditionCode(instr);
+		branch->flags = flags;
+	}
+
+	else if (intrinsic.flow == ControlFlow::RETURN && mnem == "retn")
+	{
+		Emit(IROp::RETURN, {}, {IRValue::REGISTER, 4, 0});
+	}
+
+	else if (opcode.twoByte && (opcode.primary & 0xF0) == 0x90) // setcc
+	{
+		bool memory = IsMemory(instr, instr.op1);
+		auto dst = memory ? Temporary(1) : Read(instr, instr.op1, 1);
+		auto set = Emit(IROp::SET, dst);
+		set->condition = ConditionCode(instr);
+		set->flags = flags;
+
+		if (memory)
+		{
+			Write(instr, instr.op1, dst);
+		}
+	}
+
+	else if (opcode.twoByte && (opcode.primary & 0xF0) == 0x40) // cmovcc
+	{
+		auto value = Read(instr, instr.op2, size);
+		auto move = Emit(IROp::CONDITIONAL_ASSIGN, Read(instr, instr.op1, size), value);
+		move->condition = ConditionCode(instr);
+		move->flags = flags;
+	}
+
+	else
+	{
+		Emit(IROp::INTRINSIC);
+		flags = nullptr;
+	}
+}
+
+};
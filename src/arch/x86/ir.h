@@ -0,0 +1,149 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../../util/common.h"
+#include "../../util/arena.h"
+#include "instruction.h"
+#include "targets.h"
+
+namespace ISet_x86
+{
+
+enum class IROp : uint8_t
+{
+	ASSIGN, // dst = a
+	ZERO_EXTEND,
+	SIGN_EXTEND,
+	LOAD, // dst = *mem
+	STORE, // *mem = a
+	ADDRESS, // dst = &mem
+	ADD,
+	SUB,
+	MUL,
+	AND,
+	OR,
+	XOR,
+	SHL,
+	SHR,
+	SAR,
+	NEG,
+	NOT,
+	COMPARE, // Sets the flags from a - b, or from a & b when test is set
+	SET, // dst = condition
+	CONDITIONAL_ASSIGN, // if (condition) dst = a
+	PUSH,
+	POP,
+	CALL, // eax = a()
+	JUMP,
+	BRANCH, // if (condition) goto a
+	INDIRECT_JUMP,
+	RETURN,
+	INTRINSIC // Anything that isn't lifted, kept as its mnemonic
+};
+
+struct IRValue
+{
+	enum Kind : uint8_t
+	{
+		NONE,
+		REGISTER, // ModRM register number, with 4 to 7 being ah to bh for byte values
+		TEMPORARY,
+		CONSTANT // Position in the function's constant pool
+	};
+
+	Kind kind {NONE};
+	uint8_t size {4}; // Bytes
+	uint32_t index {};
+};
+
+struct IRAddress
+{
+	IRValue base {};
+	IRValue index {};
+	uint8_t scale {1};
+	int32_t disp {};
+	uint8_t size {4}; // Of the value loaded or stored
+};
+
+struct IRInstruction
+{
+	IROp op {};
+	uint8_t condition {}; // x86 condition code, for SET, CONDITIONAL_ASSIGN and BRANCH
+	bool test {}; // For COMPARE
+	IRValue dst {};
+	IRValue a {};
+	IRValue b {};
+	IRAddress mem {}; // For LOAD, STORE and ADDRESS
+	const IRInstruction * flags {}; // The COMPARE a condition was set by, if it is known
+	uint32_t source {}; // Index of the x86 instruction in the decoded stream
+	IRInstruction * next {};
+};
+
+struct IRBlock
+{
+	uint64_t address {};
+	bool labelled {}; // Whether anything branches to it, or nothing falls through to it
+	IRInstruction * first {};
+};
+
+struct IRFunction
+{
+	uint64_t address {};
+	IRBlock * blocks {};
+	uint32_t blockCount {};
+	const uint32_t * constants {}; // Interned, each value once
+	uint32_t constantCount {};
+	uint32_t temporaryCount {}; // Temporaries are numbered densely from 0
+};
+
+class Lifter
+// Lifts decoded x86 into three-address IR, one function at a time. Everything a function's IR
+// is made of is allocated in the arena, which has to outlive the returned IRFunction
+{
+public:
+	Lifter(const std::vector<Instruction> &instrs, uint64_t sectionAddress, const BranchTargets &targets, Arena &arena);
+
+	IRFunction Lift(uint32_t first, uint32_t last);
+
+private:
+	const std::vector<Instruction> &instrs;
+	uint64_t sectionAddress;
+	const BranchTargets &targets;
+	Arena &arena;
+
+	// Open addressing table of the constant pool, sized for the function being lifted
+	uint32_t * constants {};
+	uint32_t * slots {}; // Pool position + 1, 0 when empty
+	uint32_t slotMask {};
+	uint32_t constantCount {};
+	uint32_t temporaryCount {};
+
+	IRInstruction * head {};
+	IRInstruction * tail {};
+	const IRInstruction * flags {}; // Last COMPARE in the current block
+	uint32_t source {};
+
+	IRValue Constant(uint32_t value, uint8_t size = 4);
+	IRValue Temporary(uint8_t size);
+	IRInstruction * Emit(IROp op, IRValue dst = {}, IRValue a = {}, IRValue b = {});
+
+	IRAddress Address(const Instruction &instr, const Operand &op);
+	bool IsMemory(const Instruction &instr, const Operand &op);
+	// Value of a register, immediate or memory operand, loading it into a temporary if needed
+	IRValue Read(const Instruction &instr, const Operand &op, uint8_t size);
+	void Write(const Instruction &instr, const Operand &op, IRValue value);
+
+	// Forgets the last COMPARE if an IR instruction from first on writes a register it read, as
+	// a condition built from it would show the register's new value
+	void DropStaleFlags(const IRInstruction * first);
+
+	void LiftInstruction(const Instruction &instr);
+	void LiftBinary(const Instruction &instr, IROp op);
+};
+
+// Pseudo-C text of a lifted function, one statement per line
+std::vector<std::string> PrintPseudoC(const IRFunction &func, const std::vector<Instruction> &instrs);
+
+};
@@ -0,0 +1,318 @@
+#include <algorithm>
+
+#include "liveness.h"
+
+namespace ISet_x86
+{
+
+namespace
+{
+
+RegisterSet GeneralRegister(uint8_t number, int size)
+{
+	// With byte operands, 4 to 7 encode ah, ch, dh and bh
+	if (size == 1)
+	{
+		number &= 0b011;
+	}
+
+	return 1u << number;
+}
+
+RegisterSet AddressRegisters(const Instruction &instr)
+{
+	const auto &modrm = instr.encoded.modrm;
+	const auto &sib = instr.encoded.sib;
+
+	if (!instr.attrib.flags.hasSIB)
+	{
+		return (modrm.modBits == 0b00 && modrm.rmBits == 0b101) ? 0 : 1u << modrm.rmBits;
+	}
+
+	RegisterSet set = 0;
+	if (!(modrm.modBits == 0b00 && sib.baseBits == 0b101))
+	{
+		set |= 1u << sib.baseBits;
+	}
+
+	if (sib.indexBits != 0b100)
+	{
+		set |= 1u << sib.indexBits;
+	}
+
+	return set;
+}
+
+bool IsStringInstruction(const Instruction &instr)
+{
+	return instr.attrib.intrinsic.group2.find("string") != std::string::npos;
+}
+
+};
+
+UseDef InstructionUseDef(const Instruction &instr)
+{
+	UseDef sets {};
+	if (!instr.attrib.flags.resolved)
+	{
+		return sets;
+	}
+
+	const auto &intrinsic = instr.attrib.intrinsic;
+	const auto &modrm = instr.encoded.modrm;
+
+	uint8_t flagsWritten = intrinsic.modifiedFlags | intrinsic.definedFlags | intrinsic.undefinedFlags | intrinsic.flagValues;
+	sets.use = intrinsic.registersRead | intrinsic.testedFlags << FLAGS_SHIFT;
+	sets.def = intrinsic.registersWritten | flagsWritten << FLAGS_SHIFT;
+
+	const Operand * ops[] = {&instr.op1, &instr.op2, &instr.op3, &instr.op4};
+	for (int i = 0; i < 4; i++)
+	{
+		const Operand &op = *ops[i];
+		int size = instr.OperandByteSize(op);
+		RegisterSet reg = 0;
+
+		switch (op.attrib.intrinsic.addrMethod)
+		{
+			case AddrMethod::G:
+				reg = GeneralRegister(modrm.regOpBits, size);
+				break;
+			case AddrMethod::E:
+			case AddrMethod::R:
+				if (modrm.modBits == 0b11)
+				{
+					reg = GeneralRegister(modrm.rmBits, size);
+				}
+				else
+				{
+					sets.use |= AddressRegisters(instr);
+				}
+				break;
+			case AddrMethod::M:
+			case AddrMethod::Q:
+			case AddrMethod::W:
+				if (modrm.modBits != 0b11)
+				{
+					sets.use |= AddressRegisters(instr);
+				}
+				break;
+			case AddrMethod::Z:
+				reg = GeneralRegister(instr.encoded.opcode.primary & 0b111, size);
+				break;
+			default:
+				break;
+		}
+
+		if (intrinsic.operandsRead >> i & 1)
+		{
+			sets.use |= reg;
+		}
+
+		if (intrinsic.operandsWritten >> i & 1)
+		{
+			sets.def |= reg;
+
+			// The rest of the register keeps its value
+			if (size < 4)
+			{
+				sets.use |= reg;
+			}
+		}
+	}
+
+	// xor and sub of a register with itself don't depend on its value
+	if ((intrinsic.mnemonic == "xor" || intrinsic.mnemonic == "sub") && modrm.modBits == 0b11 && modrm.rmBits == modrm.regOpBits
+	&& instr.OperandByteSize(instr.op1) == 4)
+	{
+		sets.use &= ~GeneralRegister(modrm.rmBits, 4);
+	}
+
+	if (IsStringInstruction(instr) && (instr.HasPrefix(0xF3) || instr.HasPrefix(0xF2)))
+	{
+		sets.use |= REG_ECX;
+		sets.def |= REG_ECX;
+	}
+
+	if (intrinsic.flow == ControlFlow::CALL)
+	{
+		sets.def |= CALL_CLOBBERED;
+	}
+
+	return sets;
+}
+
+bool WritesOnlyRegisters(const Instruction &instr)
+{
+	const auto &intrinsic = instr.attrib.intrinsic;
+
+	// Stack, string, port and locked instructions all touch memory or devices
+	if (!instr.attrib.flags.resolved || intrinsic.flow != ControlFlow::SEQUENTIAL || intrinsic.group1 != "gen"
+	|| (intrinsic.registersWritten & REG_ESP) || IsStringInstruction(instr) || intrinsic.group2 == "inout" || instr.HasPrefix(0xF0))
+	{
+		return false;
+	}
+
+	const Operand * ops[] = {&instr.op1, &instr.op2, &instr.op3, &instr.op4};
+	for (int i = 0; i < 4; i++)
+	{
+		if (!(intrinsic.operandsWritten >> i & 1))
+		{
+			continue;
+		}
+
+		auto method = ops[i]->attrib.intrinsic.addrMethod;
+		int value = static_cast<int>(method);
+
+		bool generalRegister = method == AddrMethod::G || method == AddrMethod::Z || method == AddrMethod::R
+			|| (method == AddrMethod::E && instr.encoded.modrm.modBits == 0b11)
+			|| (value >= static_cast<int>(AddrMethod::AH) && value <= static_cast<int>(AddrMethod::ESP));
+
+		if (!generalRegister)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+std::string RegisterSetString(RegisterSet set)
+{
+	const char * names[] = {"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi", "of", "df", "if", "sf", "zf", "af", "pf", "cf"};
+
+	std::string text {};
+	for (int i = 0; i < 16; i++)
+	{
+		if (set >> i & 1)
+		{
+			text += (text.empty() ? "" : " ") + std::string(names[i]);
+		}
+	}
+
+	return text;
+}
+
+// ***** Liveness *****
+Liveness::Liveness(const ControlFlowGraph &cfg, const std::vector<Instruction> &instrs, Arena &arena)
+	: cfg(cfg), instrs(instrs)
+{
+	uint32_t blockCount = cfg.BlockCount();
+	blockSets = arena.AllocateArray<UseDef>(blockCount);
+	liveIn = arena.AllocateArray<RegisterSet>(blockCount);
+	liveOut = arena.AllocateArray<RegisterSet>(blockCount);
+
+	if (blockCount == 0)
+	{
+		return;
+	}
+
+	const auto &lastBlock = cfg.Block(blockCount - 1);
+	firstInstr = cfg.Block(0).firstInstr;
+	instrSets = arena.AllocateArray<UseDef>(lastBlock.firstInstr + lastBlock.instrCount - firstInstr);
+
+	// Use and def of each block, from its instructions in reverse
+	RegisterSet * exitLive = arena.AllocateArray<RegisterSet>(blockCount);
+	for (uint32_t b = 0; b < blockCount; b++)
+	{
+		const auto &block = cfg.Block(b);
+		auto &sets = blockSets[b];
+
+		for (uint32_t i = block.firstInstr + block.instrCount; i-- > block.firstInstr;)
+		{
+			auto instrSet = InstructionUseDef(instrs[i]);
+			instrSets[i - firstInstr] = instrSet;
+			sets.use = (sets.use & ~instrSet.def) | instrSet.use;
+			sets.def |= instrSet.def;
+		}
+
+		exitLive[b] = ExitLive(b);
+	}
+
+	// Blocks are mostly laid out in execution order, so visiting them in reverse settles
+	// most functions in one or two passes
+	bool changed = true;
+	while (changed)
+	{
+		changed = false;
+		for (uint32_t b = blockCount; b-- > 0;)
+		{
+			RegisterSet out = exitLive[b];
+			for (auto succ = cfg.SuccessorsBegin(b); succ != cfg.SuccessorsEnd(b); succ++)
+			{
+				out |= liveIn[*succ];
+			}
+
+			RegisterSet in = blockSets[b].use | (out & ~blockSets[b].def);
+			changed |= in != liveIn[b] || out != liveOut[b];
+			liveIn[b] = in;
+			liveOut[b] = out;
+		}
+	}
+}
+
+RegisterSet Liveness::ExitLive(uint32_t block) const
+{
+	const auto &b = cfg.Block(block);
+	const auto &last = instrs[b.firstInstr + b.instrCount - 1];
+	uint64_t sectionAddress = b.address - instrs[b.firstInstr].attrib.runtime.segmentByteOffset;
+
+	switch (last.attrib.intrinsic.flow)
+	{
+		case ControlFlow::RETURN:
+			return RETURN_LIVE;
+		case ControlFlow::HALT:
+			return 0;
+		case ControlFlow::INDIRECT_JUMP:
+			return ALL_REGISTERS;
+		case ControlFlow::JUMP:
+		case ControlFlow::CONDITIONAL_JUMP:
+			// A branch out of the function is taken to be a tail call
+			if (!last.HasRelativeTarget() || cfg.FindBlock(last.RelativeTarget(sectionAddress)) == ControlFlowGraph::NO_BLOCK)
+			{
+				return RETURN_LIVE;
+			}
+			return 0;
+		default:
+			// Falling off the end of the function into whatever follows
+			return (block + 1 < cfg.BlockCount()) ? 0 : ALL_REGISTERS;
+	}
+}
+
+RegisterSet Liveness::LiveIn(uint32_t block) const
+{
+	return liveIn[block];
+}
+
+RegisterSet Liveness::LiveOut(uint32_t block) const
+{
+	return liveOut[block];
+}
+
+std::vector<uint32_t> Liveness::DeadDefinitions() const
+{
+	std::vector<uint32_t> dead {};
+
+	for (uint32_t b = cfg.BlockCount(); b-- > 0;)
+	{
+		const auto &block = cfg.Block(b);
+		RegisterSet live = liveOut[b];
+
+		for (uint32_t i = block.firstInstr + block.instrCount; i-- > block.firstInstr;)
+		{
+			const auto &sets = instrSets[i - firstInstr];
+			// Stack pointer adjustments are kept, as they also allocate and free stack memory
+			bool candidate = (sets.def & REG_ALL) != 0 && !(sets.def & REG_ESP) && WritesOnlyRegisters(instrs[i]);
+			if (candidate && (sets.def & live) == 0)
+			{
+				dead.push_back(i);
+			}
+
+			live = (live & ~sets.def) | sets.use;
+		}
+	}
+
+	std::reverse(dead.begin(), dead.end());
+	return dead;
+}
+
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "../../util/arena.h"
+#include "instruction.h"
+#include "cfg.h"
+
+namespace ISet_x86
+{
+
+// The general-purpose registers in the low byte, with the bits of the REG_ masks, and the
+// EFLAGS bits of the FLAG_ masks in the byte above
+using RegisterSet = uint32_t;
+
+const unsigned int FLAGS_SHIFT = 8;
+const RegisterSet ALL_REGISTERS = 0xFFFF;
+const RegisterSet ALL_FLAGS = 0xFF << FLAGS_SHIFT;
+// Live when a function returns under cdecl: the result and the callee-saved registers
+const RegisterSet RETURN_LIVE = REG_EAX | REG_EBX | REG_ESI | REG_EDI | REG_EBP | REG_ESP;
+// Clobbered by any call under cdecl
+const RegisterSet CALL_CLOBBERED = REG_EAX | REG_ECX | REG_EDX | ALL_FLAGS;
+
+struct UseDef
+{
+	RegisterSet use {}; // Read before the instruction writes anything
+	RegisterSet def {};
+};
+
+// Registers and flags the instruction reads and writes, including the registers that address
+// its memory operands. Writes to partial registers also count as reads of the full register
+UseDef InstructionUseDef(const Instruction &instr);
+
+// Whether the instruction's only effect is on registers and flags, so that it can be removed
+// when nothing it writes is live
+bool WritesOnlyRegisters(const Instruction &instr);
+
+// Space separated register and flag names, such as "eax esp zf"
+std::string RegisterSetString(RegisterSet set);
+
+class Liveness
+// Backward liveness of one function's graph, solved over its blocks with one word per set
+{
+public:
+	// The graph must have been built from instrs, and the arena must outlive the analysis
+	Liveness(const ControlFlowGraph &cfg, const std::vector<Instruction> &instrs, Arena &arena);
+
+	RegisterSet LiveIn(uint32_t block) const;
+	RegisterSet LiveOut(uint32_t block) const;
+
+	// Indices of the instructions that write only registers, none of which are live after them
+	std::vector<uint32_t> DeadDefinitions() const;
+
+private:
+	const ControlFlowGraph &cfg;
+	const std::vector<Instruction> &instrs;
+
+	UseDef * instrSets {}; // Indexed from the first instruction of the graph
+	UseDef * blockSets {};
+	RegisterSet * liveIn {};
+	RegisterSet * liveOut {};
+	uint32_t firstInstr {};
+
+	// Live after the block when it has no successors in the graph
+	RegisterSet ExitLive(uint32_t block) const;
+};
+
+};
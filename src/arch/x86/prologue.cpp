@@ -0,0 +1,232 @@
+#include <algorithm>
+
+#include "prologue.h"
+#include "decode.h"
+#include "../../util/simd.h"
+
+namespace ISet_x86
+{
+
+const byte PUSH_EBP = 0x55;
+const byte REP_PREFIX = 0xF3; // First byte of endbr32/endbr64
+const byte INT3 = 0xCC;
+const byte NOP = 0x90;
+const byte RETN = 0xC3;
+const byte JMP_REL8 = 0xEB;
+const byte JMP_REL32 = 0xE9;
+const byte HLT = 0xF4;
+const byte OPERAND_SIZE_PREFIX = 0x66;
+const byte CS_PREFIX = 0x2E;
+
+// The multi-byte nops compilers pad with: lea esi/edi onto itself and nop dword [eax+0], in
+// each displacement size. Longer padding only puts 0x66 and 0x2E prefixes in front of these
+const std::vector<std::vector<byte>> PADDING_NOPS =
+{
+	{0x89, 0xF6},
+	{0x8D, 0x76, 0x00},
+	{0x8D, 0x7F, 0x00},
+	{0x8D, 0x74, 0x26, 0x00},
+	{0x8D, 0x7C, 0x27, 0x00},
+	{0x8D, 0xB6, 0x00, 0x00, 0x00, 0x00},
+	{0x8D, 0xBF, 0x00, 0x00, 0x00, 0x00},
+	{0x8D, 0xB4, 0x26, 0x00, 0x00, 0x00, 0x00},
+	{0x8D, 0xBC, 0x27, 0x00, 0x00, 0x00, 0x00},
+	{0x0F, 0x1F, 0x00},
+	{0x0F, 0x1F, 0x40, 0x00},
+	{0x0F, 0x1F, 0x44, 0x00, 0x00},
+	{0x0F, 0x1F, 0x80, 0x00, 0x00, 0x00, 0x00},
+	{0x0F, 0x1F, 0x84, 0x00, 0x00, 0x00, 0x00, 0x00}
+};
+
+const int FUNCTION_ALIGNMENT = 16;
+const int ENDBR_SIZE = 4;
+
+PrologueScanner::PrologueScanner(Segment segment)
+{
+	this->segment = segment;
+}
+
+std::vector<uint64_t> PrologueScanner::Scan()
+{
+	std::vector<uint64_t> starts {};
+
+	for (auto &section : (*segment.seg))
+	{
+		uint64_t address = segment.addr->at(section.first);
+		for (auto offset : FindCandidates(section.second, address))
+		{
+			if (Validate(&section.second, offset))
+			{
+				starts.push_back(address + offset);
+			}
+		}
+	}
+
+	std::sort(starts.begin(), starts.end());
+	return starts;
+}
+
+std::vector<uint32_t> PrologueScanner::FindCandidates(const std::vector<byte> &section, uint64_t address)
+{
+	std::vector<uint32_t> candidates {};
+	const byte * data = section.data();
+	std::size_t size = section.size();
+
+	if (size == 0)
+	{
+		return candidates;
+	}
+
+	// Only the first byte of each prologue is searched for with vector compares, the rest
+	// of the pattern is checked on the (much rarer) hits
+	std::vector<uint32_t> anchors {};
+	FindBytes(data, size, {PUSH_EBP, REP_PREFIX}, anchors);
+
+	auto isEndbr = [&](uint32_t i)
+	{
+		return i + ENDBR_SIZE <= size && data[i] == REP_PREFIX && data[i + 1] == 0x0F && data[i + 2] == 0x1E
+			&& (data[i + 3] == 0xFB || data[i + 3] == 0xFA);
+	};
+
+	for (auto i : anchors)
+	{
+		if (isEndbr(i))
+		{
+			candidates.push_back(i);
+		}
+
+		// mov ebp, esp has two encodings
+		else if (data[i] == PUSH_EBP && i + 2 < size
+		&& ((data[i + 1] == 0x89 && data[i + 2] == 0xE5) || (data[i + 1] == 0x8B && data[i + 2] == 0xEC)))
+		{
+			// A push ebp directly after endbr is part of the same prologue
+			if (!(i >= ENDBR_SIZE && isEndbr(i - ENDBR_SIZE)))
+			{
+				candidates.push_back(i);
+			}
+		}
+	}
+
+	// Compilers pad between functions up to the alignment boundary, so an aligned byte after
+	// padding or a return is likely the start of the next function. Padding is stepped over
+	// backwards from the boundary, since only its last instruction is known to end there
+	auto paddingStart = [&](uint32_t i)
+	{
+		bool stepped = true;
+		while (stepped && i > 0)
+		{
+			stepped = false;
+			if (data[i - 1] == INT3 || data[i - 1] == NOP)
+			{
+				i--;
+				stepped = true;
+			}
+
+			for (auto &nop : PADDING_NOPS)
+			{
+				if (!stepped && nop.size() <= i && std::equal(nop.begin(), nop.end(), data + i - nop.size()))
+				{
+					i -= nop.size();
+					stepped = true;
+				}
+			}
+
+			while (stepped && i > 0 && (data[i - 1] == OPERAND_SIZE_PREFIX || data[i - 1] == CS_PREFIX))
+			{
+				i--;
+			}
+		}
+
+		return i;
+	};
+
+	// Loops and branch targets are aligned with the same padding, but code runs into them. Only
+	// int3 padding, which is never executed, or padding after a return, jmp or hlt is kept
+	auto followsPadding = [&](uint32_t i)
+	{
+		uint32_t start = paddingStart(i);
+		if (start == i)
+		{
+			return data[i - 1] == RETN;
+		}
+
+		return data[i - 1] == INT3
+			|| (start >= 1 && (data[start - 1] == RETN || data[start - 1] == HLT))
+			|| (start >= 2 && data[start - 2] == JMP_REL8)
+			|| (start >= 5 && data[start - 5] == JMP_REL32);
+	};
+
+	// Padding longer than the alignment runs on past a boundary
+	auto startsPadding = [&](uint32_t i)
+	{
+		while (i < size && (data[i] == OPERAND_SIZE_PREFIX || data[i] == CS_PREFIX))
+		{
+			i++;
+		}
+
+		if (i == size || data[i] == INT3 || data[i] == NOP)
+		{
+			return true;
+		}
+
+		for (auto &nop : PADDING_NOPS)
+		{
+			if (i + nop.size() <= size && std::equal(nop.begin(), nop.end(), data + i))
+			{
+				return true;
+			}
+		}
+
+		return false;
+	};
+
+	// The section start is always a candidate, so the first boundary checked is the one after it
+	uint32_t first = (FUNCTION_ALIGNMENT - (address % FUNCTION_ALIGNMENT)) % FUNCTION_ALIGNMENT;
+	for (uint32_t i = (first == 0) ? FUNCTION_ALIGNMENT : first; i < size; i += FUNCTION_ALIGNMENT)
+	{
+		if (followsPadding(i) && !startsPadding(i))
+		{
+			candidates.push_back(i);
+		}
+	}
+
+	candidates.push_back(0);
+
+	std::sort(candidates.begin(), candidates.end());
+	candidates.erase(std::unique(candidates.begin(), candidates.end()), candidates.end());
+
+	return candidates;
+}
+
+bool PrologueScanner::Validate(std::vector<byte> * section, uint32_t offset)
+// Data and padding that happen to match a pattern rarely decode as several valid instructions
+{
+	const unsigned int windowSize = 4 * MAX_INSTRUCTION_SIZE;
+	const unsigned int minInstructions = 4;
+
+	auto decoder = LinearDecoder(section, offset, offset + windowSize);
+	auto instrs = decoder.DecodeSection();
+	if (instrs.empty())
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0; i < instrs.size() && i < minInstructions; i++)
+	{
+		if (!instrs[i].attrib.flags.resolved)
+		{
+			return false;
+		}
+
+		// A short function may legitimately end before the minimum
+		auto flow = instrs[i].attrib.intrinsic.flow;
+		if (flow == ControlFlow::RETURN || flow == ControlFlow::JUMP || flow == ControlFlow::INDIRECT_JUMP)
+		{
+			break;
+		}
+	}
+
+	return true;
+}
+
+};
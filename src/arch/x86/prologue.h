@@ -0,0 +1,29 @@
+#pragma once
+
+#include <vector>
+
+#include "../../util/common.h"
+#include "../../format/format.h"
+
+namespace ISet_x86
+{
+
+class PrologueScanner
+// Finds likely function starts in code without symbols or unwind information. Candidates are
+// common prologues (push ebp; mov ebp, esp and endbr32/64) and aligned code following padding,
+// and are only kept if the decoder can make sense of the instructions that follow
+{
+public:
+	PrologueScanner(Segment segment);
+
+	// Addresses of the validated candidates, sorted
+	std::vector<uint64_t> Scan();
+
+private:
+	Segment segment;
+
+	std::vector<uint32_t> FindCandidates(const std::vector<byte> &section, uint64_t address);
+	bool Validate(std::vector<byte> * section, uint32_t offset);
+};
+
+};
@@ -0,0 +1,283 @@
+#include <sstream>
+
+#include "ir.h"
+
+namespace ISet_x86
+{
+
+namespace
+{
+
+const char * CONDITION_NAMES[] = {"o", "no", "b", "ae", "e", "ne", "be", "a", "s", "ns", "p", "np", "l", "ge", "le", "g"};
+
+class Printer
+{
+public:
+	Printer(const IRFunction &func, const std::vector<Instruction> &instrs)
+		: func(func), instrs(instrs)
+	{
+	}
+
+	std::string Value(const IRValue &value) const
+	{
+		const char * names[][8] = {
+			{"al", "cl", "dl", "bl", "ah", "ch", "dh", "bh"},
+			{"ax", "cx", "dx", "bx", "sp", "bp", "si", "di"},
+			{"eax", "ecx", "edx", "ebx", "esp", "ebp", "esi", "edi"}};
+
+		std::stringstream text {};
+		switch (value.kind)
+		{
+			case IRValue::REGISTER:
+				text << names[value.size == 1 ? 0 : (value.size == 2 ? 1 : 2)][value.index & 0b111];
+				break;
+			case IRValue::TEMPORARY:
+				text << 't' << value.index;
+				break;
+			case IRValue::CONSTANT:
+				text << "0x" << std::hex << func.constants[value.index];
+				break;
+			default:
+				text << '?';
+				break;
+		}
+
+		return text.str();
+	}
+
+	std::string Address(const IRAddress &mem) const
+	{
+		std::stringstream text {};
+		if (mem.base.kind != IRValue::NONE)
+		{
+			text << Value(mem.base);
+		}
+
+		if (mem.index.kind != IRValue::NONE)
+		{
+			text << (text.tellp() > 0 ? " + " : "") << Value(mem.index);
+			if (mem.scale > 1)
+			{
+				text << " * " << static_cast<int>(mem.scale);
+			}
+		}
+
+		if (text.tellp() == 0)
+		{
+			text << "0x" << std::hex << static_cast<uint32_t>(mem.disp);
+		}
+		else if (mem.disp != 0)
+		{
+			uint32_t magnitude = (mem.disp < 0) ? 0u - static_cast<uint32_t>(mem.disp) : static_cast<uint32_t>(mem.disp);
+			text << (mem.disp < 0 ? " - 0x" : " + 0x") << std::hex << magnitude;
+		}
+
+		return text.str();
+	}
+
+	std::string Memory(const IRAddress &mem) const
+	{
+		return "*(" + Type(mem.size, false) + " *)(" + Address(mem) + ")";
+	}
+
+	static std::string Type(uint8_t size, bool isSigned)
+	{
+		return std::string(isSigned ? "int" : "uint") + std::to_string(size * 8) + "_t";
+	}
+
+	std::string Condition(const IRInstruction &instr) const
+	{
+		const IRInstruction * compare = instr.flags;
+		std::string fallback = std::string("cond_") + CONDITION_NAMES[instr.condition];
+		if (compare == nullptr)
+		{
+			return fallback;
+		}
+
+		std::string a = Value(compare->a);
+		std::string b = Value(compare->b);
+		std::string signedType = "(" + Type(compare->a.size, true) + ")";
+
+		if (compare->test)
+		{
+			// Carry and overflow are clear after a test, leaving only the value of a & b
+			bool same = compare->a.kind == compare->b.kind && compare->a.index == compare->b.index;
+			std::string value = same ? a : "(" + a + " & " + b + ")";
+			switch (instr.condition)
+			{
+				case 0x4: case 0x6: return value + " == 0";
+				case 0x5: case 0x7: return value + " != 0";
+				case 0x8: case 0xC: return signedType + value + " < 0";
+				case 0x9: case 0xD: return signedType + value + " >= 0";
+				case 0xE: return signedType + value + " <= 0";
+				case 0xF: return signedType + value + " > 0";
+				default: return fallback;
+			}
+		}
+
+		const char * relation = nullptr;
+		bool isSigned = false;
+		switch (instr.condition)
+		{
+			case 0x2: relation = " < "; break;
+			case 0x3: relation = " >= "; break;
+			case 0x4: relation = " == "; break;
+			case 0x5: relation = " != "; break;
+			case 0x6: relation = " <= "; break;
+			case 0x7: relation = " > "; break;
+			case 0xC: relation = " < "; isSigned = true; break;
+			case 0xD: relation = " >= "; isSigned = true; break;
+			case 0xE: relation = " <= "; isSigned = true; break;
+			case 0xF: relation = " > "; isSigned = true; break;
+			case 0x8: return signedType + "(" + a + " - " + b + ") < 0";
+			case 0x9: return signedType + "(" + a + " - " + b + ") >= 0";
+			default: return fallback;
+		}
+
+		if (isSigned)
+		{
+			return signedType + a + relation + signedType + b;
+		}
+
+		return a + relation + b;
+	}
+
+	std::string Target(const IRValue &value, const char * prefix) const
+	{
+		std::stringstream text {};
+		text << prefix << std::hex << func.constants[value.index];
+		return text.str();
+	}
+
+	std::string Statement(const IRInstruction &instr) const
+	{
+		std::string dst = Value(instr.dst);
+		std::string a = Value(instr.a);
+		std::string b = Value(instr.b);
+
+		const char * binary = nullptr;
+		switch (instr.op)
+		{
+			case IROp::ADD: binary = " + "; break;
+			case IROp::SUB: binary = " - "; break;
+			case IROp::MUL: binary = " * "; break;
+			case IROp::AND: binary = " & "; break;
+			case IROp::OR: binary = " | "; break;
+			case IROp::XOR: binary = " ^ "; break;
+			case IROp::SHL: binary = " << "; break;
+			case IROp::SHR: binary = " >> "; break;
+			case IROp::SAR: return dst + " = (" + Type(instr.a.size, true) + ")" + a + " >> " + b + ";";
+			default: break;
+		}
+
+		if (binary != nullptr)
+		{
+			// xor and sub of a value with itself are how registers are cleared
+			bool same = instr.a.kind == instr.b.kind && instr.a.index == instr.b.index && instr.a.size == instr.b.size;
+			if (same && (instr.op == IROp::XOR || instr.op == IROp::SUB))
+			{
+				return dst + " = 0;";
+			}
+
+			if (dst == a)
+			{
+				return dst + std::string(binary).substr(0, std::string(binary).size() - 1) + "= " + b + ";";
+			}
+
+			return dst + " = " + a + binary + b + ";";
+		}
+
+		switch (instr.op)
+		{
+			case IROp::ASSIGN:
+				return dst + " = " + a + ";";
+			case IROp::ZERO_EXTEND:
+				return dst + " = (" + Type(instr.a.size, false) + ")" + a + ";";
+			case IROp::SIGN_EXTEND:
+				return dst + " = (" + Type(instr.a.size, true) + ")" + a + ";";
+			case IROp::LOAD:
+				return dst + " = " + Memory(instr.mem) + ";";
+			case IROp::STORE:
+				return Memory(instr.mem) + " = " + a + ";";
+			case IROp::ADDRESS:
+				return dst + " = " + Address(instr.mem) + ";";
+			case IROp::NEG:
+				return dst + " = -" + a + ";";
+			case IROp::NOT:
+				return dst + " = ~" + a + ";";
+			case IROp::COMPARE:
+				return ""; // Only printed through the conditions that read it
+			case IROp::SET:
+				return dst + " = " + Condition(instr) + ";";
+			case IROp::CONDITIONAL_ASSIGN:
+				return "if (" + Condition(instr) + ") " + dst + " = " + a + ";";
+			case IROp::PUSH:
+				return "push(" + a + ");";
+			case IROp::POP:
+				return dst + " = pop();";
+			case IROp::CALL:
+				if (instr.a.kind == IRValue::CONSTANT)
+				{
+					return dst + " = " + Target(instr.a, "sub_") + "();";
+				}
+				return dst + " = ((int (*)())" + a + ")();";
+			case IROp::JUMP:
+				if (instr.a.kind == IRValue::CONSTANT)
+				{
+					return "goto " + Target(instr.a, "loc_") + ";";
+				}
+				return "goto *" + a + ";";
+			case IROp::BRANCH:
+				return "if (" + Condition(instr) + ") goto " + Target(instr.a, "loc_") + ";";
+			case IROp::INDIRECT_JUMP:
+				return "goto *" + a + ";";
+			case IROp::RETURN:
+				return "return " + a + ";";
+			default:
+				return "asm(\"" + instrs[instr.source].attrib.intrinsic.mnemonic + "\");";
+		}
+	}
+
+private:
+	const IRFunction &func;
+	const std::vector<Instruction> &instrs;
+};
+
+};
+
+std::vector<std::string> PrintPseudoC(const IRFunction &func, const std::vector<Instruction> &instrs)
+{
+	std::vector<std::string> lines {};
+	Printer printer(func, instrs);
+
+	std::stringstream header {};
+	header << "int sub_" << std::hex << func.address << "()";
+	lines.push_back(header.str());
+	lines.push_back("{");
+
+	for (uint32_t b = 0; b < func.blockCount; b++)
+	{
+		const auto &block = func.blocks[b];
+		if (block.labelled && b > 0)
+		{
+			std::stringstream label {};
+			label << "loc_" << std::hex << block.address << ':';
+			lines.push_back(label.str());
+		}
+
+		for (auto instr = block.first; instr != nullptr; instr = instr->next)
+		{
+			std::string statement = printer.Statement(*instr);
+			if (!statement.empty())
+			{
+				lines.push_back('\t' + statement);
+			}
+		}
+	}
+
+	lines.push_back("}");
+	lines.push_back("");
+	return lines;
+}
+
+};
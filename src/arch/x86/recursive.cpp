@@ -0,0 +1,310 @@
+#include <algorithm>
+
+#include "recursive.h"
+#include "decode.h"
+#include "../../util/alloc.h"
+
+namespace ISet_x86
+{
+
+const unsigned int RUN_WINDOW = 256; // Bytes decoded at a time while following straight-line code
+const unsigned int BOUND_LOOKBACK = 4; // Instructions searched back from a dispatch for its bounds check
+
+RecursiveDecoder::RecursiveDecoder(std::vector<byte> * section, uint64_t sectionAddress, Segment data)
+{
+	this->section = section;
+	this->sectionAddress = sectionAddress;
+	this->data = data;
+}
+
+std::vector<Instruction> RecursiveDecoder::DecodeSection(const std::vector<uint64_t> &entryPoints)
+{
+	ALLOC_STAGE(DECODE);
+
+	state.assign(section->size(), UNKNOWN);
+	worklist = std::vector<uint64_t>();
+	decoded = std::vector<Instruction>();
+	tables = std::vector<JumpTable>();
+#ifdef DISASM_COUNTERS
+	counters = DecoderCounters();
+#endif
+
+	for (auto entry : entryPoints)
+	{
+		Push(entry);
+	}
+
+	if (worklist.empty() && !section->empty())
+	{
+		worklist.push_back(0);
+	}
+
+	while (!worklist.empty())
+	{
+		uint64_t offset = worklist.back();
+		worklist.pop_back();
+		DecodeRun(offset);
+	}
+
+	std::sort(decoded.begin(), decoded.end(), [](const Instruction &a, const Instruction &b)
+	{
+		return a.attrib.runtime.segmentByteOffset < b.attrib.runtime.segmentByteOffset;
+	});
+
+	std::sort(tables.begin(), tables.end(), [](const JumpTable &a, const JumpTable &b)
+	{
+		return a.address < b.address;
+	});
+
+	return decoded;
+}
+
+const std::vector<JumpTable> & RecursiveDecoder::JumpTables() const
+{
+	return tables;
+}
+
+#ifdef DISASM_COUNTERS
+const DecoderCounters & RecursiveDecoder::Counters() const
+{
+	return counters;
+}
+#endif
+
+bool RecursiveDecoder::InSection(uint64_t address) const
+{
+	return address >= sectionAddress && address - sectionAddress < section->size();
+}
+
+void RecursiveDecoder::Push(uint64_t address)
+{
+	if (InSection(address) && state[address - sectionAddress] == UNKNOWN)
+	{
+		worklist.push_back(address - sectionAddress);
+	}
+}
+
+bool RecursiveDecoder::Claim(const Instruction &instr)
+{
+	uint64_t begin = instr.attrib.runtime.segmentByteOffset;
+	uint64_t end = begin + instr.attrib.runtime.size;
+
+	if (!instr.attrib.flags.resolved || end > state.size())
+	{
+		return false;
+	}
+
+	// Overlapping an instruction or table that was already claimed means the run is either
+	// joining known code or isn't code at all, and both end it
+	for (uint64_t i = begin; i < end; i++)
+	{
+		if (state[i] != UNKNOWN)
+		{
+			return false;
+		}
+	}
+
+	state[begin] = INSTRUCTION_START;
+	std::fill(state.begin() + begin + 1, state.begin() + end, INSTRUCTION_BODY);
+	return true;
+}
+
+void RecursiveDecoder::DecodeRun(uint64_t offset)
+{
+	std::size_t runBegin = decoded.size();
+
+	while (offset < section->size())
+	{
+		uint64_t end = std::min<uint64_t>(offset + RUN_WINDOW, section->size());
+		auto decoder = LinearDecoder(section, offset, end);
+		auto instrs = decoder.DecodeSection();
+#ifdef DISASM_COUNTERS
+		counters += decoder.Counters();
+#endif
+
+		// Instructions near the end of the window may have been cut short, so they are left
+		// for the next window
+		uint64_t limit = (end == section->size()) ? end : end - MAX_INSTRUCTION_SIZE;
+
+		for (auto &instr : instrs)
+		{
+			if (instr.attrib.runtime.segmentByteOffset >= limit)
+			{
+				break;
+			}
+
+			if (!Claim(instr))
+			{
+				return;
+			}
+
+			decoded.push_back(instr);
+			offset = instr.attrib.runtime.segmentByteOffset + instr.attrib.runtime.size;
+
+			switch (instr.attrib.intrinsic.flow)
+			{
+				case ControlFlow::CALL:
+				case ControlFlow::CONDITIONAL_JUMP:
+					if (instr.HasRelativeTarget())
+					{
+						Push(instr.RelativeTarget(sectionAddress));
+					}
+					break;
+				case ControlFlow::JUMP:
+					if (instr.HasRelativeTarget())
+					{
+						Push(instr.RelativeTarget(sectionAddress));
+					}
+					return;
+				case ControlFlow::INDIRECT_JUMP:
+					RecoverTable(runBegin, decoded.back());
+					return;
+				case ControlFlow::RETURN:
+				case ControlFlow::HALT:
+					return;
+				default:
+					break;
+			}
+		}
+
+		if (instrs.empty())
+		{
+			return;
+		}
+	}
+}
+
+uint32_t RecursiveDecoder::TableBound(std::size_t runBegin, const Instruction &dispatch) const
+{
+	// jmp [index*4 + disp32], the form compilers lower a dense switch to
+	const auto &enc = dispatch.encoded;
+	if (enc.opcode.twoByte || enc.opcode.primary != 0xFF || enc.modrm.regOpBits != 4 || enc.modrm.modBits != 0b00
+	|| !dispatch.attrib.flags.hasSIB || enc.sib.baseBits != 0b101 || enc.sib.scaleBits != 0b10 || enc.sib.indexBits == 0b100)
+	{
+		return 0;
+	}
+
+	// Search back for ja/jae to the default case, then the cmp of the index register before it
+	bool branchSeen = false;
+	bool inclusive = false;
+	std::size_t last = decoded.size() - 1; // The dispatch itself
+
+	for (std::size_t i = last; i-- > runBegin && last - i <= BOUND_LOOKBACK;)
+	{
+		const auto &instr = decoded[i];
+		const auto &op = instr.encoded.opcode;
+
+		if (!branchSeen)
+		{
+			if (op.primary == (op.twoByte ? 0x87 : 0x77)) // ja
+			{
+				branchSeen = true;
+				inclusive = true;
+			}
+
+			else if (op.primary == (op.twoByte ? 0x83 : 0x73)) // jae
+			{
+				branchSeen = true;
+			}
+
+			continue;
+		}
+
+		uint32_t bound = 0;
+		if (!op.twoByte && (op.primary == 0x83 || op.primary == 0x81) && instr.encoded.modrm.regOpBits == 7
+		&& instr.encoded.modrm.modBits == 0b11 && instr.encoded.modrm.rmBits == enc.sib.indexBits)
+		{
+			// The byte form is sign-extended, so a negative bound becomes too large to accept
+			bound = (op.primary == 0x83) ? static_cast<uint32_t>(static_cast<int8_t>(instr.encoded.immd)) : instr.encoded.immd;
+		}
+
+		else if (!op.twoByte && op.primary == 0x3D && enc.sib.indexBits == 0) // cmp eax, imm32
+		{
+			bound = instr.encoded.immd;
+		}
+
+		else
+		{
+			return 0;
+		}
+
+		if (instr.HasPrefix(0x66) || bound >= MAX_JUMP_TABLE_ENTRIES)
+		{
+			return 0;
+		}
+
+		return inclusive ? bound + 1 : bound;
+	}
+
+	return 0;
+}
+
+void RecursiveDecoder::RecoverTable(std::size_t runBegin, const Instruction &dispatch)
+{
+	uint32_t count = TableBound(runBegin, dispatch);
+
+	JumpTable table {};
+	table.address = dispatch.encoded.disp;
+	table.dispatch = sectionAddress + dispatch.attrib.runtime.segmentByteOffset;
+	table.inSection = InSection(table.address);
+
+	// The table ends early at the first entry that doesn't lead into the section, or that
+	// overlaps bytes that were already claimed
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uint64_t address = table.address + i * 4;
+		uint32_t entry = 0;
+		if (!ReadEntry(address, entry) || !InSection(entry))
+		{
+			break;
+		}
+
+		if (table.inSection)
+		{
+			auto begin = state.begin() + (address - sectionAddress);
+			if (std::any_of(begin, begin + 4, [](uint8_t s) { return s != UNKNOWN; }))
+			{
+				break;
+			}
+
+			std::fill(begin, begin + 4, TABLE);
+		}
+
+		table.targets.push_back(entry);
+		Push(entry);
+	}
+
+	if (!table.targets.empty())
+	{
+		tables.push_back(table);
+	}
+}
+
+bool RecursiveDecoder::ReadEntry(uint64_t address, uint32_t &entry) const
+{
+	const std::vector<byte> * bytes = section;
+	uint64_t base = sectionAddress;
+
+	if (!InSection(address))
+	{
+		const SectionRange * range = data.FindSection(address);
+		if (range == nullptr)
+		{
+			return false;
+		}
+
+		bytes = &data.seg->at(range->name);
+		base = range->range.begin;
+	}
+
+	uint64_t offset = address - base;
+	if (offset + 4 > bytes->size())
+	{
+		return false;
+	}
+
+	entry = bytes->at(offset) | (bytes->at(offset + 1) << 8) | (bytes->at(offset + 2) << 16) | (static_cast<uint32_t>(bytes->at(offset + 3)) << 24);
+	return true;
+}
+
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <vector>
+
+#include "../../util/common.h"
+#include "../../format/format.h"
+#include "instruction.h"
+#include "counters.h"
+
+namespace ISet_x86
+{
+
+// Well above the case count of any switch a compiler lowers to a single table
+const uint32_t MAX_JUMP_TABLE_ENTRIES = 4096;
+
+struct JumpTable
+{
+	uint64_t address {}; // Of the first entry
+	uint64_t dispatch {}; // Address of the indirect jump that indexes the table
+	bool inSection {}; // Whether the table is embedded in the decoded section rather than data
+	std::vector<uint64_t> targets {};
+};
+
+class RecursiveDecoder
+// Decodes only what is reachable from the entry points, following branches and the jump tables
+// of bounded switch dispatches. Table entries are claimed as data as they are read, so that
+// the bytes of a table embedded in the section are never decoded as instructions
+{
+public:
+	// Tables outside the section are read from the data segment
+	RecursiveDecoder(std::vector<byte> * section, uint64_t sectionAddress, Segment data);
+
+	// Instructions reachable from the entry points, sorted by offset. Decoding starts at the
+	// beginning of the section if none of the entry points are inside it
+	std::vector<Instruction> DecodeSection(const std::vector<uint64_t> &entryPoints);
+	// Tables recovered by the last decode, sorted by address
+	const std::vector<JumpTable> & JumpTables() const;
+
+#ifdef DISASM_COUNTERS
+	// Summed over the linear decoders of the last decode
+	const DecoderCounters & Counters() const;
+#endif
+
+private:
+	enum ByteState : uint8_t
+	{
+		UNKNOWN,
+		INSTRUCTION_START,
+		INSTRUCTION_BODY,
+		TABLE
+	};
+
+	std::vector<byte> * section;
+	uint64_t sectionAddress;
+	Segment data;
+
+	std::vector<uint8_t> state; // One per section byte
+	std::vector<uint64_t> worklist; // Section offsets still to be decoded from
+	std::vector<Instruction> decoded;
+	std::vector<JumpTable> tables;
+#ifdef DISASM_COUNTERS
+	DecoderCounters counters {};
+#endif
+
+	bool InSection(uint64_t address) const;
+	void Push(uint64_t address);
+	bool Claim(const Instruction &instr);
+
+	// Decodes straight-line code from the offset until control leaves it or it runs into
+	// bytes that were already claimed
+	void DecodeRun(uint64_t offset);
+
+	// Entry count allowed by the bounds check in front of a jmp [index*4 + table], 0 if the
+	// jump isn't of that form or has no bounds check
+	uint32_t TableBound(std::size_t runBegin, const Instruction &dispatch) const;
+	void RecoverTable(std::size_t runBegin, const Instruction &dispatch);
+	bool ReadEntry(uint64_t address, uint32_t &entry) const;
+};
+
+};
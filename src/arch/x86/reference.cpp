@@ -227,72 +227,8 @@ const std::map<int, AddrMethod> ModRMRegisterEncoding32
 };
 
 
-std::unordered_map<Opcode, Instruction, OpcodeHash> instrReferenceMap;
-
 // Aliases since these use the same mappings
 const std::map<int, AddrMethod> SIBIndex = ModRMRegisterEncoding32;
 const std::map<int, AddrMethod> SIBBase = ModRMRegisterEncoding32;
 
-bool InstructionReference::Contains(Opcode opkey)
-{
-    return instrReferenceMap.find(opkey) != instrReferenceMap.end();
-}
-
-bool InstructionReference::ContainsPrimary(byte b)
-{
-    for (auto instr : instrReferenceMap)
-    {
-        if (instr.second.encoded.opcode.primary == b)
-        {
-            return true;
-        }
-    }
-
-    return false;
-}
-
-Instruction InstructionReference::GetReference(Opcode opkey)
-{
-	if (instrReferenceMap.find(opkey) != instrReferenceMap.end())
-	{
-		return instrReferenceMap.at(opkey);
-	}
-
-	// Used for instructions which have an opcode extension, as otherwise
-	// they would not be located at this stage properly
-	auto copyWithOpcodeExtension = opkey;
-	copyWithOpcodeExtension.extension = 0;
-
-	if (instrReferenceMap.count(copyWithOpcodeExtension) > 0)
-	{
-		return instrReferenceMap.at(copyWithOpcodeExtension);
-	}
-
-    else
-    {
-        return Instruction {};
-        /*
-        std::stringstream err;
-        err << std::hex << "Tried to lookup opcode that does not exist: " << opkey.mandatoryPrefix << " " << (int)opkey.twoByte << " " << opkey.primary << " " << opkey.secondary << " " << (int)opkey.extension;
-        throw std::runtime_error(err.str());
-        */
-    }
-}
-
-int InstructionReference::size()
-{
-    return instrReferenceMap.size();
-}
-
-int InstructionReference::count(Opcode key)
-{
-    return instrReferenceMap.count(key);
-}
-
-void InstructionReference::Emplace(Opcode opkey, Instruction instruction)
-{
-    instrReferenceMap.emplace(opkey, instruction);
-}
-InstructionReference instrReference {};
-
 }
@@ -52,6 +52,9 @@ const std::vector<byte> prefixes
         */
 };
 
+// Architectural limit on the length of a single instruction
+const int MAX_INSTRUCTION_SIZE = 15;
+
 // The range that register types fall into in the enum
 const int REGISTER_LOWER_BOUND = 100;
 const int REGISTER_UPPER_BOUND = 2000;
@@ -250,26 +253,13 @@ enum class OperandType : int16_t
         UNSUPPORTED = 2201 // Complex instructions that don't fit the usual form
 };
 
-class Opcode;
-class OpcodeHash;
-class Instruction;
-
-class InstructionReference
-{
-public:
-    bool Contains(Opcode opkey);
-    bool ContainsPrimary(byte b);
-    Instruction GetReference(Opcode opkey);
-    void Emplace(Opcode opkey, Instruction instr);
-    int size();
-    int count(Opcode key);
-};
+// Reference id of instructions that did not match any reference entry
+const uint16_t NO_REFERENCE = 0;
 
 extern const std::map<int, AddrMethod> ModRMRegisterEncoding8;
 extern const std::map<int, AddrMethod> ModRMRegisterEncoding16;
 extern const std::map<int, AddrMethod> ModRMRegisterEncoding32;
 extern const std::map<int, AddrMethod> SIBIndex;
 extern const std::map<int, AddrMethod> SIBBase;
-extern InstructionReference instrReference;
 
 };
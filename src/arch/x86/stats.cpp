@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+#include "stats.h"
+#include "context.h"
+
+namespace ISet_x86
+{
+
+const std::array<std::string, ENCODING_COUNT> encodingNames
+{
+	"immediate",
+	"relative",
+	"opcode_register",
+	"modrm_reg",
+	"modrm_rm",
+	"modrm_disp",
+	"modrm_scaled",
+	"modrm_scaled_disp",
+	"memory_offset"
+};
+
+const std::array<std::string, CONTROL_FLOW_COUNT> flowNames
+{
+	"sequential",
+	"call",
+	"jump",
+	"conditional_jump",
+	"indirect_jump",
+	"return",
+	"halt"
+};
+
+// ***** DecodeStatistics *****
+DecodeStatistics::DecodeStatistics()
+{
+	references.resize(DecoderContext::Shared().References().size() + 1);
+}
+
+void DecodeStatistics::Count(const Instruction &instr)
+{
+	instructions++;
+	bytes += instr.attrib.runtime.size;
+
+	if (!instr.attrib.flags.resolved)
+	{
+		undecodable++;
+		undecodableBytes += instr.attrib.runtime.size;
+		return;
+	}
+
+	references[instr.attrib.intrinsic.referenceId]++;
+	flows[static_cast<int>(instr.attrib.intrinsic.flow)]++;
+
+	for (int i = 0; i < instr.attrib.runtime.prefixCount && i < static_cast<int>(instr.encoded.prefix.size()); i++)
+	{
+		prefixes[instr.encoded.prefix[i]]++;
+	}
+
+	for (auto op : {&instr.op1, &instr.op2, &instr.op3, &instr.op4})
+	{
+		auto encoding = op->attrib.runtime.encoding;
+		if (encoding >= 0 && encoding < ENCODING_COUNT)
+		{
+			encodings[encoding]++;
+		}
+	}
+}
+
+void DecodeStatistics::Merge(const DecodeStatistics &other)
+{
+	instructions += other.instructions;
+	bytes += other.bytes;
+	undecodable += other.undecodable;
+	undecodableBytes += other.undecodableBytes;
+
+	for (unsigned int i = 0; i < references.size() && i < other.references.size(); i++)
+	{
+		references[i] += other.references[i];
+	}
+
+	for (unsigned int i = 0; i < prefixes.size(); i++)
+	{
+		prefixes[i] += other.prefixes[i];
+	}
+
+	for (unsigned int i = 0; i < encodings.size(); i++)
+	{
+		encodings[i] += other.encodings[i];
+	}
+
+	for (unsigned int i = 0; i < flows.size(); i++)
+	{
+		flows[i] += other.flows[i];
+	}
+}
+
+std::string DecodeStatistics::ToJSON() const
+{
+	std::stringstream json {};
+
+	json << "{\n";
+	json << "  \"instructions\": " << instructions << ",\n";
+	json << "  \"bytes\": " << bytes << ",\n";
+	json << "  \"undecodable\": {\"instructions\": " << undecodable << ", \"bytes\": " << undecodableBytes << "},\n";
+
+	// Several opcodes share a mnemonic, so both levels are reported
+	std::map<std::string, uint64_t> mnemonics {};
+	json << "  \"opcodes\": [";
+	bool first = true;
+	for (unsigned int id = 1; id < references.size(); id++)
+	{
+		if (references[id] == 0)
+		{
+			continue;
+		}
+
+		auto &reference = DecoderContext::Shared().References().GetReferenceById(id);
+		auto &opcode = reference.encoded.opcode;
+		mnemonics[reference.attrib.intrinsic.mnemonic] += references[id];
+
+		std::stringstream bytesStr {};
+		bytesStr << std::hex << std::setfill('0');
+		if (opcode.mandatoryPrefix != INVALID)
+		{
+			bytesStr << std::setw(2) << opcode.mandatoryPrefix << " ";
+		}
+		if (opcode.twoByte)
+		{
+			bytesStr << "0f ";
+		}
+		bytesStr << std::setw(2) << opcode.primary;
+		if (opcode.secondary != INVALID)
+		{
+			bytesStr << " " << std::setw(2) << opcode.secondary;
+		}
+		if (opcode.extension != INVALID)
+		{
+			bytesStr << " /" << static_cast<int>(opcode.extension);
+		}
+
+		json << (first ? "\n" : ",\n");
+		json << "    {\"opcode\": \"" << bytesStr.str() << "\", \"mnemonic\": \"" << reference.attrib.intrinsic.mnemonic << "\", \"count\": " << references[id] << "}";
+		first = false;
+	}
+	json << "\n  ],\n";
+
+	json << "  \"mnemonics\": {";
+	first = true;
+	for (auto &m : mnemonics)
+	{
+		json << (first ? "\n" : ",\n") << "    \"" << m.first << "\": " << m.second;
+		first = false;
+	}
+	json << "\n  },\n";
+
+	json << "  \"prefixes\": {";
+	first = true;
+	for (unsigned int p = 0; p < prefixes.size(); p++)
+	{
+		if (prefixes[p] == 0)
+		{
+			continue;
+		}
+
+		json << (first ? "\n" : ",\n") << "    \"" << std::hex << std::setw(2) << std::setfill('0') << p << std::dec << "\": " << prefixes[p];
+		first = false;
+	}
+	json << "\n  },\n";
+
+	json << "  \"encodings\": {";
+	for (unsigned int e = 0; e < encodings.size(); e++)
+	{
+		json << (e == 0 ? "\n" : ",\n") << "    \"" << encodingNames[e] << "\": " << encodings[e];
+	}
+	json << "\n  },\n";
+
+	json << "  \"classes\": {";
+	for (unsigned int f = 0; f < flows.size(); f++)
+	{
+		json << (f == 0 ? "\n" : ",\n") << "    \"" << flowNames[f] << "\": " << flows[f];
+	}
+	json << "\n  }\n";
+	json << "}\n";
+
+	return json.str();
+}
+
+};
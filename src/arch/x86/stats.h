@@ -0,0 +1,39 @@
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "instruction.h"
+
+namespace ISet_x86
+{
+
+const int ENCODING_COUNT = Operand::MEMORY_OFFSET + 1;
+const int CONTROL_FLOW_COUNT = static_cast<int>(ControlFlow::HALT) + 1;
+
+class DecodeStatistics
+// Histogram of decoded instructions. Every counter lives in a dense array indexed by reference
+// id, prefix byte or enum value, so each thread keeps its own and they are merged at the end
+{
+public:
+	DecodeStatistics();
+
+	void Count(const Instruction &instr);
+	void Merge(const DecodeStatistics &other);
+
+	std::string ToJSON() const;
+
+private:
+	uint64_t instructions {};
+	uint64_t bytes {};
+	uint64_t undecodable {}; // Instructions that failed to decode
+	uint64_t undecodableBytes {};
+
+	std::vector<uint64_t> references {};
+	std::array<uint64_t, 256> prefixes {};
+	std::array<uint64_t, ENCODING_COUNT> encodings {};
+	std::array<uint64_t, CONTROL_FLOW_COUNT> flows {};
+};
+
+};
@@ -0,0 +1,56 @@
+#include <algorithm>
+
+#include "targets.h"
+
+namespace ISet_x86
+{
+
+BranchTargets::BranchTargets(const std::vector<Instruction> &instrs, uint64_t sectionAddress)
+{
+	Insert(instrs, sectionAddress);
+}
+
+void BranchTargets::Insert(const std::vector<Instruction> &instrs, uint64_t sectionAddress)
+{
+	auto sortedCount = targets.size();
+
+	for (auto &instr : instrs)
+	{
+		if (instr.attrib.flags.resolved && instr.HasRelativeTarget())
+		{
+			targets.push_back(instr.RelativeTarget(sectionAddress));
+		}
+	}
+
+	// Sort only the new targets, then merge them with the existing ones
+	std::sort(targets.begin() + sortedCount, targets.end());
+	std::inplace_merge(targets.begin(), targets.begin() + sortedCount, targets.end());
+	targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+}
+
+void BranchTargets::Insert(const std::vector<uint64_t> &addresses)
+{
+	auto sortedCount = targets.size();
+	targets.insert(targets.end(), addresses.begin(), addresses.end());
+
+	std::sort(targets.begin() + sortedCount, targets.end());
+	std::inplace_merge(targets.begin(), targets.begin() + sortedCount, targets.end());
+	targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+}
+
+bool BranchTargets::Contains(uint64_t address) const
+{
+	return std::binary_search(targets.begin(), targets.end(), address);
+}
+
+const std::vector<uint64_t> & BranchTargets::Addresses() const
+{
+	return targets;
+}
+
+std::size_t BranchTargets::size() const
+{
+	return targets.size();
+}
+
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+#include "../../util/common.h"
+#include "instruction.h"
+
+namespace ISet_x86
+{
+
+class BranchTargets
+// Sorted, deduplicated set of the absolute addresses that relative jumps and calls lead to.
+// Used for labelling listings, and as the block leaders of control-flow analyses
+{
+public:
+	BranchTargets() = default;
+	BranchTargets(const std::vector<Instruction> &instrs, uint64_t sectionAddress);
+
+	// Merges the targets of another decoded section into the set
+	void Insert(const std::vector<Instruction> &instrs, uint64_t sectionAddress);
+	// Merges targets that aren't encoded in an instruction, such as jump table entries
+	void Insert(const std::vector<uint64_t> &addresses);
+
+	bool Contains(uint64_t address) const;
+	const std::vector<uint64_t> & Addresses() const;
+	std::size_t size() const;
+
+private:
+	std::vector<uint64_t> targets {};
+};
+
+};
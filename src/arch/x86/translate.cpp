@@ -1,8 +1,11 @@
 #include "translate.h"
+#include "../../util/trace.h"
+#include "../../util/alloc.h"
 #include <sstream>
 #include <algorithm>
 #include <string>
 #include <iomanip>
+#include <iterator>
 
 namespace ISet_x86
 {
@@ -44,29 +47,140 @@ const std::map<AddrMethod, std::string> regString
 	{ AddrMethod::EFLAGS, "eflags" }
 };
 
-Translator::Translator(std::vector<Instruction> decodedInstrs, std::vector<byte> * section)
+Translator::Translator(std::vector<Instruction> decodedInstrs, std::vector<byte> * section, uint64_t sectionAddress,
+	const BranchTargets * targets, const StringTable * strings, const std::vector<LibraryFunction> * library)
 {
 	this->decodedInstrs = decodedInstrs;
 	this->section = section;
+	this->sectionAddress = sectionAddress;
+	this->targets = targets;
+	this->strings = strings;
+	this->library = library;
+}
+
+void Translator::SetJumpTables(const std::vector<JumpTable> * tables)
+{
+	this->tables = tables;
 }
 
 std::vector<std::string> Translator::TranslateToASM()
 {
+	TRACE_SPAN("Translator::TranslateToASM");
+	ALLOC_STAGE(TRANSLATE);
 	std::vector<std::string> translatedAsm;
+	std::size_t nextTable = 0;
 
 	for (auto instruction : decodedInstrs)
 	{
-		std::string line = StringifyInstruction(instruction);
+		uint64_t address = sectionAddress + instruction.attrib.runtime.segmentByteOffset;
+		TranslateTables(address, nextTable, translatedAsm);
+
+		const LibraryFunction * libraryFunc = FindLibraryFunction(address);
+		if (libraryFunc != nullptr && libraryFunc->range.begin == address)
+		{
+			translatedAsm.push_back(libraryFunc->name + ":\t; library function" + (processFlags.skipLibrary ? ", skipped" : ""));
+		}
+
+		if (libraryFunc != nullptr && processFlags.skipLibrary)
+		{
+			continue;
+		}
+
+		if (targets != nullptr && targets->Contains(address))
+		{
+			translatedAsm.push_back(Label(address) + ":");
+		}
+
+		std::string line = StringifyInstruction(instruction) + StringComment(instruction);
 		translatedAsm.push_back(line);
 	}
 
+	TranslateTables(UINT64_MAX, nextTable, translatedAsm);
 	return translatedAsm;
 }
 
+void Translator::TranslateTables(uint64_t address, std::size_t &next, std::vector<std::string> &translatedAsm)
+{
+	for (; tables != nullptr && next < tables->size() && tables->at(next).address < address; next++)
+	{
+		auto &table = tables->at(next);
+		if (!table.inSection)
+		{
+			continue;
+		}
+
+		for (std::size_t i = 0; i < table.targets.size(); i++)
+		{
+			uint64_t entry = table.address + i * 4;
+
+			std::stringstream line {};
+			line << std::hex << entry << ":\t";
+			line << std::setw(32) << std::left;
+			std::stringstream bytes {};
+			for (uint64_t b = entry - sectionAddress; b < entry - sectionAddress + 4; b++)
+			{
+				bytes << std::hex << (int)section->at(b) << " ";
+			}
+
+			line << bytes.str() << "dd\t" << Label(table.targets[i]);
+			if (i == 0)
+			{
+				line << "\t; jump table for " << std::hex << table.dispatch;
+			}
+
+			translatedAsm.push_back(line.str());
+		}
+	}
+}
+
+bool Translator::Listed(uint64_t address) const
+{
+	if (address < sectionAddress)
+	{
+		return false;
+	}
+
+	uint64_t offset = address - sectionAddress;
+	auto found = std::lower_bound(decodedInstrs.begin(), decodedInstrs.end(), offset, [](const Instruction &instr, uint64_t offset)
+	{
+		return instr.attrib.runtime.segmentByteOffset < offset;
+	});
+
+	return found != decodedInstrs.end() && found->attrib.runtime.segmentByteOffset == offset;
+}
+
+std::string Translator::Label(uint64_t address)
+{
+	std::stringstream label;
+	label << "loc_" << std::hex << address;
+	return label.str();
+}
+
+const LibraryFunction * Translator::FindLibraryFunction(uint64_t address) const
+{
+	if (library == nullptr)
+	{
+		return nullptr;
+	}
+
+	auto pos = std::upper_bound(library->begin(), library->end(), address, [](uint64_t a, const LibraryFunction &f)
+	{
+		return a < f.range.begin;
+	});
+
+	if (pos == library->begin() || !std::prev(pos)->range.Contains(address))
+	{
+		return nullptr;
+	}
+
+	return &(*std::prev(pos));
+}
+
 std::string Translator::StringifyInstruction(const Instruction &instr)
 {
 	std::stringstream line {};
 
+	line << std::hex << sectionAddress + instr.attrib.runtime.segmentByteOffset << ":\t";
 	line << std::setw(32) << std::left;
 	std::stringstream bytes {};
 	for (int i = instr.attrib.runtime.segmentByteOffset; i < instr.attrib.runtime.segmentByteOffset + instr.attrib.runtime.size; i++)
@@ -100,10 +214,59 @@ std::string Translator::StringifyInstruction(const Instruction &instr)
 		line << "," << opStr;
     }
 
-	std::cout << line.str() << "\n";
 	return line.str();
 }
 
+std::vector<std::string> Translator::OperandStrings(const Instruction &instr)
+{
+	std::vector<std::string> operands {};
+	for (auto op : {&instr.op1, &instr.op2, &instr.op3, &instr.op4})
+	{
+		if (op->attrib.intrinsic.type != OperandType::NOT_APPLICABLE)
+		{
+			operands.push_back(StringifyOperand(instr, *op));
+		}
+	}
+
+	return operands;
+}
+
+std::string Translator::StringComment(const Instruction &instr)
+{
+	if (strings == nullptr)
+	{
+		return "";
+	}
+
+	// Strings are referenced through memory operands, or pushed and moved as immediates
+	uint64_t address = 0;
+	const StringEntry * entry = nullptr;
+	if (instr.AbsoluteMemoryAddress(address))
+	{
+		entry = strings->Find(address);
+	}
+
+	if (entry == nullptr && instr.HasImmediate())
+	{
+		address = instr.encoded.immd;
+		entry = strings->Find(address);
+	}
+
+	if (entry == nullptr)
+	{
+		return "";
+	}
+
+	// A reference into the middle of a string (a shared suffix) only sees the rest of it
+	auto offset = address - entry->address;
+	if (entry->encoding == StringEncoding::UTF16)
+	{
+		offset /= 2;
+	}
+
+	return "\t; " + QuoteString(entry->text.substr(offset));
+}
+
 std::string Translator::StringifyOperand(const Instruction &instr, const Operand &op)
 {
 	if (op.attrib.runtime.encoding == Operand::IMMD)
@@ -115,10 +278,23 @@ std::string Translator::StringifyOperand(const Instruction &instr, const Operand
 
 	if (op.attrib.runtime.encoding == Operand::RELATIVE_DISPLACEMENT)
 	{
-		std::stringstream addrStrStrm;
-		int relativeDisplacement = instr.encoded.immd;
+		uint64_t target = instr.RelativeTarget(sectionAddress);
 
-		addrStrStrm << "<0x" << std::hex << relativeDisplacement << " + relative address>";
+		const LibraryFunction * libraryFunc = FindLibraryFunction(target);
+		if (libraryFunc != nullptr && libraryFunc->range.begin == target)
+		{
+			return libraryFunc->name;
+		}
+
+		// Only targets that start a listed instruction get a label, which leaves out other
+		// sections and, when listing a range, the parts of the section outside it
+		if (targets != nullptr && Listed(target))
+		{
+			return Label(target);
+		}
+
+		std::stringstream addrStrStrm;
+		addrStrStrm << "0x" << std::hex << target;
 		return addrStrStrm.str();
 	}
 
@@ -128,34 +304,88 @@ std::string Translator::StringifyOperand(const Instruction &instr, const Operand
 		return regString.at(encodedReg);
 	}
 
-	else if (op.attrib.runtime.encoding == Operand::MODRM_REGISTER_REGBITS)
+	// E operands are always addressed by the r/m field, though the decoder marks some of them
+	// with the REG field
+	else if (op.attrib.runtime.encoding == Operand::MODRM_REGISTER_REGBITS && op.attrib.intrinsic.addrMethod != AddrMethod::E)
 	{
 		AddrMethod reg = ModRMRegisterEncoding32.at(instr.encoded.modrm.regOpBits);
 		return regString.at(reg);
 	}
 
-	else if (op.attrib.runtime.encoding == Operand::MODRM_REGISTER_RMBITS)
+	else if (op.attrib.runtime.encoding == Operand::MODRM_REGISTER_REGBITS || op.attrib.runtime.encoding == Operand::MODRM_REGISTER_RMBITS
+		|| op.attrib.runtime.encoding == Operand::MODRM_REGISTER_WITH_DISP || op.attrib.runtime.encoding == Operand::MODRM_REGISTER_SCALED
+		|| op.attrib.runtime.encoding == Operand::MODRM_REGISTER_SCALED_WITH_DISP)
 	{
-		AddrMethod reg = ModRMRegisterEncoding32.at(instr.encoded.modrm.rmBits);
-		return regString.at(reg);
+		return StringifyModRM(instr);
 	}
 
-	else if (op.attrib.runtime.encoding == Operand::MODRM_REGISTER_WITH_DISP)
+	else if (op.attrib.runtime.encoding == Operand::MEMORY_OFFSET)
 	{
-
+		std::stringstream memStrStrm;
+		memStrStrm << "[0x" << std::hex << instr.encoded.disp << "]";
+		return memStrStrm.str();
 	}
 
-	else if (op.attrib.runtime.encoding == Operand::MODRM_REGISTER_SCALED)
+	return "";
+}
+
+std::string Translator::StringifyModRM(const Instruction &instr)
+{
+	const auto &modrm = instr.encoded.modrm;
+	const auto &sib = instr.encoded.sib;
+	if (modrm.modBits == 0b11)
 	{
+		return regString.at(ModRMRegisterEncoding32.at(modrm.rmBits));
+	}
 
+	// Without a base register (r/m or SIB base 101 and no mod bits) the displacement is the address
+	std::string address {};
+	if (!instr.attrib.flags.hasSIB)
+	{
+		if (!(modrm.modBits == 0b00 && modrm.rmBits == 0b101))
+		{
+			address = regString.at(ModRMRegisterEncoding32.at(modrm.rmBits));
+		}
 	}
 
-	else if (op.attrib.runtime.encoding == Operand::MODRM_REGISTER_SCALED_WITH_DISP)
+	else
 	{
+		if (!(modrm.modBits == 0b00 && sib.baseBits == 0b101))
+		{
+			address = regString.at(ModRMRegisterEncoding32.at(sib.baseBits));
+		}
 
+		// An index of 100 means none
+		if (sib.indexBits != 0b100)
+		{
+			address += (address.empty() ? "" : "+") + regString.at(ModRMRegisterEncoding32.at(sib.indexBits));
+			if (sib.scaleBits != 0)
+			{
+				address += "*" + std::to_string(1 << sib.scaleBits);
+			}
+		}
 	}
 
-	return "";
+	std::stringstream memStrStrm;
+	int32_t disp = static_cast<int32_t>(instr.encoded.disp);
+	if (address.empty())
+	{
+		memStrStrm << "[0x" << std::hex << static_cast<uint32_t>(disp) << "]";
+	}
+	else if (disp < 0)
+	{
+		memStrStrm << "[" << address << "-0x" << std::hex << -static_cast<int64_t>(disp) << "]";
+	}
+	else if (disp > 0)
+	{
+		memStrStrm << "[" << address << "+0x" << std::hex << disp << "]";
+	}
+	else
+	{
+		memStrStrm << "[" << address << "]";
+	}
+
+	return memStrStrm.str();
 }
 
 };
@@ -4,6 +4,10 @@
 
 #include "decode.h"
 #include "instruction.h"
+#include "targets.h"
+#include "recursive.h"
+#include "../../analysis/stringtable.h"
+#include "../../analysis/signature.h"
 
 namespace ISet_x86
 {
@@ -12,16 +16,37 @@ class Translator
 // Intel syntax
 {
 public:
-	Translator(std::vector<Instruction> decodedInstrs, std::vector<byte> * section);
+	Translator(std::vector<Instruction> decodedInstrs, std::vector<byte> * section, uint64_t sectionAddress = 0,
+		const BranchTargets * targets = nullptr, const StringTable * strings = nullptr, const std::vector<LibraryFunction> * library = nullptr);
+
+	// Tables embedded in the section are listed as data among the instructions
+	void SetJumpTables(const std::vector<JumpTable> * tables);
 
 	std::vector<std::string> TranslateToASM();
+	// Listing text of each operand of the instruction
+	std::vector<std::string> OperandStrings(const Instruction &instr);
 
 private:
 	std::vector<Instruction> decodedInstrs;
 	std::vector<byte> * section;
-
+	uint64_t sectionAddress; // Virtual address of the first byte of the section
+	const BranchTargets * targets; // Addresses to emit labels for, if any
+	const StringTable * strings; // Strings to annotate references to, if any
+	const std::vector<LibraryFunction> * library; // Recognised library functions, if any
+	const std::vector<JumpTable> * tables {}; // Sorted by address, if any
+
+	static std::string Label(uint64_t address);
+	// Whether an instruction of this listing starts at the address
+	bool Listed(uint64_t address) const;
+	const LibraryFunction * FindLibraryFunction(uint64_t address) const;
+
+	// Lists the tables before the address that haven't been listed yet, starting from next
+	void TranslateTables(uint64_t address, std::size_t &next, std::vector<std::string> &translatedAsm);
 	std::string StringifyInstruction(const Instruction &instr);
 	std::string StringifyOperand(const Instruction &instr, const Operand &op);
+	// The register or memory operand the ModRM byte, and any SIB byte and displacement, address
+	std::string StringifyModRM(const Instruction &instr);
+	std::string StringComment(const Instruction &instr);
 };
 
 };
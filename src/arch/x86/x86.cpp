@@ -1,51 +1,650 @@
 #include <algorithm>
 #include <array>
+#include <atomic>
+#include <thread>
 #include <fstream>
 #include <iostream>
+#include <sstream>
 
 #include "x86.h"
-#include "csv.h"
+#include "context.h"
+#include "prologue.h"
+#include "stats.h"
+#include "fingerprint.h"
+#include "gadget.h"
+#include "liveness.h"
+#include "ir.h"
+#include "../../util/perf.h"
+#include "../../util/alloc.h"
 
 using namespace ISet_x86;
 
 // ***** Arch_x86 *****
 Arch_x86::Arch_x86(Segment segment)
 {
-	x86CSVParse(instrReference);
-	threeByteOpcodeCSVParse();
+	// Loaded by the first architecture only, and shared by every decoder after
+	DecoderContext::Shared();
 
 	this->segment = segment;
 }
 
+void Arch_x86::Decode()
+{
+	ALLOC_STAGE(DECODE);
+
+	instructions = std::vector<Instruction>();
+	jumpTables = std::vector<JumpTable>();
+	xrefs = XrefIndex();
+
+	auto text = segment.seg->find(".text");
+	if (text == segment.seg->end())
+	{
+		return;
+	}
+
+	instructionsAddress = segment.addr->at(text->first);
+	if (processFlags.recursive)
+	{
+		auto decoder = RecursiveDecoder(&text->second, instructionsAddress, data);
+		instructions = decoder.DecodeSection(entryPoints);
+		jumpTables = decoder.JumpTables();
+#ifdef DISASM_COUNTERS
+		counters = decoder.Counters();
+#endif
+	}
+
+	else
+	{
+		auto decoder = LinearDecoder(&text->second);
+		instructions = decoder.DecodeSection();
+#ifdef DISASM_COUNTERS
+		counters = decoder.Counters();
+#endif
+	}
+
+	ALLOC_INSTRUCTIONS(instructions.size());
+
+	targets = BranchTargets(instructions, instructionsAddress);
+	for (auto &table : jumpTables)
+	{
+		targets.Insert(table.targets);
+	}
+
+	IndexReferences(instructionsAddress);
+}
+
 std::vector<std::string> Arch_x86::TranslateToAssembly()
 {
 	assembly = std::vector<std::string>();
 
-	int absoluteOffset = 0;
-	for (auto section : (*segment.seg))
+	// Only opened when asked for, as each group holds file descriptors and costs syscalls
+	std::unique_ptr<Perf::Group> perf = processFlags.perf ? std::make_unique<Perf::Group>() : nullptr;
+	if (perf && !perf->Available())
 	{
-		if (section.first == ".text")
+		std::cerr << "Performance counters unavailable, " << perf->Error() << '\n';
+		perf = nullptr;
+	}
+
+	if (perf)
+	{
+		perf->Start();
+	}
+	Decode();
+	Perf::Sample decodeSample = perf ? perf->Stop() : Perf::Sample();
+
+	if (instructions.empty())
+	{
+		return assembly;
+	}
+
+	if (perf)
+	{
+		perf->Start();
+	}
+	auto translator = Translator(instructions, &segment.seg->at(".text"), instructionsAddress, &targets, strings, library);
+	translator.SetJumpTables(&jumpTables);
+	assembly = translator.TranslateToASM();
+
+	if (perf)
+	{
+		Perf::Sample formatSample = perf->Stop();
+		uint64_t bytes = segment.seg->at(".text").size();
+		for (auto &line : Perf::Report("decode", decodeSample, bytes, instructions.size()))
+		{
+			std::cerr << line << '\n';
+		}
+		for (auto &line : Perf::Report("format", formatSample, bytes, instructions.size()))
 		{
-			auto decoder = LinearDecoder(&section.second);
-			instructions = decoder.DecodeSection();
-			auto translator = Translator(instructions, &section.second);
-			assembly = translator.TranslateToASM();
+			std::cerr << line << '\n';
+		}
+	}
 
-			if (processFlags.debug)
-			{
-				// Write decoded data
-			}
+	if (processFlags.debug)
+	{
+		// Kept apart from the listing on stdout
+#ifdef DISASM_COUNTERS
+		for (auto &line : counters.Report(".text"))
+		{
+			std::cerr << line << '\n';
 		}
+#else
+		std::cerr << "Decoder counters are only kept in builds configured with DISASM_COUNTERS" << '\n';
+#endif
 	}
 
 	return assembly;
 }
 
-std::vector<std::string> Arch_x86::TranslateToSource()
+std::vector<std::string> Arch_x86::TranslateToAssembly(AddressRange range, uint64_t boundary)
 {
-	throw std::runtime_error("Method 'TranslateToSource' unimplemented");
+	assembly = std::vector<std::string>();
+	instructions = std::vector<Instruction>();
+
+	const SectionRange * covering = segment.FindSection(range.begin);
+	if (covering == nullptr)
+	{
+		throw std::runtime_error("Address range is not inside a code section");
+	}
+
+	if (!covering->range.Contains(boundary) || boundary > range.begin)
+	{
+		boundary = covering->range.begin;
+	}
+
+	// Let the last instruction in the range run past its end
+	uint64_t end = covering->range.end;
+	if (range.end < covering->range.end - MAX_INSTRUCTION_SIZE)
+	{
+		end = range.end + MAX_INSTRUCTION_SIZE;
+	}
+	auto &section = segment.seg->at(covering->name);
+
+	auto decoder = LinearDecoder(&section, boundary - covering->range.begin, end - covering->range.begin);
+	for (auto &instr : decoder.DecodeSection())
+	{
+		// Instructions between the boundary and the start of the range are only decoded
+		// to stay in sync with the instruction stream
+		if (range.Contains(covering->range.begin + instr.attrib.runtime.segmentByteOffset))
+		{
+			instructions.push_back(instr);
+		}
+	}
+
+	ALLOC_INSTRUCTIONS(instructions.size());
+
+	instructionsAddress = covering->range.begin;
+	targets = BranchTargets(instructions, covering->range.begin);
+	xrefs = XrefIndex();
+	IndexReferences(covering->range.begin);
+	auto translator = Translator(instructions, &section, covering->range.begin, &targets, strings, library);
+	assembly = translator.TranslateToASM();
+
+	return assembly;
+}
+
+std::vector<std::string> Arch_x86::TranslateToSource(const std::vector<AddressRange> &functions, unsigned int threadCount)
+{
+	Decode();
+
+	std::vector<std::string> source {};
+	if (instructions.empty())
+	{
+		return source;
+	}
+
+	auto spans = FunctionSpans(functions);
+	std::vector<std::vector<std::string>> lines(spans.size());
+	std::atomic<unsigned int> next {0};
+	auto worker = [&]()
+	{
+		Arena arena {};
+		for (unsigned int i = next++; i < spans.size(); i = next++)
+		{
+			if (spans[i].first >= spans[i].second)
+			{
+				continue;
+			}
+
+			Lifter lifter(instructions, instructionsAddress, targets, arena);
+			lines[i] = PrintPseudoC(lifter.Lift(spans[i].first, spans[i].second), instructions);
+			arena.Reset();
+		}
+	};
+
+	threadCount = std::max(1u, std::min(threadCount, static_cast<unsigned int>(spans.size())));
+	std::vector<std::thread> threads {};
+	for (unsigned int t = 1; t < threadCount; t++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	for (auto &func : lines)
+	{
+		source.insert(source.end(), func.begin(), func.end());
+	}
+
+	return source;
 }
 	
+std::vector<uint64_t> Arch_x86::FindFunctionStarts()
+{
+	auto scanner = PrologueScanner(segment);
+	return scanner.Scan();
+}
+
+const XrefIndex & Arch_x86::GetXrefs()
+{
+	return xrefs;
+}
+
+std::string Arch_x86::CollectStatistics(const std::vector<uint64_t> &boundaries, unsigned int threadCount)
+{
+	struct Chunk
+	{
+		std::vector<byte> * section;
+		unsigned int begin;
+		unsigned int end;
+		unsigned int stop; // End of the last instruction decoded, which may run past end
+	};
+
+	uint64_t total = 0;
+	for (auto &range : *segment.index)
+	{
+		total += range.range.end - range.range.begin;
+	}
+
+	threadCount = std::max(1u, threadCount);
+
+	// Aim for a few chunks per thread so that a thread that gets large functions doesn't hold up the rest
+	const uint64_t minChunkSize = 4096;
+	uint64_t chunkSize = std::max(minChunkSize, total / (threadCount * 4));
+
+	std::vector<Chunk> chunks {};
+	for (auto &range : *segment.index)
+	{
+		auto &section = segment.seg->at(range.name);
+		unsigned int begin = 0;
+
+		auto b = std::upper_bound(boundaries.begin(), boundaries.end(), range.range.begin);
+		for (; b != boundaries.end() && *b < range.range.end; b++)
+		{
+			unsigned int offset = *b - range.range.begin;
+			if (offset - begin >= chunkSize)
+			{
+				chunks.push_back({&section, begin, offset, offset});
+				begin = offset;
+			}
+		}
+
+		chunks.push_back({&section, begin, static_cast<unsigned int>(section.size()), 0});
+	}
+
+	// Counters are kept per chunk rather than per thread so a chunk can be recounted on its own
+	std::vector<ISet_x86::DecodeStatistics> stats(chunks.size());
+
+	auto decodeChunk = [&](unsigned int i)
+	{
+		auto &chunk = chunks[i];
+		unsigned int limit = std::min<std::size_t>(chunk.end + MAX_INSTRUCTION_SIZE, chunk.section->size());
+
+		chunk.stop = chunk.begin;
+		auto decoder = LinearDecoder(chunk.section, chunk.begin, limit);
+		for (auto &instr : decoder.DecodeSection())
+		{
+			if (instr.attrib.runtime.segmentByteOffset >= chunk.end)
+			{
+				break;
+			}
+
+			stats[i].Count(instr);
+			chunk.stop = instr.attrib.runtime.segmentByteOffset + instr.attrib.runtime.size;
+		}
+	};
+
+	std::atomic<unsigned int> next {0};
+	auto worker = [&]()
+	{
+		for (unsigned int i = next++; i < chunks.size(); i = next++)
+		{
+			decodeChunk(i);
+		}
+	};
+
+	threadCount = std::min(threadCount, static_cast<unsigned int>(chunks.size()));
+	std::vector<std::thread> threads {};
+	for (unsigned int t = 1; t < threadCount; t++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	// Boundaries from prologue scanning can be wrong. Where a chunk doesn't start where the previous
+	// one stopped, it is decoded again from there so the counts match a single linear pass
+	for (unsigned int i = 1; i < chunks.size(); i++)
+	{
+		if (chunks[i].section == chunks[i - 1].section && chunks[i].begin != chunks[i - 1].stop)
+		{
+			chunks[i].begin = chunks[i - 1].stop;
+			stats[i] = ISet_x86::DecodeStatistics();
+			decodeChunk(i);
+		}
+	}
+
+	for (unsigned int i = 1; i < stats.size(); i++)
+	{
+		stats[0].Merge(stats[i]);
+	}
+
+	return stats[0].ToJSON();
+}
+
+std::vector<FunctionFingerprint> Arch_x86::FingerprintFunctions(const std::vector<AddressRange> &functions, unsigned int threadCount)
+{
+	Decode();
+
+	std::vector<FunctionFingerprint> prints {};
+	if (instructions.empty())
+	{
+		return prints;
+	}
+
+	auto spans = FunctionSpans(functions);
+	prints.resize(spans.size());
+	std::atomic<unsigned int> next {0};
+	auto worker = [&]()
+	{
+		// The graphs only live while their function is hashed, so each thread reuses one arena
+		Arena arena {};
+		for (unsigned int i = next++; i < spans.size(); i = next++)
+		{
+			prints[i] = FingerprintFunction(instructions, spans[i].first, spans[i].second, instructionsAddress, targets, arena);
+			arena.Reset();
+		}
+	};
+
+	threadCount = std::max(1u, std::min(threadCount, static_cast<unsigned int>(spans.size())));
+	std::vector<std::thread> threads {};
+	for (unsigned int t = 1; t < threadCount; t++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	// Functions that decoded to nothing have no address to report
+	prints.erase(std::remove_if(prints.begin(), prints.end(), [](const FunctionFingerprint &p)
+	{
+		return p.instrCount == 0;
+	}), prints.end());
+
+	return prints;
+}
+
+std::vector<std::string> Arch_x86::RegisterLiveness(const std::vector<AddressRange> &functions, unsigned int threadCount)
+{
+	Decode();
+
+	std::vector<std::string> lines {};
+	if (instructions.empty())
+	{
+		return lines;
+	}
+
+	auto spans = FunctionSpans(functions);
+	lines.resize(spans.size());
+	std::atomic<unsigned int> next {0};
+	auto worker = [&]()
+	{
+		Arena arena {};
+		for (unsigned int i = next++; i < spans.size(); i = next++)
+		{
+			if (spans[i].first >= spans[i].second)
+			{
+				continue;
+			}
+
+			ControlFlowGraph cfg(instructions, spans[i].first, spans[i].second, instructionsAddress, targets, arena);
+			Liveness liveness(cfg, instructions, arena);
+
+			std::stringstream line {};
+			line << std::hex << instructionsAddress + instructions[spans[i].first].attrib.runtime.segmentByteOffset;
+			line << ":\tin: " << RegisterSetString(liveness.LiveIn(0)) << "\tdead:";
+			for (auto dead : liveness.DeadDefinitions())
+			{
+				line << ' ' << instructionsAddress + instructions[dead].attrib.runtime.segmentByteOffset;
+			}
+
+			lines[i] = line.str();
+			arena.Reset();
+		}
+	};
+
+	threadCount = std::max(1u, std::min(threadCount, static_cast<unsigned int>(spans.size())));
+	std::vector<std::thread> threads {};
+	for (unsigned int t = 1; t < threadCount; t++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+
+	for (auto &thread : threads)
+	{
+		thread.join();
+	}
+
+	lines.erase(std::remove(lines.begin(), lines.end(), std::string()), lines.end());
+	return lines;
+}
+
+std::vector<std::string> Arch_x86::FindGadgets(unsigned int depth, unsigned int threadCount)
+{
+	std::vector<std::string> lines {};
+
+	auto finder = GadgetFinder(segment, depth);
+	for (auto &gadget : finder.Find(threadCount))
+	{
+		std::stringstream line {};
+		line << std::hex << gadget.address << std::dec << ":\t" << gadget.text;
+		if (gadget.count > 1)
+		{
+			line << "\t(" << gadget.count << " found)";
+		}
+		lines.push_back(line.str());
+	}
+
+	return lines;
+}
+
+std::vector<SearchMatch> Arch_x86::SearchInstructions(const std::vector<InstructionPattern> &patterns)
+{
+	std::vector<SearchMatch> matches {};
+	if (instructions.empty())
+	{
+		return matches;
+	}
+
+	// Only patterns that can start with an instruction's mnemonic are tried at it
+	std::map<std::string, std::vector<uint32_t>> byMnemonic {};
+	std::vector<uint32_t> anyFirst {};
+	for (uint32_t p = 0; p < patterns.size(); p++)
+	{
+		auto &first = patterns[p].elements.front().mnemonic;
+		if (first.empty())
+		{
+			anyFirst.push_back(p);
+		}
+		else
+		{
+			byMnemonic[first].push_back(p);
+		}
+	}
+
+	auto &section = segment.seg->at(segment.FindSection(instructionsAddress)->name);
+	auto translator = Translator(std::vector<Instruction>(), &section, instructionsAddress);
+
+	// Operand text is only rendered for instructions a pattern reaches
+	std::vector<std::vector<std::string>> operands(instructions.size());
+	std::vector<bool> rendered(instructions.size());
+	auto matchElement = [&](std::size_t i, const InstructionPatternElement &element)
+	{
+		auto &instr = instructions[i];
+		if (!instr.attrib.flags.resolved)
+		{
+			return false;
+		}
+
+		if (!element.mnemonic.empty() && element.mnemonic != instr.attrib.intrinsic.mnemonic)
+		{
+			return false;
+		}
+
+		if (element.operands.empty())
+		{
+			return true;
+		}
+
+		if (!rendered[i])
+		{
+			operands[i] = translator.OperandStrings(instr);
+			rendered[i] = true;
+		}
+
+		if (operands[i].size() != element.operands.size())
+		{
+			return false;
+		}
+
+		for (std::size_t o = 0; o < element.operands.size(); o++)
+		{
+			if (element.operands[o] != "*" && element.operands[o] != operands[i][o])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	};
+
+	auto tryPattern = [&](std::size_t i, uint32_t p)
+	{
+		auto &elements = patterns[p].elements;
+		if (i + elements.size() > instructions.size())
+		{
+			return;
+		}
+
+		for (std::size_t e = 0; e < elements.size(); e++)
+		{
+			if (!matchElement(i + e, elements[e]))
+			{
+				return;
+			}
+		}
+
+		matches.push_back({instructionsAddress + instructions[i].attrib.runtime.segmentByteOffset, p});
+	};
+
+	for (std::size_t i = 0; i < instructions.size(); i++)
+	{
+		auto candidates = byMnemonic.find(instructions[i].attrib.intrinsic.mnemonic);
+		if (candidates != byMnemonic.end())
+		{
+			for (auto p : candidates->second)
+			{
+				tryPattern(i, p);
+			}
+		}
+
+		for (auto p : anyFirst)
+		{
+			tryPattern(i, p);
+		}
+	}
+
+	return matches;
+}
+
+void Arch_x86::IndexReferences(uint64_t sectionAddress)
+{
+	// Branch targets, absolute memory operands and immediates that look like addresses
+	for (auto &instr : instructions)
+	{
+		if (!instr.attrib.flags.resolved)
+		{
+			continue;
+		}
+
+		uint64_t source = sectionAddress + instr.attrib.runtime.segmentByteOffset;
+
+		if (instr.HasRelativeTarget())
+		{
+			auto type = (instr.attrib.intrinsic.flow == ControlFlow::CALL) ? XrefType::CALL : XrefType::JUMP;
+			xrefs.Add(source, instr.RelativeTarget(sectionAddress), type);
+		}
+
+		uint64_t address = 0;
+		if (instr.AbsoluteMemoryAddress(address) && IsMapped(address))
+		{
+			xrefs.Add(source, address, XrefType::MEMORY);
+		}
+
+		if (instr.HasImmediate() && IsMapped(instr.encoded.immd))
+		{
+			xrefs.Add(source, instr.encoded.immd, XrefType::IMMEDIATE);
+		}
+	}
+
+	for (auto &table : jumpTables)
+	{
+		for (auto target : table.targets)
+		{
+			xrefs.Add(table.dispatch, target, XrefType::JUMP);
+		}
+	}
+
+	xrefs.Finalize();
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> Arch_x86::FunctionSpans(const std::vector<AddressRange> &functions)
+{
+	uint64_t sectionEnd = instructionsAddress + segment.seg->at(".text").size();
+
+	auto instrIndex = [&](uint64_t address)
+	{
+		auto pos = std::lower_bound(instructions.begin(), instructions.end(), address - instructionsAddress, [](const Instruction &instr, uint64_t offset)
+		{
+			return instr.attrib.runtime.segmentByteOffset < offset;
+		});
+		return static_cast<uint32_t>(pos - instructions.begin());
+	};
+
+	std::vector<std::pair<uint32_t, uint32_t>> spans {};
+	for (auto &func : functions)
+	{
+		if (func.begin >= instructionsAddress && func.begin < sectionEnd)
+		{
+			spans.push_back({instrIndex(func.begin), instrIndex(std::min(func.end, sectionEnd))});
+		}
+	}
+
+	return spans;
+}
+
 std::vector<Instruction> Arch_x86::GetInstructionData()
 {
 	if (instructions.size() == 0)
@@ -55,3 +654,13 @@ std::vector<Instruction> Arch_x86::GetInstructionData()
 
 	return instructions;
 }
+
+const BranchTargets & Arch_x86::GetBranchTargets()
+{
+	return targets;
+}
+
+ControlFlowGraph Arch_x86::BuildControlFlowGraph(Arena &arena)
+{
+	return ControlFlowGraph(instructions, 0, instructions.size(), instructionsAddress, targets, arena);
+}
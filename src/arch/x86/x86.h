@@ -8,19 +8,45 @@
 #include "instruction.h"
 #include "decode.h"
 #include "translate.h"
+#include "targets.h"
+#include "recursive.h"
+#include "cfg.h"
 
 class Arch_x86 final : public Arch
 {
 public:
 	Arch_x86(Segment segment);
 
+	void Decode();
 	std::vector<std::string> TranslateToAssembly();
-	std::vector<std::string> TranslateToSource();
+	std::vector<std::string> TranslateToAssembly(AddressRange range, uint64_t boundary);
+	std::vector<std::string> TranslateToSource(const std::vector<AddressRange> &functions, unsigned int threadCount);
+	std::vector<uint64_t> FindFunctionStarts();
+	const XrefIndex & GetXrefs();
+	std::string CollectStatistics(const std::vector<uint64_t> &boundaries, unsigned int threadCount);
+	std::vector<SearchMatch> SearchInstructions(const std::vector<InstructionPattern> &patterns);
+	std::vector<FunctionFingerprint> FingerprintFunctions(const std::vector<AddressRange> &functions, unsigned int threadCount);
+	std::vector<std::string> RegisterLiveness(const std::vector<AddressRange> &functions, unsigned int threadCount);
+	std::vector<std::string> FindGadgets(unsigned int depth, unsigned int threadCount);
 
 	std::vector<ISet_x86::Instruction> GetInstructionData();
+	const ISet_x86::BranchTargets & GetBranchTargets();
+	// Graph of the most recently decoded instructions, allocated in the given arena
+	ISet_x86::ControlFlowGraph BuildControlFlowGraph(Arena &arena);
 
 private:
 	std::vector<ISet_x86::Instruction> instructions;
+	uint64_t instructionsAddress {}; // Virtual address of the section the instructions were decoded from
+	ISet_x86::BranchTargets targets;
+	std::vector<ISet_x86::JumpTable> jumpTables; // Only recovered by recursive decoding
+#ifdef DISASM_COUNTERS
+	ISet_x86::DecoderCounters counters {}; // Of the last decode
+#endif
+	XrefIndex xrefs;
+
+	void IndexReferences(uint64_t sectionAddress);
+	// Index span in the decoded stream of each function that starts in it
+	std::vector<std::pair<uint32_t, uint32_t>> FunctionSpans(const std::vector<AddressRange> &functions);
 	std::vector<std::string> assembly;
 
 	friend class ISet_x86::LinearDecoder;
@@ -0,0 +1,468 @@
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "../util/common.h"
+#include "../format/format.h"
+#include "../arch/x86/x86.h"
+#include "../arch/x86/context.h"
+#include "../arch/x86/decode.h"
+#include "../arch/x86/translate.h"
+#include "../util/alloc.h"
+
+// Benchmarks each stage of disassembly separately, on executables, on hex dumps such as
+// data/bindump, and on raw machine code:
+//
+//     disasm_bench [--json] [--iterations=N] [FILE...]
+//
+// Files written by disasm_gen are also checked against their FILE.boundaries sidecar, and
+// the bench fails if the decoder doesn't find the same instructions
+
+using namespace ISet_x86;
+
+namespace
+{
+
+struct Stage
+{
+	std::string name {};
+	std::vector<double> seconds {}; // One sample per iteration, sorted
+	double allocations {}; // Per iteration
+	double allocatedBytes {}; // Per iteration
+	uint64_t peakBytes {}; // Most bytes live at once, over and above those live before the stage
+
+	// Amount of work done by one iteration, 0 if it doesn't apply
+	uint64_t bytes {};
+	uint64_t instructions {};
+	uint64_t lines {};
+
+	double Median() const { return seconds[seconds.size() / 2]; }
+	double P99() const { return seconds[std::min(seconds.size() - 1, seconds.size() * 99 / 100)]; }
+};
+
+struct FileResult
+{
+	std::string path {};
+	uint64_t bytes {};
+	uint64_t instructions {};
+	std::vector<Stage> stages {};
+
+	// Against the boundaries disasm_gen wrote next to the file, if there are any
+	bool checked {};
+	uint64_t mismatch {UINT64_MAX}; // Offset of the first instruction decoded differently
+};
+
+Stage Measure(std::string name, unsigned int iterations, const std::function<void()> &body)
+{
+	Stage stage {};
+	stage.name = name;
+
+	Alloc::ResetPeaks();
+	Alloc::Counts before = Alloc::Totals();
+	uint64_t liveBefore = before.peak; // The peak was just reset to the bytes live
+	for (unsigned int i = 0; i < iterations; i++)
+	{
+		auto begin = std::chrono::steady_clock::now();
+		body();
+		auto end = std::chrono::steady_clock::now();
+		stage.seconds.push_back(std::chrono::duration<double>(end - begin).count());
+	}
+
+	Alloc::Counts after = Alloc::Totals();
+	stage.allocations = static_cast<double>(after.allocations - before.allocations) / iterations;
+	stage.allocatedBytes = static_cast<double>(after.bytes - before.bytes) / iterations;
+	stage.peakBytes = after.peak - liveBefore;
+	std::sort(stage.seconds.begin(), stage.seconds.end());
+	return stage;
+}
+
+std::vector<byte> ReadFile(std::string path)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (file.fail())
+	{
+		std::cout << "ERROR: File '" << path << "' not found." << '\n';
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<byte> bytes(static_cast<std::size_t>(file.tellg()));
+	file.seekg(0);
+	file.read(reinterpret_cast<char *>(bytes.data()), bytes.size());
+	return bytes;
+}
+
+// Machine code written as whitespace separated hex bytes, as in data/bindump
+bool ParseHexDump(const std::vector<byte> &text, std::vector<byte> &code)
+{
+	code.clear();
+	int digits = 0;
+	byte value = 0;
+
+	for (auto c : text)
+	{
+		if (std::isspace(c))
+		{
+			if (digits != 0)
+			{
+				code.push_back(value);
+			}
+			digits = 0;
+			value = 0;
+			continue;
+		}
+
+		if (!std::isxdigit(c) || ++digits > 2)
+		{
+			return false;
+		}
+
+		value = value << 4 | static_cast<byte>(std::isdigit(c) ? c - '0' : std::tolower(c) - 'a' + 10);
+	}
+
+	if (digits != 0)
+	{
+		code.push_back(value);
+	}
+
+	return !code.empty();
+}
+
+// Offset of the first instruction whose start or size differs from the sidecar, UINT64_MAX if none
+uint64_t CheckBoundaries(std::ifstream &sidecar, const std::vector<Instruction> &instrs)
+{
+	std::size_t i = 0;
+	uint64_t offset = 0;
+	unsigned int size = 0;
+
+	for (; sidecar >> offset >> size; i++)
+	{
+		if (i >= instrs.size() || instrs[i].attrib.runtime.segmentByteOffset != offset || instrs[i].attrib.runtime.size != size)
+		{
+			return (i < instrs.size()) ? std::min<uint64_t>(offset, instrs[i].attrib.runtime.segmentByteOffset) : offset;
+		}
+	}
+
+	return (i < instrs.size()) ? instrs[i].attrib.runtime.segmentByteOffset : UINT64_MAX;
+}
+
+bool IsExecutable(const std::vector<byte> &image)
+{
+	try
+	{
+		Format::GetFormatType(&image);
+		return true;
+	}
+	catch (const std::runtime_error &e)
+	{
+		return false;
+	}
+}
+
+FileResult BenchFile(std::string path, unsigned int iterations)
+{
+	FileResult result {};
+	result.path = path;
+
+	std::vector<byte> image = ReadFile(path);
+	result.bytes = image.size();
+
+	std::vector<byte> text {};
+	uint64_t textAddress = 0;
+	bool executable = IsExecutable(image);
+
+	if (executable)
+	{
+		auto format = Format::NewFormat(&image, Format::GetFormatType(&image));
+		auto code = format->GetCodeSegment();
+		auto section = code.seg->find(".text");
+		if (section == code.seg->end())
+		{
+			std::cout << "ERROR: '" << path << "' has no .text section." << '\n';
+			exit(EXIT_FAILURE);
+		}
+
+		text = section->second;
+		textAddress = code.addr->at(".text");
+
+		result.stages.push_back(Measure("format", iterations, [&image]()
+		{
+			Metadata metadata {};
+			auto format = Format::NewFormat(&image, Format::GetFormatType(&image));
+			format->LoadMetadata(metadata);
+			format->GetCodeSegment();
+		}));
+		result.stages.back().bytes = image.size();
+	}
+
+	// Anything that isn't an executable or a hex dump is taken to be raw machine code
+	bool hexDump = !executable && ParseHexDump(image, text);
+	if (!executable && !hexDump)
+	{
+		text = image;
+	}
+
+	auto decoder = LinearDecoder(&text);
+	std::vector<Instruction> instrs = decoder.DecodeSection();
+	result.instructions = instrs.size();
+
+	std::ifstream sidecar(path + ".boundaries");
+	if (sidecar.is_open())
+	{
+		result.checked = true;
+		result.mismatch = CheckBoundaries(sidecar, instrs);
+	}
+
+	result.stages.push_back(Measure("decode", iterations, [&text]()
+	{
+		auto decoder = LinearDecoder(&text);
+		decoder.DecodeSection();
+	}));
+	result.stages.back().bytes = text.size();
+	result.stages.back().instructions = instrs.size();
+
+	auto targets = BranchTargets(instrs, textAddress);
+	uint64_t lineCount = 0;
+	result.stages.push_back(Measure("translate", iterations, [&]()
+	{
+		auto translator = Translator(instrs, &text, textAddress, &targets);
+		lineCount = translator.TranslateToASM().size();
+	}));
+	result.stages.back().instructions = instrs.size();
+	result.stages.back().lines = lineCount;
+
+	// Everything the disassembler does for a listing, from reading the file to the last line
+	result.stages.push_back(Measure("end_to_end", iterations, [&]()
+	{
+		std::vector<byte> file = ReadFile(path);
+		if (executable)
+		{
+			Metadata metadata {};
+			auto format = Format::NewFormat(&file, Format::GetFormatType(&file));
+			format->LoadMetadata(metadata);
+			Arch_x86 arch(format->GetCodeSegment());
+			arch.TranslateToAssembly();
+		}
+		else
+		{
+			std::vector<byte> code = file;
+			if (hexDump)
+			{
+				ParseHexDump(file, code);
+			}
+			auto decoder = LinearDecoder(&code);
+			auto decoded = decoder.DecodeSection();
+			auto translator = Translator(decoded, &code, 0, &targets);
+			translator.TranslateToASM();
+		}
+	}));
+	result.stages.back().bytes = image.size();
+	result.stages.back().instructions = instrs.size();
+
+	return result;
+}
+
+std::string JSONStage(const Stage &stage)
+{
+	std::stringstream json {};
+	json << std::fixed << std::setprecision(6);
+	json << "{\"name\": \"" << stage.name << "\", \"median_ms\": " << stage.Median() * 1000 << ", \"p99_ms\": " << stage.P99() * 1000;
+	json << ", \"allocations\": " << stage.allocations << ", \"allocated_bytes\": " << stage.allocatedBytes << ", \"peak_bytes\": " << stage.peakBytes;
+
+	if (stage.bytes != 0)
+	{
+		json << ", \"bytes_per_s\": " << stage.bytes / stage.Median();
+	}
+
+	if (stage.instructions != 0)
+	{
+		json << ", \"instructions_per_s\": " << stage.instructions / stage.Median();
+		json << ", \"allocations_per_instruction\": " << stage.allocations / stage.instructions;
+	}
+
+	if (stage.lines != 0)
+	{
+		json << ", \"lines_per_s\": " << stage.lines / stage.Median();
+	}
+
+	json << "}";
+	return json.str();
+}
+
+std::string TextStage(const Stage &stage)
+{
+	std::stringstream text {};
+	text << std::fixed << std::setprecision(3);
+	text << std::left << std::setw(12) << stage.name << std::right;
+	text << "median " << std::setw(10) << stage.Median() * 1000 << " ms  p99 " << std::setw(10) << stage.P99() * 1000 << " ms";
+
+	if (stage.bytes != 0)
+	{
+		text << "  " << stage.bytes / stage.Median() / 1e6 << " MB/s";
+	}
+
+	if (stage.instructions != 0)
+	{
+		text << "  " << stage.instructions / stage.Median() / 1e6 << " M instructions/s";
+	}
+
+	if (stage.lines != 0)
+	{
+		text << "  " << stage.lines / stage.Median() / 1e6 << " M lines/s";
+	}
+
+	if (stage.instructions != 0)
+	{
+		text << "  " << std::setprecision(2) << stage.allocations / stage.instructions << " allocations/instruction";
+	}
+	else
+	{
+		text << "  " << std::setprecision(0) << stage.allocations << " allocations";
+	}
+	text << "  " << stage.peakBytes / 1024 << " KiB peak";
+
+	return text.str();
+}
+
+void PrintJSON(const Stage &reference, const std::vector<FileResult> &results)
+{
+	std::cout << "{\n";
+	std::cout << "  \"reference\": " << JSONStage(reference) << ",\n";
+	std::cout << "  \"files\": [";
+
+	for (std::size_t i = 0; i < results.size(); i++)
+	{
+		const auto &result = results[i];
+		std::cout << (i == 0 ? "\n" : ",\n");
+		std::cout << "    {\"path\": \"" << result.path << "\", \"bytes\": " << result.bytes << ", \"instructions\": " << result.instructions;
+		if (result.checked)
+		{
+			std::cout << ", \"boundaries_match\": " << (result.mismatch == UINT64_MAX ? "true" : "false");
+		}
+		std::cout << ", \"stages\": [";
+		for (std::size_t s = 0; s < result.stages.size(); s++)
+		{
+			std::cout << (s == 0 ? "\n" : ",\n") << "      " << JSONStage(result.stages[s]);
+		}
+		std::cout << "\n    ]}";
+	}
+
+	std::cout << "\n  ]\n}\n";
+}
+
+void PrintText(const Stage &reference, const std::vector<FileResult> &results)
+{
+	std::cout << TextStage(reference) << '\n';
+	for (const auto &result : results)
+	{
+		std::cout << '\n' << result.path << " (" << result.bytes << " bytes, " << result.instructions << " instructions)" << '\n';
+		if (result.checked && result.mismatch == UINT64_MAX)
+		{
+			std::cout << "  boundaries match" << '\n';
+		}
+		else if (result.checked)
+		{
+			std::cout << "  boundaries differ from offset 0x" << std::hex << result.mismatch << std::dec << '\n';
+		}
+		for (const auto &stage : result.stages)
+		{
+			std::cout << "  " << TextStage(stage) << '\n';
+		}
+	}
+}
+
+};
+
+int main(int argc, const char * argv[])
+{
+	bool json = false;
+	unsigned int iterations = 20;
+	std::vector<std::string> paths {};
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--json")
+		{
+			json = true;
+		}
+
+		else if (arg.compare(0, 13, "--iterations=") == 0)
+		{
+			try
+			{
+				iterations = std::stoul(arg.substr(13));
+			}
+			catch (const std::exception &e)
+			{
+				iterations = 0;
+			}
+
+			if (iterations == 0)
+			{
+				std::cout << "ERROR: Iterations must be a positive number." << '\n';
+				exit(EXIT_FAILURE);
+			}
+		}
+
+		else if (arg.compare(0, 2, "--") == 0)
+		{
+			std::cout << "ERROR: Unknown flag '" << arg << "'." << '\n';
+			exit(EXIT_FAILURE);
+		}
+
+		else
+		{
+			paths.push_back(arg);
+		}
+	}
+
+	// Without arguments, the bundled sample and a binary every system has
+	if (paths.empty())
+	{
+		paths.push_back(DATA_PATH + "bindump");
+		if (std::ifstream("/bin/ls").good())
+		{
+			paths.push_back("/bin/ls");
+		}
+	}
+
+	Stage reference = Measure("reference", iterations, []()
+	{
+		DecoderContext context {};
+	});
+	DecoderContext::Shared();
+
+	std::vector<FileResult> results {};
+	for (auto &path : paths)
+	{
+		results.push_back(BenchFile(path, iterations));
+	}
+
+	if (json)
+	{
+		PrintJSON(reference, results);
+	}
+	else
+	{
+		PrintText(reference, results);
+	}
+
+	// A decoder that got faster by going wrong shouldn't pass
+	for (auto &result : results)
+	{
+		if (result.checked && result.mismatch != UINT64_MAX)
+		{
+			return EXIT_FAILURE;
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
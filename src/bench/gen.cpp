@@ -0,0 +1,543 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "../util/common.h"
+#include "../arch/x86/context.h"
+#include "../arch/x86/decode.h"
+
+// Writes a reproducible stream of x86 instructions sampled from the reference table, for
+// benchmarking the decoder on the same input across versions:
+//
+//     disasm_gen [--length=BYTES] [--seed=N] [--mix=FORM:WEIGHT,...] [--elf] OUTPUT
+//
+// The start offset and size of every instruction are written to OUTPUT.boundaries, one
+// "offset size" pair per line, with offsets relative to the start of the code
+
+using namespace ISet_x86;
+
+namespace
+{
+
+// Forms of the ModR/M operand, chosen by weight for every instruction that has one
+enum ModRMForm
+{
+	REGISTER, // mod 11
+	INDIRECT, // [reg]
+	DISP8, // [reg + disp8]
+	DISP32, // [reg + disp32]
+	ABSOLUTE, // [disp32]
+	SIB, // [base + index * scale], with or without a displacement
+	FORM_COUNT
+};
+
+const char * FORM_NAMES[FORM_COUNT] = {"register", "indirect", "disp8", "disp32", "absolute", "sib"};
+
+const byte LEGACY_PREFIXES[] = {0x66, 0x67, 0xF2, 0xF3, 0xF0, 0x2E, 0x36, 0x3E, 0x26, 0x64, 0x65};
+
+const int MAX_ATTEMPTS = 16; // Encodings tried per reference entry before it is left out of the pool
+
+struct Options
+{
+	uint64_t length {64 * 1024};
+	uint32_t seed {1};
+	unsigned int weights[FORM_COUNT] {4, 2, 3, 1, 1, 2};
+	unsigned int prefixPercent {10}; // Instructions with at least one legacy prefix
+	bool elf {};
+	std::string output {};
+};
+
+class Generator
+{
+public:
+	Generator(const Options &options)
+		: options(options), rng(options.seed)
+	{
+		for (auto weight : options.weights)
+		{
+			weightTotal += weight;
+		}
+	}
+
+	// Reference entries that the decoder reads back at the length they were encoded with
+	void BuildPool()
+	{
+		for (int id = 1; id < DecoderContext::Shared().References().size(); id++)
+		{
+			for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++)
+			{
+				if (!Encode(id).empty())
+				{
+					pool.push_back(id);
+					break;
+				}
+			}
+		}
+
+		if (pool.empty())
+		{
+			std::cout << "ERROR: No reference entry could be encoded." << '\n';
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	void Generate(std::vector<byte> &code, std::vector<std::pair<uint64_t, uint8_t>> &boundaries)
+	{
+		while (options.length - code.size() >= MAX_INSTRUCTION_SIZE)
+		{
+			auto bytes = Encode(pool[Random(pool.size())]);
+			if (!bytes.empty())
+			{
+				boundaries.push_back({code.size(), static_cast<uint8_t>(bytes.size())});
+				code.insert(code.end(), bytes.begin(), bytes.end());
+			}
+		}
+
+		// The end is padded with nops rather than cutting an instruction short
+		while (code.size() < options.length)
+		{
+			boundaries.push_back({code.size(), 1});
+			code.push_back(0x90);
+		}
+	}
+
+	std::size_t PoolSize() const
+	{
+		return pool.size();
+	}
+
+private:
+	const Options &options;
+	// The Mersenne twister's output is fixed by the standard, so a seed gives the same stream
+	// everywhere, which the standard distributions don't guarantee
+	std::mt19937 rng;
+	unsigned int weightTotal {};
+	std::vector<int> pool {};
+
+	uint32_t Random(uint32_t n)
+	{
+		return rng() % n;
+	}
+
+	ModRMForm ChooseForm()
+	{
+		uint32_t pick = Random(weightTotal);
+		for (int form = 0; form < FORM_COUNT; form++)
+		{
+			if (pick < options.weights[form])
+			{
+				return static_cast<ModRMForm>(form);
+			}
+			pick -= options.weights[form];
+		}
+
+		return REGISTER;
+	}
+
+	static bool UsesModRM(AddrMethod method)
+	{
+		switch (method)
+		{
+			case AddrMethod::C: case AddrMethod::D: case AddrMethod::E: case AddrMethod::G:
+			case AddrMethod::M: case AddrMethod::N: case AddrMethod::P: case AddrMethod::Q:
+			case AddrMethod::R: case AddrMethod::S: case AddrMethod::U: case AddrMethod::V:
+			case AddrMethod::W:
+				return true;
+			default:
+				return false;
+		}
+	}
+
+	void EncodeModRM(std::vector<byte> &bytes, const Instruction &instr, int reg)
+	{
+		bool memoryOnly = false;
+		bool registerOnly = false;
+		for (auto op : {&instr.op1, &instr.op2, &instr.op3, &instr.op4})
+		{
+			auto method = op->attrib.intrinsic.addrMethod;
+			memoryOnly |= method == AddrMethod::M;
+			registerOnly |= method == AddrMethod::R || method == AddrMethod::N || method == AddrMethod::U;
+		}
+
+		ModRMForm form = ChooseForm();
+		if (registerOnly)
+		{
+			form = REGISTER;
+		}
+		else if (memoryOnly && form == REGISTER)
+		{
+			form = INDIRECT;
+		}
+
+		byte reg3 = static_cast<byte>((reg >= 0 ? reg : Random(8)) << 3);
+		byte rm = Random(8);
+		// rm 100 is the SIB escape and mod 00 rm 101 is [disp32], so other forms avoid them
+		byte plainRm = (rm == 0b100 || rm == 0b101) ? 0b011 : rm;
+
+		switch (form)
+		{
+			case REGISTER:
+				bytes.push_back(0b11000000 | reg3 | rm);
+				break;
+			case INDIRECT:
+				bytes.push_back(0b00000000 | reg3 | plainRm);
+				break;
+			case DISP8:
+				bytes.push_back(0b01000000 | reg3 | (rm == 0b100 ? 0b101 : rm));
+				bytes.push_back(Random(256));
+				break;
+			case DISP32:
+				bytes.push_back(0b10000000 | reg3 | (rm == 0b100 ? 0b101 : rm));
+				EncodeValue(bytes, 4);
+				break;
+			case ABSOLUTE:
+				bytes.push_back(0b00000000 | reg3 | 0b101);
+				EncodeValue(bytes, 4);
+				break;
+			default:
+			{
+				// Any mod but 11, with a SIB base of 101 under mod 00 also taking a disp32
+				byte mod = Random(3);
+				byte sib = Random(256);
+				bytes.push_back(static_cast<byte>(mod << 6) | reg3 | 0b100);
+				bytes.push_back(sib);
+
+				int dispSize = (mod == 0b01) ? 1 : ((mod == 0b10 || (sib & 0b111) == 0b101) ? 4 : 0);
+				EncodeValue(bytes, dispSize);
+				break;
+			}
+		}
+	}
+
+	void EncodeValue(std::vector<byte> &bytes, int size)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			bytes.push_back(Random(256));
+		}
+	}
+
+	// One encoding of the reference entry, or nothing if the decoder doesn't read it back
+	// as a single instruction of the same length
+	std::vector<byte> Encode(int id)
+	{
+		Instruction instr = DecoderContext::Shared().References().GetReferenceById(id);
+		const auto &opcode = instr.encoded.opcode;
+		std::vector<byte> bytes {};
+
+		if (Random(100) < options.prefixPercent)
+		{
+			int count = 1 + (Random(4) == 0);
+			for (int i = 0; i < count; i++)
+			{
+				byte prefix = LEGACY_PREFIXES[Random(sizeof(LEGACY_PREFIXES))];
+				if (std::find(bytes.begin(), bytes.end(), prefix) == bytes.end())
+				{
+					bytes.push_back(prefix);
+					instr.encoded.prefix[instr.attrib.runtime.prefixCount++] = prefix;
+				}
+			}
+		}
+
+		if (opcode.mandatoryPrefix != INVALID)
+		{
+			bytes.push_back(opcode.mandatoryPrefix);
+		}
+
+		if (opcode.twoByte)
+		{
+			bytes.push_back(0x0F);
+		}
+
+		byte primary = static_cast<byte>(opcode.primary);
+		bytes.push_back(opcode.fields.regEncoded ? (primary & ~0b111) | Random(8) : primary);
+
+		if (opcode.secondary != INVALID)
+		{
+			bytes.push_back(static_cast<byte>(opcode.secondary));
+		}
+
+		const Operand * ops[] = {&instr.op1, &instr.op2, &instr.op3, &instr.op4};
+		bool modrm = opcode.extension != INVALID;
+		for (auto op : ops)
+		{
+			modrm |= UsesModRM(op->attrib.intrinsic.addrMethod);
+		}
+
+		if (modrm)
+		{
+			EncodeModRM(bytes, instr, opcode.extension);
+		}
+
+		for (auto op : ops)
+		{
+			switch (op->attrib.intrinsic.addrMethod)
+			{
+				case AddrMethod::I:
+					EncodeValue(bytes, instr.OperandByteSize(*op));
+					break;
+				case AddrMethod::J:
+					EncodeValue(bytes, (op->attrib.intrinsic.type == OperandType::b || op->attrib.intrinsic.type == OperandType::bs) ? 1 : 4);
+					break;
+				case AddrMethod::O:
+					EncodeValue(bytes, instr.HasPrefix(0x67) ? 2 : 4);
+					break;
+				case AddrMethod::A:
+					EncodeValue(bytes, instr.HasPrefix(0x66) ? 4 : 6);
+					break;
+				default:
+					break;
+			}
+		}
+
+		if (bytes.size() > MAX_INSTRUCTION_SIZE)
+		{
+			return {};
+		}
+
+		std::vector<Instruction> decoded {};
+		try
+		{
+			auto decoder = LinearDecoder(&bytes);
+			decoded = decoder.DecodeSection();
+		}
+		catch (const std::runtime_error &e)
+		{
+			return {};
+		}
+
+		if (decoded.size() != 1 || !decoded[0].attrib.flags.resolved || decoded[0].attrib.runtime.size != bytes.size())
+		{
+			return {};
+		}
+
+		return bytes;
+	}
+};
+
+// Minimal ELF32 executable with the code as its .text section
+std::vector<byte> WrapELF(const std::vector<byte> &code)
+{
+	const uint32_t textAddress = 0x08049000;
+	const uint32_t textOffset = 0x100;
+	const char shstrtab[] = "\0.text\0.shstrtab";
+	const uint32_t shstrtabSize = sizeof(shstrtab);
+	const uint32_t shstrtabOffset = textOffset + code.size();
+	const uint32_t sectionHeaderOffset = (shstrtabOffset + shstrtabSize + 3) & ~3u;
+
+	std::vector<byte> image(sectionHeaderOffset + 3 * 40);
+	auto put16 = [&image](std::size_t offset, uint16_t value)
+	{
+		image[offset] = value & 0xFF;
+		image[offset + 1] = value >> 8;
+	};
+	auto put32 = [&image, &put16](std::size_t offset, uint32_t value)
+	{
+		put16(offset, value & 0xFFFF);
+		put16(offset + 2, value >> 16);
+	};
+
+	const byte ident[] = {0x7F, 'E', 'L', 'F', 1, 1, 1};
+	std::copy(std::begin(ident), std::end(ident), image.begin());
+	put16(16, 2); // ET_EXEC
+	put16(18, 3); // EM_386
+	put32(20, 1);
+	put32(24, textAddress);
+	put32(32, sectionHeaderOffset);
+	put16(40, 52);
+	put16(42, 32);
+	put16(46, 40);
+	put16(48, 3);
+	put16(50, 2);
+
+	std::copy(code.begin(), code.end(), image.begin() + textOffset);
+	std::memcpy(&image[shstrtabOffset], shstrtab, shstrtabSize);
+
+	// Null header, then .text and .shstrtab
+	std::size_t text = sectionHeaderOffset + 40;
+	put32(text, 1);
+	put32(text + 4, 1); // SHT_PROGBITS
+	put32(text + 8, 6); // SHF_ALLOC | SHF_EXECINSTR
+	put32(text + 12, textAddress);
+	put32(text + 16, textOffset);
+	put32(text + 20, code.size());
+	put32(text + 32, 16);
+
+	std::size_t names = sectionHeaderOffset + 80;
+	put32(names, 7);
+	put32(names + 4, 3); // SHT_STRTAB
+	put32(names + 16, shstrtabOffset);
+	put32(names + 20, shstrtabSize);
+	put32(names + 32, 1);
+
+	return image;
+}
+
+uint64_t ParseNumber(std::string value, std::string flag)
+{
+	try
+	{
+		return std::stoull(value, nullptr, 0);
+	}
+	catch (const std::exception &e)
+	{
+		std::cout << "ERROR: Invalid value '" << value << "' for " << flag << "." << '\n';
+		exit(EXIT_FAILURE);
+	}
+}
+
+// FORM:WEIGHT pairs separated by commas, with "prefix" taking the percentage of prefixed instructions
+void ParseMix(std::string value, Options &options)
+{
+	std::map<std::string, unsigned int> weights {};
+	std::size_t begin = 0;
+	while (begin <= value.size())
+	{
+		std::size_t end = value.find(',', begin);
+		if (end == std::string::npos)
+		{
+			end = value.size();
+		}
+
+		std::string pair = value.substr(begin, end - begin);
+		auto sep = pair.find(':');
+		if (sep == std::string::npos)
+		{
+			std::cout << "ERROR: Mix entries must be given as form:weight." << '\n';
+			exit(EXIT_FAILURE);
+		}
+
+		weights[pair.substr(0, sep)] = ParseNumber(pair.substr(sep + 1), "--mix");
+		begin = end + 1;
+	}
+
+	std::fill(std::begin(options.weights), std::end(options.weights), 0);
+	unsigned int total = 0;
+	for (auto &entry : weights)
+	{
+		if (entry.first == "prefix")
+		{
+			options.prefixPercent = std::min(entry.second, 100u);
+			continue;
+		}
+
+		auto form = std::find_if(std::begin(FORM_NAMES), std::end(FORM_NAMES), [&entry](const char * name)
+		{
+			return entry.first == name;
+		});
+
+		if (form == std::end(FORM_NAMES))
+		{
+			std::cout << "ERROR: Unknown form '" << entry.first << "' in --mix." << '\n';
+			exit(EXIT_FAILURE);
+		}
+
+		options.weights[form - std::begin(FORM_NAMES)] = entry.second;
+		total += entry.second;
+	}
+
+	if (total == 0)
+	{
+		std::cout << "ERROR: --mix needs a positive weight for at least one form." << '\n';
+		exit(EXIT_FAILURE);
+	}
+}
+
+Options ParseOptions(int argc, const char * argv[])
+{
+	Options options {};
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		auto eq = arg.find('=');
+		std::string flag = arg.substr(0, eq);
+		std::string value = (eq == std::string::npos) ? "" : arg.substr(eq + 1);
+
+		if (flag == "--length")
+		{
+			options.length = ParseNumber(value, flag);
+		}
+
+		else if (flag == "--seed")
+		{
+			options.seed = ParseNumber(value, flag);
+		}
+
+		else if (flag == "--mix")
+		{
+			ParseMix(value, options);
+		}
+
+		else if (arg == "--elf")
+		{
+			options.elf = true;
+		}
+
+		else if (arg.compare(0, 2, "--") == 0)
+		{
+			std::cout << "ERROR: Unknown flag '" << arg << "'." << '\n';
+			exit(EXIT_FAILURE);
+		}
+
+		else
+		{
+			options.output = arg;
+		}
+	}
+
+	if (options.output.empty())
+	{
+		std::cout << "Usage: disasm_gen [--length=BYTES] [--seed=N] [--mix=FORM:WEIGHT,...] [--elf] OUTPUT" << '\n';
+		exit(EXIT_FAILURE);
+	}
+
+	if (options.length == 0)
+	{
+		std::cout << "ERROR: Length must be positive." << '\n';
+		exit(EXIT_FAILURE);
+	}
+
+	return options;
+}
+
+};
+
+int main(int argc, const char * argv[])
+{
+	Options options = ParseOptions(argc, argv);
+
+	DecoderContext::Shared();
+
+	Generator generator(options);
+	generator.BuildPool();
+
+	std::vector<byte> code {};
+	std::vector<std::pair<uint64_t, uint8_t>> boundaries {};
+	generator.Generate(code, boundaries);
+
+	std::vector<byte> image = options.elf ? WrapELF(code) : code;
+	std::ofstream output(options.output, std::ios::binary);
+	output.write(reinterpret_cast<const char *>(image.data()), image.size());
+
+	std::ofstream sidecar(options.output + ".boundaries");
+	for (auto &boundary : boundaries)
+	{
+		sidecar << boundary.first << ' ' << static_cast<int>(boundary.second) << '\n';
+	}
+
+	if (output.fail() || sidecar.fail())
+	{
+		std::cout << "ERROR: Failed to write '" << options.output << "'." << '\n';
+		exit(EXIT_FAILURE);
+	}
+
+	std::cout << code.size() << " bytes, " << boundaries.size() << " instructions from " << generator.PoolSize() << " opcodes" << '\n';
+	return EXIT_SUCCESS;
+}
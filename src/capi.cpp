@@ -0,0 +1,312 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "../include/disasm.h"
+#include "util/common.h"
+#include "format/format.h"
+#include "arch/x86/context.h"
+#include "arch/x86/decode.h"
+#include "arch/x86/targets.h"
+#include "arch/x86/translate.h"
+
+using namespace ISet_x86;
+
+struct disasm_image
+{
+	struct Section
+	{
+		std::string name {};
+		uint64_t address {};
+		std::vector<byte> bytes {};
+		bool code {};
+	};
+
+	std::vector<Section> sections {};
+};
+
+namespace
+{
+
+std::atomic<bool> initialised {false};
+
+// Takes the sections out of a segment returned by a format, and frees the segment
+void AddSections(disasm_image &image, Segment segment, bool code)
+{
+	for (auto &range : *segment.index)
+	{
+		disasm_image::Section section {};
+		section.name = range.name;
+		section.address = range.range.begin;
+		section.bytes = std::move(segment.seg->at(range.name));
+		section.code = code;
+		image.sections.push_back(std::move(section));
+	}
+
+	delete segment.seg;
+	delete segment.addr;
+	delete segment.index;
+}
+
+// The decoder and translator only read the section, but take it by pointer to non-const
+std::vector<byte> * Bytes(const disasm_image::Section &section)
+{
+	return const_cast<std::vector<byte> *>(&section.bytes);
+}
+
+void Convert(const Instruction &instr, uint64_t sectionAddress, disasm_instruction &out)
+{
+	out = disasm_instruction {};
+	out.offset = static_cast<uint32_t>(instr.attrib.runtime.segmentByteOffset);
+	out.address = sectionAddress + out.offset;
+	out.target = instr.HasRelativeTarget() ? instr.RelativeTarget(sectionAddress) : 0;
+	out.reference_id = instr.attrib.intrinsic.referenceId;
+	out.size = instr.attrib.runtime.size;
+	out.prefix_count = instr.attrib.runtime.prefixCount;
+	out.flow = static_cast<uint8_t>(instr.attrib.intrinsic.flow);
+	out.resolved = instr.attrib.flags.resolved;
+	std::strncpy(out.mnemonic, instr.attrib.intrinsic.mnemonic.c_str(), sizeof(out.mnemonic) - 1);
+}
+
+disasm_status CheckSection(const disasm_image * image, size_t section, uint64_t offset)
+{
+	if (!initialised.load(std::memory_order_acquire))
+	{
+		return DISASM_ERROR_NOT_INITIALISED;
+	}
+
+	if (image == nullptr || section >= image->sections.size() || offset > image->sections[section].bytes.size())
+	{
+		return DISASM_ERROR_ARGUMENT;
+	}
+
+	return DISASM_OK;
+}
+
+};
+
+disasm_status disasm_init(const char * data_path)
+{
+	std::string path = (data_path != nullptr) ? data_path : DATA_PATH;
+	if (!path.empty() && path.back() != '/')
+	{
+		path += '/';
+	}
+
+	// The shared context is only built once, and a failed build is tried again by the next call
+	try
+	{
+		DecoderContext::Shared(path);
+	}
+	catch (...)
+	{
+		return DISASM_ERROR_REFERENCE;
+	}
+
+	initialised.store(true, std::memory_order_release);
+	return DISASM_OK;
+}
+
+const char * disasm_status_string(disasm_status status)
+{
+	switch (status)
+	{
+		case DISASM_OK:
+			return "ok";
+		case DISASM_ERROR_ARGUMENT:
+			return "invalid argument";
+		case DISASM_ERROR_NOT_INITIALISED:
+			return "disasm_init has not succeeded";
+		case DISASM_ERROR_REFERENCE:
+			return "failed to load the opcode reference";
+		case DISASM_ERROR_FORMAT:
+			return "unsupported executable format";
+		case DISASM_ERROR_BUFFER_TOO_SMALL:
+			return "buffer too small";
+		case DISASM_ERROR_INTERNAL:
+			return "internal error";
+	}
+
+	return "unknown status";
+}
+
+disasm_status disasm_image_open(const uint8_t * data, size_t size, disasm_image ** image)
+{
+	if (data == nullptr || image == nullptr)
+	{
+		return DISASM_ERROR_ARGUMENT;
+	}
+	*image = nullptr;
+
+	try
+	{
+		std::vector<byte> binDump(data, data + size);
+		auto format = Format::NewFormat(&binDump, Format::GetFormatType(&binDump));
+		Metadata metadata {};
+		format->LoadMetadata(metadata);
+
+		auto opened = new disasm_image();
+		AddSections(*opened, format->GetCodeSegment(), true);
+		AddSections(*opened, format->GetDataSegment(), false);
+		*image = opened;
+	}
+	catch (...)
+	{
+		return DISASM_ERROR_FORMAT;
+	}
+
+	return DISASM_OK;
+}
+
+disasm_status disasm_image_open_raw(const uint8_t * code, size_t size, uint64_t address, disasm_image ** image)
+{
+	if (code == nullptr || image == nullptr)
+	{
+		return DISASM_ERROR_ARGUMENT;
+	}
+
+	try
+	{
+		disasm_image::Section section {};
+		section.name = ".text";
+		section.address = address;
+		section.bytes = std::vector<byte>(code, code + size);
+		section.code = true;
+
+		*image = new disasm_image();
+		(*image)->sections.push_back(std::move(section));
+	}
+	catch (...)
+	{
+		*image = nullptr;
+		return DISASM_ERROR_INTERNAL;
+	}
+
+	return DISASM_OK;
+}
+
+void disasm_image_close(disasm_image * image)
+{
+	delete image;
+}
+
+size_t disasm_section_count(const disasm_image * image)
+{
+	return (image != nullptr) ? image->sections.size() : 0;
+}
+
+disasm_status disasm_section_get(const disasm_image * image, size_t index, disasm_section * section)
+{
+	if (image == nullptr || section == nullptr || index >= image->sections.size())
+	{
+		return DISASM_ERROR_ARGUMENT;
+	}
+
+	auto &found = image->sections[index];
+	section->name = found.name.c_str();
+	section->address = found.address;
+	section->size = found.bytes.size();
+	section->code = found.code;
+	return DISASM_OK;
+}
+
+disasm_status disasm_decode(const disasm_image * image, size_t section, uint64_t offset,
+	disasm_instruction * instructions, size_t capacity, size_t * count)
+{
+	disasm_status status = CheckSection(image, section, offset);
+	if (status != DISASM_OK)
+	{
+		return status;
+	}
+
+	if ((instructions == nullptr && capacity != 0) || count == nullptr)
+	{
+		return DISASM_ERROR_ARGUMENT;
+	}
+	*count = 0;
+
+	try
+	{
+		// No instruction is longer than MAX_INSTRUCTION_SIZE, so the first capacity instructions
+		// are all inside this window
+		auto &found = image->sections[section];
+		uint64_t remaining = found.bytes.size() - offset;
+		uint64_t window = (capacity >= remaining) ? remaining : static_cast<uint64_t>(capacity) * MAX_INSTRUCTION_SIZE;
+		uint64_t end = offset + std::min(window, remaining);
+
+		auto decoder = LinearDecoder(Bytes(found), offset, end);
+		for (auto &instr : decoder.DecodeSection())
+		{
+			if (*count == capacity)
+			{
+				break;
+			}
+
+			Convert(instr, found.address, instructions[(*count)++]);
+		}
+	}
+	catch (...)
+	{
+		*count = 0;
+		return DISASM_ERROR_INTERNAL;
+	}
+
+	return DISASM_OK;
+}
+
+disasm_status disasm_format(const disasm_image * image, size_t section, uint64_t offset, uint64_t size,
+	char * buffer, size_t capacity, size_t * length)
+{
+	disasm_status status = CheckSection(image, section, offset);
+	if (status != DISASM_OK)
+	{
+		return status;
+	}
+
+	if ((buffer == nullptr && capacity != 0) || length == nullptr)
+	{
+		return DISASM_ERROR_ARGUMENT;
+	}
+
+	std::string listing {};
+	try
+	{
+		// Let the last instruction in the range run past its end
+		auto &found = image->sections[section];
+		uint64_t limit = (size > found.bytes.size() - offset) ? found.bytes.size() : offset + size;
+		uint64_t end = std::min<uint64_t>(found.bytes.size(), limit + MAX_INSTRUCTION_SIZE);
+
+		std::vector<Instruction> instrs {};
+		auto decoder = LinearDecoder(Bytes(found), offset, end);
+		for (auto &instr : decoder.DecodeSection())
+		{
+			if (instr.attrib.runtime.segmentByteOffset < limit)
+			{
+				instrs.push_back(instr);
+			}
+		}
+
+		auto targets = BranchTargets(instrs, found.address);
+		auto translator = Translator(instrs, Bytes(found), found.address, &targets);
+		for (auto &line : translator.TranslateToASM())
+		{
+			listing += line;
+			listing += '\n';
+		}
+	}
+	catch (...)
+	{
+		return DISASM_ERROR_INTERNAL;
+	}
+
+	*length = listing.size();
+	if (listing.size() >= capacity)
+	{
+		return DISASM_ERROR_BUFFER_TOO_SMALL;
+	}
+
+	std::memcpy(buffer, listing.c_str(), listing.size() + 1);
+	return DISASM_OK;
+}
@@ -1,22 +1,197 @@
+#include <array>
 #include <fstream>
 #include <iostream>
+#include <algorithm>
+#include <tuple>
+#include <iterator>
+#include <thread>
 
 #include "exec.h"
+#include "util/trace.h"
+#include "util/alloc.h"
 
 Executable::Executable(std::string path)
 {
+	TRACE_SPAN("Executable::Executable");
+	this->path = path;
 	filePeek = PeekFile(path);
 	
-	FormatType type = Format::GetFormatType(filePeek); 
+	// The format parsers report malformed and unsupported files as exceptions
+	try
+	{
+		FormatType type = Format::GetFormatType(filePeek); 
+
+		binDump = LoadExecutable(path); 
+
+		format = Format::NewFormat(binDump, type);
+		format->LoadMetadata(metadata);
 
-	binDump = LoadExecutable(path); 
+		code = format->GetCodeSegment();
+		symbols = format->GetSymbols();
+		arch = Arch::NewArch(code, metadata.arch);
+		arch->SetMappedSections(format->GetMappedSections());
+		LoadFunctionTable();
 
-	format = Format::NewFormat(binDump, type);
-	format->LoadMetadata(metadata);
+		if (processFlags.recursive)
+		{
+			std::vector<uint64_t> entryPoints {};
+			for (auto &func : functions)
+			{
+				entryPoints.push_back(func.begin);
+			}
 
-	Segment seg = format->GetCodeSegment();
-	arch = Arch::NewArch(seg, metadata.arch);
-	std::vector<std::string> assembly = arch->TranslateToAssembly();
+			if (entryPoints.empty())
+			{
+				entryPoints = arch->FindFunctionStarts();
+			}
+
+			arch->SetEntryPoints(entryPoints);
+			arch->SetDataSegment(format->GetDataSegment());
+		}
+	}
+	catch (const std::runtime_error &e)
+	{
+		std::cout << "ERROR: " << e.what() << "." << '\n';
+		exit(EXIT_FAILURE);
+	}
+}
+
+void Executable::Run()
+{
+	TRACE_SPAN("Executable::Run");
+	if (!processFlags.diffPath.empty())
+	{
+		Executable old(processFlags.diffPath);
+		PrintDiff(old);
+		return;
+	}
+
+	if (!processFlags.indexAddPath.empty() || !processFlags.indexQueryPath.empty())
+	{
+		try
+		{
+			if (!processFlags.indexAddPath.empty())
+			{
+				SimilarityIndex::Add(processFlags.indexAddPath, path, Sketches());
+			}
+
+			if (!processFlags.indexQueryPath.empty())
+			{
+				QueryIndex(processFlags.indexQueryPath);
+			}
+		}
+		catch (const std::runtime_error &e)
+		{
+			std::cout << "ERROR: " << e.what() << '\n';
+			exit(EXIT_FAILURE);
+		}
+
+		return;
+	}
+
+	if (processFlags.stats)
+	{
+		std::vector<uint64_t> boundaries {};
+		for (auto &func : functions)
+		{
+			boundaries.push_back(func.begin);
+		}
+
+		std::cout << arch->CollectStatistics(boundaries, std::thread::hardware_concurrency());
+		return;
+	}
+
+	if (processFlags.gadgetDepth > 0)
+	{
+		for (auto &line : arch->FindGadgets(processFlags.gadgetDepth, std::thread::hardware_concurrency()))
+		{
+			std::cout << line << '\n';
+		}
+		return;
+	}
+
+	if (processFlags.liveness)
+	{
+		for (auto &line : arch->RegisterLiveness(functions, std::thread::hardware_concurrency()))
+		{
+			std::cout << line << '\n';
+		}
+		return;
+	}
+
+	if (!processFlags.searchPath.empty())
+	{
+		Search(processFlags.searchPath);
+		return;
+	}
+
+	strings.Scan(format->GetDataSegment());
+	arch->SetStringTable(&strings);
+
+	if (processFlags.strings)
+	{
+		PrintStrings();
+		return;
+	}
+
+	if (!processFlags.signaturePath.empty())
+	{
+		MatchLibraryFunctions(processFlags.signaturePath);
+		arch->SetLibraryFunctions(&library);
+	}
+
+	if (processFlags.xref)
+	{
+		arch->Decode();
+		PrintXrefs(processFlags.xrefAddress);
+		return;
+	}
+
+	std::vector<std::string> assembly {};
+	if (processFlags.source)
+	{
+		std::vector<AddressRange> selected = functions;
+		if (!processFlags.symbol.empty() || !processFlags.range.Empty())
+		{
+			AddressRange range = processFlags.symbol.empty() ? processFlags.range : ResolveSymbol(processFlags.symbol);
+			selected.erase(std::remove_if(selected.begin(), selected.end(), [&range](const AddressRange &func)
+			{
+				return func.begin < range.begin || func.begin >= range.end;
+			}), selected.end());
+		}
+
+		assembly = arch->TranslateToSource(selected, std::thread::hardware_concurrency());
+	}
+
+	else if (!processFlags.symbol.empty() || !processFlags.range.Empty())
+	{
+		AddressRange range = processFlags.range;
+		if (!processFlags.symbol.empty())
+		{
+			range = ResolveSymbol(processFlags.symbol);
+		}
+
+		// A range outside every code section is an argument error
+		try
+		{
+			assembly = arch->TranslateToAssembly(range, NearestBoundary(range.begin));
+		}
+		catch (const std::runtime_error &e)
+		{
+			std::cout << "ERROR: " << e.what() << "." << '\n';
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	else
+	{
+		assembly = arch->TranslateToAssembly();
+	}
+
+	for (auto &line : assembly)
+	{
+		std::cout << line << '\n';
+	}
 }
 
 Executable::~Executable()
@@ -54,6 +229,8 @@ std::vector<byte> * Executable::PeekFile(std::string path)
 
 std::vector<byte> * Executable::LoadExecutable(std::string path)
 {
+	TRACE_SPAN("Executable::LoadExecutable");
+	ALLOC_STAGE(LOAD);
 	std::ifstream file(path, std::ios::binary | std::ios::ate);
 	std::size_t fileSize = file.tellg();
 	if (file.fail())
@@ -71,3 +248,297 @@ std::vector<byte> * Executable::LoadExecutable(std::string path)
 	return binDump;
 }
 
+void Executable::LoadFunctionTable()
+// Merges the ranges from unwind metadata with the function symbols into one table
+{
+	functions = format->GetFunctionRanges();
+	for (auto &sym : symbols)
+	{
+		functions.push_back({sym.address, sym.address + sym.size});
+	}
+
+	// Stripped images without unwind metadata have to fall back on prologue scanning
+	if (functions.empty())
+	{
+		for (auto start : arch->FindFunctionStarts())
+		{
+			functions.push_back({start, start});
+		}
+	}
+
+	// Where both sources describe the same function, keep whichever range is longer
+	std::sort(functions.begin(), functions.end(), [](const AddressRange &a, const AddressRange &b)
+	{
+		return a.begin < b.begin || (a.begin == b.begin && a.end > b.end);
+	});
+
+	auto last = std::unique(functions.begin(), functions.end(), [](const AddressRange &a, const AddressRange &b)
+	{
+		return a.begin == b.begin;
+	});
+	functions.erase(last, functions.end());
+
+	// Symbols without a size extend up to the next known function
+	for (unsigned int i = 0; i < functions.size(); i++)
+	{
+		if (functions[i].Empty())
+		{
+			functions[i].end = (i + 1 < functions.size()) ? functions[i + 1].begin : UINT64_MAX;
+		}
+	}
+}
+
+AddressRange Executable::ResolveSymbol(std::string name)
+{
+	for (auto &sym : symbols)
+	{
+		if (sym.name == name)
+		{
+			auto func = std::lower_bound(functions.begin(), functions.end(), sym.address, [](const AddressRange &f, uint64_t a)
+			{
+				return f.begin < a;
+			});
+
+			return *func;
+		}
+	}
+
+	std::cout << "ERROR: Symbol '" << name << "' not found." << '\n';
+	exit(EXIT_FAILURE);
+}
+
+std::vector<FunctionFingerprint> Executable::Fingerprints()
+{
+	return arch->FingerprintFunctions(functions, std::thread::hardware_concurrency());
+}
+
+std::string Executable::FunctionName(uint64_t address)
+{
+	auto sym = std::lower_bound(symbols.begin(), symbols.end(), address, [](const Symbol &s, uint64_t a)
+	{
+		return s.address < a;
+	});
+
+	if (sym != symbols.end() && sym->address == address)
+	{
+		return sym->name;
+	}
+
+	return "";
+}
+
+void Executable::PrintDiff(Executable &old)
+{
+	auto diffs = DiffFunctions(old.Fingerprints(), Fingerprints());
+
+	std::sort(diffs.begin(), diffs.end(), [](const FunctionDiff &a, const FunctionDiff &b)
+	{
+		return std::tie(a.status, a.newAddress, a.oldAddress) < std::tie(b.status, b.newAddress, b.oldAddress);
+	});
+
+	std::array<unsigned int, 4> counts {};
+	for (auto &diff : diffs)
+	{
+		counts[static_cast<int>(diff.status)]++;
+		if (diff.status == DiffStatus::UNCHANGED)
+		{
+			continue;
+		}
+
+		std::string name = (diff.status == DiffStatus::REMOVED) ? old.FunctionName(diff.oldAddress) : FunctionName(diff.newAddress);
+
+		std::cout << DiffStatusName(diff.status) << '\t' << std::hex;
+		if (diff.status != DiffStatus::ADDED)
+		{
+			std::cout << diff.oldAddress;
+		}
+		std::cout << '\t';
+		if (diff.status != DiffStatus::REMOVED)
+		{
+			std::cout << diff.newAddress;
+		}
+		std::cout << std::dec << '\t' << name;
+		if (diff.status == DiffStatus::CHANGED)
+		{
+			std::cout << '\t' << diff.similarity;
+		}
+		std::cout << '\n';
+	}
+
+	std::cout << counts[static_cast<int>(DiffStatus::UNCHANGED)] << " unchanged, " << counts[static_cast<int>(DiffStatus::CHANGED)] << " changed, "
+		<< counts[static_cast<int>(DiffStatus::ADDED)] << " added, " << counts[static_cast<int>(DiffStatus::REMOVED)] << " removed" << '\n';
+}
+
+std::vector<IndexedFunction> Executable::Sketches()
+{
+	std::vector<IndexedFunction> sketches {};
+	for (auto &print : Fingerprints())
+	{
+		if (print.instrCount >= MIN_INDEXED_INSTRUCTIONS)
+		{
+			sketches.push_back({print.address, print.instrCount, FunctionName(print.address), ComputeSketch(print.shingles)});
+		}
+	}
+
+	return sketches;
+}
+
+void Executable::QueryIndex(std::string indexPath)
+{
+	const double threshold = 0.5;
+	const std::size_t limit = 10;
+
+	SimilarityIndex index(indexPath);
+
+	// Only the selected function is looked up if there is one
+	uint64_t only = processFlags.symbol.empty() ? 0 : ResolveSymbol(processFlags.symbol).begin;
+
+	for (auto &func : Sketches())
+	{
+		if (only != 0 && func.address != only)
+		{
+			continue;
+		}
+
+		auto matches = index.Query(func.sketch, threshold, limit);
+		if (matches.empty())
+		{
+			continue;
+		}
+
+		std::cout << std::hex << func.address << std::dec << '\t' << func.name << '\n';
+		for (auto &match : matches)
+		{
+			auto found = index.Function(match.function);
+			std::cout << '\t' << match.similarity << '\t' << index.BinaryName(match.function) << '\t'
+				<< std::hex << found.address << std::dec << '\t' << found.name << '\n';
+		}
+	}
+}
+
+void Executable::MatchLibraryFunctions(std::string path)
+{
+	SignatureTrie trie {};
+	try
+	{
+		trie.Load(path);
+	}
+	catch (const std::runtime_error &e)
+	{
+		std::cout << "ERROR: " << e.what() << '\n';
+		exit(EXIT_FAILURE);
+	}
+
+	for (auto &func : functions)
+	{
+		const SectionRange * section = code.FindSection(func.begin);
+		if (section == nullptr)
+		{
+			continue;
+		}
+
+		auto &data = code.seg->at(section->name);
+		auto offset = func.begin - section->range.begin;
+		const LibrarySignature * match = trie.Match(data.data() + offset, data.size() - offset);
+		if (match != nullptr)
+		{
+			library.push_back({{func.begin, func.begin + match->size}, match->name});
+		}
+	}
+}
+
+void Executable::PrintXrefs(uint64_t address)
+{
+	auto &xrefs = arch->GetXrefs();
+
+	std::cout << std::hex;
+	for (auto &ref : xrefs.To(address))
+	{
+		std::cout << "0x" << ref.source << " -> 0x" << ref.target << "\t" << XrefTypeName(ref.type) << '\n';
+	}
+
+	for (auto &ref : xrefs.From(address))
+	{
+		std::cout << "0x" << ref.source << " -> 0x" << ref.target << "\t" << XrefTypeName(ref.type) << '\n';
+	}
+	std::cout << std::dec;
+}
+
+void Executable::PrintStrings()
+{
+	for (auto &entry : strings.Entries())
+	{
+		std::cout << std::hex << entry.address << std::dec << ":\t";
+		std::cout << (entry.encoding == StringEncoding::UTF16 ? "utf16" : "ascii") << '\t' << QuoteString(entry.text) << '\n';
+	}
+}
+
+void Executable::Search(std::string path)
+{
+	std::vector<BytePattern> bytePatterns {};
+	std::vector<InstructionPattern> instrPatterns {};
+	PatternMatcher matcher {};
+
+	try
+	{
+		LoadSearchPatterns(path, bytePatterns, instrPatterns);
+		for (auto &pattern : bytePatterns)
+		{
+			matcher.Add(pattern);
+		}
+	}
+	catch (const std::runtime_error &e)
+	{
+		std::cout << "ERROR: " << e.what() << '\n';
+		exit(EXIT_FAILURE);
+	}
+
+	matcher.Compile();
+
+	// Byte patterns run over code and data alike, with one pass per section
+	std::vector<std::pair<uint64_t, std::string>> found {};
+	std::vector<SearchMatch> matches {};
+	for (auto segment : {code, format->GetDataSegment()})
+	{
+		for (auto &section : *segment.index)
+		{
+			auto &data = segment.seg->at(section.name);
+			matcher.Search(data.data(), data.size(), section.range.begin, matches);
+		}
+	}
+
+	for (auto &match : matches)
+	{
+		found.push_back({match.address, bytePatterns[match.pattern].name});
+	}
+
+	if (!instrPatterns.empty())
+	{
+		arch->Decode();
+		for (auto &match : arch->SearchInstructions(instrPatterns))
+		{
+			found.push_back({match.address, instrPatterns[match.pattern].name});
+		}
+	}
+
+	std::sort(found.begin(), found.end());
+	for (auto &match : found)
+	{
+		std::cout << std::hex << match.first << std::dec << ":\t" << match.second << '\n';
+	}
+}
+
+uint64_t Executable::NearestBoundary(uint64_t address)
+{
+	auto next = std::upper_bound(functions.begin(), functions.end(), address, [](uint64_t a, const AddressRange &f)
+	{
+		return a < f.begin;
+	});
+
+	if (next == functions.begin())
+	{
+		return 0; // No known boundary, decoding starts at the beginning of the section
+	}
+
+	return std::prev(next)->begin;
+}
@@ -7,21 +7,49 @@
 
 #include "arch/arch.h"
 #include "format/format.h"
+#include "analysis/stringtable.h"
+#include "analysis/signature.h"
+#include "analysis/diff.h"
+#include "analysis/minhash.h"
 
 
 class Executable
 {
 public:
+	// Loads the executable and its function table
 	Executable(std::string path);
 	~Executable();
 
+	// Runs whichever mode the process flags select
+	void Run();
+
+	std::vector<FunctionFingerprint> Fingerprints();
+	std::string FunctionName(uint64_t address); // Empty if no symbol starts at the address
+
 private:
+	std::string path;
 	Metadata metadata;
 	std::vector<byte> * filePeek;
 	std::vector<byte> * binDump;
 	std::unique_ptr<Format> format;
 	std::unique_ptr<Arch> arch;
+	Segment code;
+	std::vector<Symbol> symbols; // Sorted by address
+	std::vector<AddressRange> functions; // Known function boundaries, sorted by address
+	StringTable strings;
+	std::vector<LibraryFunction> library; // Functions matched by a signature, sorted by address
 
 	std::vector<byte> * PeekFile(std::string path);
 	std::vector<byte> * LoadExecutable(std::string path);
+
+	void LoadFunctionTable();
+	AddressRange ResolveSymbol(std::string name);
+	uint64_t NearestBoundary(uint64_t address); // Closest known instruction start at or before address
+	void PrintDiff(Executable &old);
+	std::vector<IndexedFunction> Sketches(); // MinHash sketches of the functions worth indexing
+	void QueryIndex(std::string indexPath);
+	void MatchLibraryFunctions(std::string path);
+	void PrintXrefs(uint64_t address);
+	void PrintStrings();
+	void Search(std::string path);
 };
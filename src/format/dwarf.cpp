@@ -0,0 +1,326 @@
+#include <algorithm>
+
+#include "dwarf.h"
+
+EHFrameReader::EHFrameReader(const std::vector<byte> * binDump, int addressSize, FileSection frame)
+{
+	this->binDump = binDump;
+	this->addressSize = addressSize;
+	this->frame = frame;
+}
+
+std::vector<AddressRange> EHFrameReader::ReadWithHeader(FileSection hdr)
+{
+	std::vector<AddressRange> ranges {};
+
+	if (hdr.size < 4 || hdr.offset + hdr.size > binDump->size())
+	{
+		return ranges;
+	}
+
+	ByteSequence bs(binDump, hdr.offset);
+
+	auto version = bs.ReadBytes<uint8_t>();
+	auto framePtrEnc = bs.ReadBytes<uint8_t>();
+	auto countEnc = bs.ReadBytes<uint8_t>();
+	auto tableEnc = bs.ReadBytes<uint8_t>();
+
+	if (version != 1 || countEnc == DW_EH_PE_omit || tableEnc == DW_EH_PE_omit)
+	{
+		return ranges;
+	}
+
+	ReadEncoded(bs, framePtrEnc, hdr.address, hdr.offset, hdr.address);
+	uint64_t count = ReadEncoded(bs, countEnc, hdr.address, hdr.offset, hdr.address);
+
+	// The table entries are only read for their FDE addresses, since the FDE has the length
+	for (uint64_t i = 0; i < count && bs.offset < hdr.offset + hdr.size; i++)
+	{
+		ReadEncoded(bs, tableEnc, hdr.address, hdr.offset, hdr.address);
+		uint64_t fdeAddress = ReadEncoded(bs, tableEnc, hdr.address, hdr.offset, hdr.address);
+
+		AddressRange range {};
+		if (fdeAddress >= frame.address && ReadFDE(frame.offset + (fdeAddress - frame.address), range))
+		{
+			ranges.push_back(range);
+		}
+	}
+
+	// The table is sorted by initial location already, but keep the guarantee for other readers
+	std::sort(ranges.begin(), ranges.end(), [](const AddressRange &a, const AddressRange &b)
+	{
+		return a.begin < b.begin;
+	});
+
+	return ranges;
+}
+
+std::vector<AddressRange> EHFrameReader::ReadAll()
+{
+	std::vector<AddressRange> ranges {};
+
+	uint64_t offset = frame.offset;
+	while (InFrame(offset, 4))
+	{
+		ByteSequence bs(binDump, offset);
+		uint64_t length = bs.ReadBytes<uint32_t>();
+		if (length == 0) // Terminator
+		{
+			break;
+		}
+
+		if (length == 0xffffffff)
+		{
+			length = bs.ReadBytes<uint64_t>();
+		}
+
+		AddressRange range {};
+		if (ReadFDE(offset, range))
+		{
+			ranges.push_back(range);
+		}
+
+		offset = bs.offset + length;
+	}
+
+	std::sort(ranges.begin(), ranges.end(), [](const AddressRange &a, const AddressRange &b)
+	{
+		return a.begin < b.begin;
+	});
+
+	return ranges;
+}
+
+bool EHFrameReader::ReadFDE(uint64_t offset, AddressRange &range)
+{
+	if (!InFrame(offset, 8))
+	{
+		return false;
+	}
+
+	ByteSequence bs(binDump, offset);
+	uint64_t length = bs.ReadBytes<uint32_t>();
+	if (length == 0xffffffff)
+	{
+		length = bs.ReadBytes<uint64_t>();
+	}
+
+	if (length == 0 || !InFrame(bs.offset, length))
+	{
+		return false;
+	}
+
+	// The CIE pointer is the distance back to the CIE from this field, and is zero for CIEs
+	uint64_t ciePtrOffset = bs.offset;
+	uint32_t ciePtr = bs.ReadBytes<uint32_t>();
+	if (ciePtr == 0 || ciePtr > ciePtrOffset)
+	{
+		return false;
+	}
+
+	int encoding = ReadCIEEncoding(ciePtrOffset - ciePtr);
+	if (encoding == DW_EH_PE_omit)
+	{
+		return false;
+	}
+
+	range.begin = ReadEncoded(bs, encoding, frame.address, frame.offset, 0);
+	// The range is a length, so only the format part of the encoding applies to it
+	range.end = range.begin + ReadEncoded(bs, encoding & 0x0f, frame.address, frame.offset, 0);
+
+	return !range.Empty();
+}
+
+int EHFrameReader::ReadCIEEncoding(uint64_t offset)
+{
+	if (cieEncodings.count(offset) > 0)
+	{
+		return cieEncodings.at(offset);
+	}
+
+	int encoding = DW_EH_PE_absptr;
+	cieEncodings[offset] = DW_EH_PE_omit;
+
+	if (!InFrame(offset, 9))
+	{
+		return DW_EH_PE_omit;
+	}
+
+	ByteSequence bs(binDump, offset);
+	uint64_t length = bs.ReadBytes<uint32_t>();
+	if (length == 0xffffffff)
+	{
+		length = bs.ReadBytes<uint64_t>();
+	}
+
+	uint64_t end = bs.offset + length;
+	if (!InFrame(bs.offset, length) || bs.ReadBytes<uint32_t>() != 0)
+	{
+		return DW_EH_PE_omit;
+	}
+
+	auto version = bs.ReadBytes<uint8_t>();
+
+	std::string augmentation {};
+	while (bs.offset < end && (*binDump)[bs.offset] != 0)
+	{
+		augmentation += (*binDump)[bs.offset++];
+	}
+	bs.offset++;
+
+	if (augmentation.find("eh") != std::string::npos)
+	{
+		bs.offset += addressSize;
+	}
+
+	ReadULEB128(bs); // Code alignment factor
+	ReadSLEB128(bs); // Data alignment factor
+	if (version == 1)
+	{
+		bs.ReadBytes<uint8_t>(); // Return address register
+	}
+	else
+	{
+		ReadULEB128(bs);
+	}
+
+	// Only the 'R' augmentation is needed, the others are skipped over to reach it
+	if (!augmentation.empty() && augmentation[0] == 'z')
+	{
+		ReadULEB128(bs);
+
+		for (unsigned int i = 1; i < augmentation.size() && bs.offset < end; i++)
+		{
+			if (augmentation[i] == 'R')
+			{
+				encoding = bs.ReadBytes<uint8_t>();
+			}
+
+			else if (augmentation[i] == 'L')
+			{
+				bs.ReadBytes<uint8_t>();
+			}
+
+			else if (augmentation[i] == 'P')
+			{
+				int personalityEnc = bs.ReadBytes<uint8_t>();
+				ReadEncoded(bs, personalityEnc, frame.address, frame.offset, 0);
+			}
+		}
+	}
+
+	cieEncodings[offset] = encoding;
+	return encoding;
+}
+
+bool EHFrameReader::InFrame(uint64_t offset, uint64_t size)
+{
+	return offset >= frame.offset && offset + size <= frame.offset + frame.size && offset + size <= binDump->size();
+}
+
+uint64_t EHFrameReader::ReadEncoded(ByteSequence &bs, int encoding, uint64_t sectionAddress, uint64_t sectionOffset, uint64_t dataRel)
+{
+	if (encoding == DW_EH_PE_omit)
+	{
+		return 0;
+	}
+
+	// Address the value is being read from, for pc-relative values
+	uint64_t fieldAddress = sectionAddress + (bs.offset - sectionOffset);
+	uint64_t value = 0;
+
+	switch (encoding & 0x0f)
+	{
+		case DW_EH_PE_absptr:
+			value = (addressSize == 8) ? bs.ReadBytes<uint64_t>() : bs.ReadBytes<uint32_t>();
+			break;
+		case DW_EH_PE_uleb128:
+			value = ReadULEB128(bs);
+			break;
+		case DW_EH_PE_udata2:
+			value = bs.ReadBytes<uint16_t>();
+			break;
+		case DW_EH_PE_udata4:
+			value = bs.ReadBytes<uint32_t>();
+			break;
+		case DW_EH_PE_udata8:
+			value = bs.ReadBytes<uint64_t>();
+			break;
+		case DW_EH_PE_sleb128:
+			value = ReadSLEB128(bs);
+			break;
+		case DW_EH_PE_sdata2:
+			value = static_cast<int16_t>(bs.ReadBytes<uint16_t>());
+			break;
+		case DW_EH_PE_sdata4:
+			value = static_cast<int32_t>(bs.ReadBytes<uint32_t>());
+			break;
+		case DW_EH_PE_sdata8:
+			value = bs.ReadBytes<uint64_t>();
+			break;
+		default:
+			return 0;
+	}
+
+	switch (encoding & 0x70)
+	{
+		case DW_EH_PE_pcrel:
+			value += fieldAddress;
+			break;
+		case DW_EH_PE_datarel:
+			value += dataRel;
+			break;
+		default:
+			break;
+	}
+
+	if (addressSize == 4)
+	{
+		value &= 0xffffffff;
+	}
+
+	return value;
+}
+
+uint64_t EHFrameReader::ReadULEB128(ByteSequence &bs)
+{
+	uint64_t value = 0;
+	int shift = 0;
+	byte b = 0;
+
+	do
+	{
+		b = bs.ReadBytes<uint8_t>();
+		if (shift < 64)
+		{
+			value |= static_cast<uint64_t>(b & 0x7f) << shift;
+		}
+		shift += 7;
+	} while (b & 0x80);
+
+	return value;
+}
+
+int64_t EHFrameReader::ReadSLEB128(ByteSequence &bs)
+{
+	int64_t value = 0;
+	int shift = 0;
+	byte b = 0;
+
+	do
+	{
+		b = bs.ReadBytes<uint8_t>();
+		if (shift < 64)
+		{
+			value |= static_cast<int64_t>(b & 0x7f) << shift;
+		}
+		shift += 7;
+	} while (b & 0x80);
+
+	if (shift < 64 && (b & 0x40))
+	{
+		value |= -(static_cast<int64_t>(1) << shift);
+	}
+
+	return value;
+}
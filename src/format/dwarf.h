@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+
+#include "../util/common.h"
+#include "../util/util.h"
+
+// Reference:
+// https://refspecs.linuxfoundation.org/LSB_5.0.0/LSB-Core-generic/LSB-Core-generic/ehframechpt.html
+
+// Pointer encodings used by .eh_frame and .eh_frame_hdr
+enum EHPointerEncoding
+{
+	DW_EH_PE_absptr = 0x00,
+	DW_EH_PE_uleb128 = 0x01,
+	DW_EH_PE_udata2 = 0x02,
+	DW_EH_PE_udata4 = 0x03,
+	DW_EH_PE_udata8 = 0x04,
+	DW_EH_PE_sleb128 = 0x09,
+	DW_EH_PE_sdata2 = 0x0a,
+	DW_EH_PE_sdata4 = 0x0b,
+	DW_EH_PE_sdata8 = 0x0c,
+
+	// Applied to the value read using one of the formats above
+	DW_EH_PE_pcrel = 0x10,
+	DW_EH_PE_datarel = 0x30,
+
+	DW_EH_PE_indirect = 0x80,
+	DW_EH_PE_omit = 0xff
+};
+
+// Where a section is in the file and in memory
+struct FileSection
+{
+	uint64_t address {};
+	uint64_t offset {};
+	uint64_t size {};
+};
+
+class EHFrameReader
+// Reads the range of every function described by a frame description entry (FDE)
+{
+public:
+	EHFrameReader(const std::vector<byte> * binDump, int addressSize, FileSection frame);
+
+	// Uses the sorted search table in .eh_frame_hdr to locate the FDEs
+	std::vector<AddressRange> ReadWithHeader(FileSection hdr);
+	// Walks every entry in .eh_frame, for images without a header
+	std::vector<AddressRange> ReadAll();
+
+private:
+	const std::vector<byte> * binDump;
+	int addressSize;
+	FileSection frame;
+	std::unordered_map<uint64_t, int> cieEncodings {}; // FDE pointer encoding of each parsed CIE
+
+	// Returns false if the entry at the offset is a CIE or can't be read
+	bool ReadFDE(uint64_t offset, AddressRange &range);
+	int ReadCIEEncoding(uint64_t offset);
+
+	bool InFrame(uint64_t offset, uint64_t size);
+	uint64_t ReadEncoded(ByteSequence &bs, int encoding, uint64_t sectionAddress, uint64_t sectionOffset, uint64_t dataRel);
+	static uint64_t ReadULEB128(ByteSequence &bs);
+	static int64_t ReadSLEB128(ByteSequence &bs);
+};
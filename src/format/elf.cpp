@@ -2,14 +2,16 @@
 #include <algorithm>
 
 #include "elf.h"
+#include "dwarf.h"
 
 // ***** FormatELF *****
 
 bool FormatELF::IsFormat(const std::vector<byte> * binDump)
 {
-	auto bd = *binDump;
+	auto &bd = *binDump;
 
-	if(bd[0] == 0x7f
+	if(bd.size() >= 4
+	&& bd[0] == 0x7f
 	&& bd[1] == 0x45
 	&& bd[2] == 0x4c
 	&& bd[3] == 0x46)
@@ -81,10 +83,15 @@ std::array<byte, EI_NIDENT> FormatELF::LoadIdent(const std::vector<byte> * binDu
 // Load identification values, which provide necessary information
 // to load the rest of the header/file 
 {
+	if (binDump->size() < EI_NIDENT)
+	{
+		throw std::runtime_error("File is too small to be an ELF file");
+	}
+
 	auto ident = std::array<byte, EI_NIDENT>();
 	for (int i = 0; i < EI_NIDENT; i++)  
 	{
-		ident[i] = binDump->at(i);
+		ident[i] = (*binDump)[i];
 	}
 
 	return ident;
@@ -100,18 +107,98 @@ Segment FormatELF::GetCodeSegment()
 		std::string name = LoadStringTableEntry(sstOff, sh.sh_name);
 		if (std::find(id.begin(), id.end(), name) != id.end())
 		{
-			auto begin = binDump->begin() + sh.sh_offset;
-			auto end = begin + sh.sh_size;
-			auto sectionCode = std::vector<byte>(begin, end);
-			segment.seg->insert({name, sectionCode});
+			segment.Insert(name, sh.sh_addr, FileBytes(sh.sh_offset, sh.sh_size));
 		}
 	}
 
 	return segment;
 }
 
+Segment FormatELF::GetDataSegment()
+{
+	Segment segment {};
+	const std::vector<std::string> id = {".rodata", ".data"};
+
+	auto sstOff = sectionHeaders[elfHeader.e_shstrndx].sh_offset; // Section name string table
+	for (auto sh : sectionHeaders)
+	{
+		std::string name = LoadStringTableEntry(sstOff, sh.sh_name);
+		if (std::find(id.begin(), id.end(), name) != id.end() && sh.sh_type != SHT_NOBITS)
+		{
+			segment.Insert(name, sh.sh_addr, FileBytes(sh.sh_offset, sh.sh_size));
+		}
+	}
+
+	return segment;
+}
+
+std::vector<AddressRange> FormatELF::GetFunctionRanges()
+// Every function that can be unwound through has an FDE in .eh_frame, which gives its exact range
+{
+	auto frameHeader = FindSectionHeader(".eh_frame");
+	if (frameHeader == nullptr)
+	{
+		return std::vector<AddressRange>();
+	}
+
+	int addressSize = (elfHeader.e_ident[EI_CLASS] == ELFCLASS64) ? 8 : 4;
+	EHFrameReader reader(binDump, addressSize, {frameHeader->sh_addr, frameHeader->sh_offset, frameHeader->sh_size});
+
+	auto hdrHeader = FindSectionHeader(".eh_frame_hdr");
+	if (hdrHeader != nullptr)
+	{
+		auto ranges = reader.ReadWithHeader({hdrHeader->sh_addr, hdrHeader->sh_offset, hdrHeader->sh_size});
+		if (!ranges.empty())
+		{
+			return ranges;
+		}
+	}
+
+	return reader.ReadAll();
+}
+
+std::vector<SectionRange> FormatELF::GetMappedSections()
+{
+	std::vector<SectionRange> sections {};
+
+	auto sstOff = sectionHeaders[elfHeader.e_shstrndx].sh_offset; // Section name string table
+	for (auto &sh : sectionHeaders)
+	{
+		if ((sh.sh_flags & SHF_ALLOC) && sh.sh_addr != 0 && sh.sh_size > 0)
+		{
+			sections.push_back({{sh.sh_addr, sh.sh_addr + sh.sh_size}, LoadStringTableEntry(sstOff, sh.sh_name)});
+		}
+	}
+
+	std::sort(sections.begin(), sections.end(), [](const SectionRange &a, const SectionRange &b)
+	{
+		return a.range.begin < b.range.begin;
+	});
+
+	return sections;
+}
+
+const Elf64_Shdr * FormatELF::FindSectionHeader(std::string name)
+{
+	auto sstOff = sectionHeaders[elfHeader.e_shstrndx].sh_offset; // Section name string table
+	for (auto &sh : sectionHeaders)
+	{
+		if (sh.sh_type != SHT_NOBITS && LoadStringTableEntry(sstOff, sh.sh_name) == name)
+		{
+			return &sh;
+		}
+	}
+
+	return nullptr;
+}
+
 std::string FormatELF::LoadStringTableEntry(unsigned long strTabOff, unsigned long entryOff)
 {
+	if (strTabOff > binDump->size() || entryOff > binDump->size() - strTabOff)
+	{
+		throw std::runtime_error("String table entry is outside the file");
+	}
+
 	auto begin = binDump->begin() + strTabOff + entryOff; // Beginning of entry/C string
 	auto end = std::find(begin, binDump->end(), '\0'); // End of the C string (null term)
 
@@ -120,11 +207,57 @@ std::string FormatELF::LoadStringTableEntry(unsigned long strTabOff, unsigned lo
 	return entry;
 }
 
+std::vector<Symbol> FormatELF::GetSymbols()
+{
+	return symbols;
+}
+
 void FormatELF::ParseBinDump() 
 {
 	LoadELFHeader();
 	LoadProgramHeaders();
 	LoadSectionHeaders();
+
+	if (elfHeader.e_shstrndx >= sectionHeaders.size())
+	{
+		throw std::runtime_error("Section name string table index is out of range");
+	}
+
+	LoadSymbols();
+}
+
+const Elf64_Shdr & FormatELF::LinkedSection(const Elf64_Shdr &sh)
+{
+	if (sh.sh_link >= sectionHeaders.size())
+	{
+		throw std::runtime_error("Section link is out of range");
+	}
+
+	return sectionHeaders[sh.sh_link];
+}
+
+void FormatELF::LoadSymbols()
+// Collects function symbols from both the static and dynamic symbol tables, if present
+{
+	for (auto sh : sectionHeaders)
+	{
+		if ((sh.sh_type == SHT_SYMTAB || sh.sh_type == SHT_DYNSYM) && sh.sh_entsize > 0)
+		{
+			LoadSymbolTable(sh);
+		}
+	}
+
+	std::sort(symbols.begin(), symbols.end(), [](const Symbol &a, const Symbol &b)
+	{
+		return a.address < b.address || (a.address == b.address && a.name < b.name);
+	});
+
+	// The same function usually appears in both .symtab and .dynsym
+	auto last = std::unique(symbols.begin(), symbols.end(), [](const Symbol &a, const Symbol &b)
+	{
+		return a.address == b.address && a.name == b.name;
+	});
+	symbols.erase(last, symbols.end());
 }
  
 // ***** FormatELF32 *****
@@ -210,6 +343,31 @@ void FormatELF32::LoadSectionHeaders()
 	}
 }
 
+void FormatELF32::LoadSymbolTable(const Elf64_Shdr &symTab)
+{
+	ByteSequence bs(binDump, symTab.sh_offset);
+	auto strTabOff = LinkedSection(symTab).sh_offset;
+
+	for (unsigned long i = 0; i < symTab.sh_size / symTab.sh_entsize; i++)
+	{
+		bs.offset = symTab.sh_offset + i * symTab.sh_entsize;
+
+		auto sym = Elf64_Sym();
+
+		sym.st_name = bs.ReadBytes<Elf32_Word>();
+		sym.st_value = bs.ReadBytes<Elf32_Addr>();
+		sym.st_size = bs.ReadBytes<Elf32_Word>();
+		sym.st_info = bs.ReadBytes<unsigned char>();
+		sym.st_other = bs.ReadBytes<unsigned char>();
+		sym.st_shndx = bs.ReadBytes<Elf32_Half>();
+
+		if (ELF64_ST_TYPE(sym.st_info) == STT_FUNC && sym.st_value != 0)
+		{
+			symbols.push_back({LoadStringTableEntry(strTabOff, sym.st_name), sym.st_value, sym.st_size});
+		}
+	}
+}
+
 // ***** FormatELF64 *****
 
 FormatELF64::FormatELF64(const std::vector<byte> * binDump)
@@ -294,3 +452,27 @@ void FormatELF64::LoadSectionHeaders()
 	}
 }
 
+void FormatELF64::LoadSymbolTable(const Elf64_Shdr &symTab)
+{
+	ByteSequence bs(binDump, symTab.sh_offset);
+	auto strTabOff = LinkedSection(symTab).sh_offset;
+
+	for (unsigned long i = 0; i < symTab.sh_size / symTab.sh_entsize; i++)
+	{
+		bs.offset = symTab.sh_offset + i * symTab.sh_entsize;
+
+		auto sym = Elf64_Sym();
+
+		sym.st_name = bs.ReadBytes<Elf64_Word>();
+		sym.st_info = bs.ReadBytes<unsigned char>();
+		sym.st_other = bs.ReadBytes<unsigned char>();
+		sym.st_shndx = bs.ReadBytes<Elf64_Half>();
+		sym.st_value = bs.ReadBytes<Elf64_Addr>();
+		sym.st_size = bs.ReadBytes<Elf64_Xword>();
+
+		if (ELF64_ST_TYPE(sym.st_info) == STT_FUNC && sym.st_value != 0)
+		{
+			symbols.push_back({LoadStringTableEntry(strTabOff, sym.st_name), sym.st_value, sym.st_size});
+		}
+	}
+}
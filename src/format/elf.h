@@ -18,6 +18,10 @@ public:
 	static bool IsFormat(const std::vector<byte> * binDump);
 	void LoadMetadata(Metadata &metadata);
 	Segment GetCodeSegment();
+	Segment GetDataSegment();
+	std::vector<Symbol> GetSymbols();
+	std::vector<AddressRange> GetFunctionRanges();
+	std::vector<SectionRange> GetMappedSections();
 protected:
 	// Using the 64-bit version of ELF structs because they work for both architectures
 	// and allow for code reuse through inheritance, keep this in mind before using
@@ -25,6 +29,7 @@ protected:
 	Elf64_Ehdr elfHeader;
 	std::vector<Elf64_Phdr> programHeaders;
 	std::vector<Elf64_Shdr> sectionHeaders;
+	std::vector<Symbol> symbols;
 
 	Elf64_Shdr secStrTabHeader;
 	std::vector<byte> secStrTabData;
@@ -32,11 +37,16 @@ protected:
 	static std::array<byte, EI_NIDENT> LoadIdent(const std::vector<byte> * binDump);
 
 	std::string LoadStringTableEntry(unsigned long strTabOff, unsigned long entryOff);
+	const Elf64_Shdr * FindSectionHeader(std::string name);
+	// The section named by sh_link, such as the string table of a symbol table
+	const Elf64_Shdr & LinkedSection(const Elf64_Shdr &sh);
 
 	void ParseBinDump();
 	virtual void LoadELFHeader() = 0;
 	virtual void LoadProgramHeaders() = 0;
 	virtual void LoadSectionHeaders() = 0;
+	void LoadSymbols();
+	virtual void LoadSymbolTable(const Elf64_Shdr &symTab) = 0;
 };
 
 class FormatELF32 final : public FormatELF
@@ -48,6 +58,7 @@ private:
 	void LoadELFHeader();
 	void LoadProgramHeaders();
 	void LoadSectionHeaders();
+	void LoadSymbolTable(const Elf64_Shdr &symTab);
 };
 
 class FormatELF64 final : public FormatELF
@@ -59,4 +70,5 @@ private:
 	void LoadELFHeader();
 	void LoadProgramHeaders();
 	void LoadSectionHeaders();
+	void LoadSymbolTable(const Elf64_Shdr &symTab);
 };
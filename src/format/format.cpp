@@ -1,10 +1,12 @@
 #include <array>
+#include <algorithm>
 #include <stdexcept>
-#include <iostream>
 
 #include "format.h"
 #include "elf.h"
 #include "pe.h"
+#include "../util/trace.h"
+#include "../util/alloc.h"
 
 FormatType Format::GetFormatType(const std::vector<byte> * binPeek)
 {
@@ -23,6 +25,8 @@ FormatType Format::GetFormatType(const std::vector<byte> * binPeek)
 
 std::unique_ptr<Format> Format::NewFormat(const std::vector<byte> * binDump, FormatType type)
 {
+	TRACE_SPAN("Format::NewFormat");
+	ALLOC_STAGE(FORMAT);
 	switch (type)
 	{
 		case (FormatType::ELF):
@@ -32,7 +36,52 @@ std::unique_ptr<Format> Format::NewFormat(const std::vector<byte> * binDump, For
 			return std::make_unique<FormatPE>(binDump);
 			break;
 		default:
-			std::cout << "File format not supported, program will exit...";
-			exit(EXIT_FAILURE);
+			throw std::runtime_error("File format not supported");
 	}
 }
+
+std::vector<byte> Format::FileBytes(uint64_t offset, uint64_t size) const
+{
+	if (offset > binDump->size() || size > binDump->size() - offset)
+	{
+		throw std::runtime_error("Section data runs past the end of the file");
+	}
+
+	return std::vector<byte>(binDump->begin() + offset, binDump->begin() + offset + size);
+}
+
+void Segment::Insert(std::string name, uint64_t address, std::vector<byte> data)
+{
+	SectionRange section {{address, address + data.size()}, name};
+
+	auto pos = std::upper_bound(index->begin(), index->end(), section, [](const SectionRange &a, const SectionRange &b)
+	{
+		return a.range.begin < b.range.begin;
+	});
+
+	index->insert(pos, section);
+	addr->insert({name, address});
+	seg->insert({name, std::move(data)});
+}
+
+const SectionRange * Segment::FindSection(uint64_t address) const
+{
+	// Find the last section starting at or before the address
+	auto pos = std::upper_bound(index->begin(), index->end(), address, [](uint64_t a, const SectionRange &s)
+	{
+		return a < s.range.begin;
+	});
+
+	if (pos == index->begin())
+	{
+		return nullptr;
+	}
+
+	pos--;
+	if (pos->range.Contains(address))
+	{
+		return &(*pos);
+	}
+
+	return nullptr;
+}
@@ -4,14 +4,41 @@
 #include <map>
 #include <memory>
 #include <map>
+#include <stdexcept>
 
 #include "../util/common.h"
 
+// Location of a section in the virtual address space of the image
+struct SectionRange
+{
+	AddressRange range {};
+	std::string name {};
+};
+
 struct Segment
 {
 	std::map<std::string, std::vector<byte>> * seg {};
+	std::map<std::string, uint64_t> * addr {}; // Virtual address of each section
+	std::vector<SectionRange> * index {}; // Sorted by address, used for address lookups
+
+	Segment()
+	{
+		seg = new std::map<std::string, std::vector<byte>>();
+		addr = new std::map<std::string, uint64_t>();
+		index = new std::vector<SectionRange>();
+	}
 
-	Segment() {seg = new std::map<std::string, std::vector<byte>>();}
+	void Insert(std::string name, uint64_t address, std::vector<byte> data);
+
+	// Returns the section containing the address, or nullptr if it isn't mapped
+	const SectionRange * FindSection(uint64_t address) const;
+};
+
+struct Symbol
+{
+	std::string name {};
+	uint64_t address {};
+	uint64_t size {};
 };
 
 class Format
@@ -23,11 +50,21 @@ public:
 
 	virtual void LoadMetadata(Metadata &metadata) = 0;
 	virtual Segment GetCodeSegment() = 0;
+	// Initialised, read-only and writable data
+	virtual Segment GetDataSegment() = 0;
+	// Function symbols sorted by address
+	virtual std::vector<Symbol> GetSymbols() = 0;
+	// Function ranges described by unwind metadata, sorted by address
+	virtual std::vector<AddressRange> GetFunctionRanges() = 0;
+	// Every section that is loaded into memory, code or data, sorted by address
+	virtual std::vector<SectionRange> GetMappedSections() = 0;
 
 protected:
 	const std::vector<byte> * binDump;
 
 	virtual void ParseBinDump() = 0;
+	// A copy of part of the file, throwing if it runs past the end
+	std::vector<byte> FileBytes(uint64_t offset, uint64_t size) const;
 };
 
 class FormatException : std::runtime_error 
@@ -1,5 +1,6 @@
 #include <memory>
-#include <iostream>
+#include <stdexcept>
+#include <algorithm>
 
 #include "pe.h"
 #include "../util/util.h"
@@ -22,6 +23,20 @@ enum Machine
 	IMAGE_FILE_MACHINE_IA64 = 0x200
 };
 
+enum OptionalHeaderMagic
+{
+	PE32_MAGIC = 0x10b,
+	PE32_PLUS_MAGIC = 0x20b
+};
+
+enum DataDirectoryIndex
+{
+	IMAGE_DIRECTORY_ENTRY_EXPORT = 0,
+	IMAGE_DIRECTORY_ENTRY_IMPORT = 1,
+	IMAGE_DIRECTORY_ENTRY_RESOURCE = 2,
+	IMAGE_DIRECTORY_ENTRY_EXCEPTION = 3
+};
+
 enum SectionHeaderCharacteristicFlags
 {
 	IS_EXECUTABLE_CODE  = 0x0020
@@ -30,9 +45,10 @@ enum SectionHeaderCharacteristicFlags
 
 bool FormatPE::IsFormat(const std::vector<byte> * binDump)
 {
-	auto bd = *binDump;
+	auto &bd = *binDump;
 
-	if(bd[0] == 0x4d
+	if(bd.size() >= 2
+	&& bd[0] == 0x4d
 	&& bd[1] == 0x5a)
 	{
 		return true;
@@ -74,16 +90,110 @@ Segment FormatPE::GetCodeSegment()
 	{
 		if (sh.characteristicFlags & IS_EXECUTABLE_CODE)
 		{
-			auto begin = binDump->begin() + sh.rawDataPointer;
-			auto end = begin + sh.virtualSize; // Use virtualSize instead of rawSize because it doesn't have padding
-			auto sectionCode = std::vector<byte>(begin, end);
-			seg.seg->insert({sh.name, sectionCode});
+			// Use virtualSize instead of rawSize because it doesn't have padding
+			seg.Insert(sh.name, optionalHeader.imageBase + sh.virtualAddress, FileBytes(sh.rawDataPointer, sh.virtualSize));
+		}
+	}
+
+	return seg;
+}
+
+Segment FormatPE::GetDataSegment()
+{
+	Segment seg {};
+	const std::vector<std::string> id = {".rdata", ".data"};
+
+	for (auto sh : sectionHeaders)
+	{
+		if (std::find(id.begin(), id.end(), sh.name) != id.end())
+		{
+			// Only the raw data is in the file, the rest of a larger virtual size is zero filled
+			auto size = std::min(sh.virtualSize, sh.rawSize);
+			seg.Insert(sh.name, optionalHeader.imageBase + sh.virtualAddress, FileBytes(sh.rawDataPointer, size));
 		}
 	}
 
 	return seg;
 }
 
+std::vector<Symbol> FormatPE::GetSymbols()
+{
+	// Images rarely carry a COFF symbol table, and export parsing isn't implemented yet
+	return std::vector<Symbol>();
+}
+
+std::vector<AddressRange> FormatPE::GetFunctionRanges()
+// The exception directory (.pdata) is a flat array of RUNTIME_FUNCTION entries sorted by address,
+// which only x64 and ARM images have
+{
+	std::vector<AddressRange> ranges {};
+
+	auto &dirs = optionalHeader.dataDirectories;
+	if (dirs.size() <= IMAGE_DIRECTORY_ENTRY_EXCEPTION || dirs[IMAGE_DIRECTORY_ENTRY_EXCEPTION].size == 0)
+	{
+		return ranges;
+	}
+
+	auto &dir = dirs[IMAGE_DIRECTORY_ENTRY_EXCEPTION];
+	long long offset = RVAToFileOffset(dir.virtualAddress);
+	if (offset < 0 || static_cast<unsigned long long>(offset) + dir.size > binDump->size())
+	{
+		return ranges;
+	}
+
+	const int runtimeFunctionSize = 12;
+	ByteSequence bs(binDump, offset);
+	for (uint32_t i = 0; i < dir.size / runtimeFunctionSize; i++)
+	{
+		uint32_t begin = bs.ReadBytes<uint32_t>();
+		uint32_t end = bs.ReadBytes<uint32_t>();
+		bs.ReadBytes<uint32_t>(); // Unwind info
+
+		if (end > begin)
+		{
+			ranges.push_back({optionalHeader.imageBase + begin, optionalHeader.imageBase + end});
+		}
+	}
+
+	std::sort(ranges.begin(), ranges.end(), [](const AddressRange &a, const AddressRange &b)
+	{
+		return a.begin < b.begin;
+	});
+
+	return ranges;
+}
+
+std::vector<SectionRange> FormatPE::GetMappedSections()
+{
+	std::vector<SectionRange> sections {};
+
+	for (auto &sh : sectionHeaders)
+	{
+		uint64_t begin = optionalHeader.imageBase + sh.virtualAddress;
+		sections.push_back({{begin, begin + sh.virtualSize}, sh.name});
+	}
+
+	std::sort(sections.begin(), sections.end(), [](const SectionRange &a, const SectionRange &b)
+	{
+		return a.range.begin < b.range.begin;
+	});
+
+	return sections;
+}
+
+long long FormatPE::RVAToFileOffset(uint32_t rva)
+{
+	for (auto &sh : sectionHeaders)
+	{
+		if (rva >= sh.virtualAddress && rva < sh.virtualAddress + sh.rawSize)
+		{
+			return static_cast<long long>(sh.rawDataPointer) + (rva - sh.virtualAddress);
+		}
+	}
+
+	return -1;
+}
+
 void FormatPE::ParseBinDump()
 {
 	int offset = LoadCOFFHeader();
@@ -94,7 +204,7 @@ int FormatPE::LoadCOFFHeader()
 {
 	// Get the location of the offset to the COFF header, skipping the DOS stub/header
 	// Add four to skip the second magic number, which I'm not sure why exists
-	int offset = static_cast<int>(binDump->at(0x3C)) + 4;
+	int offset = static_cast<int>(ByteSequence(binDump, 0x3C).ReadBytes<byte>()) + 4;
 
 	ByteSequence bs(binDump, offset);
 
@@ -108,14 +218,58 @@ int FormatPE::LoadCOFFHeader()
 
 	if (coffHeader.optionalHeaderSize > 0)
 	{
-		// Skip the optional header
+		LoadOptionalHeader(bs.offset);
+
+		// Skip the rest of the optional header
 		return bs.offset + coffHeader.optionalHeaderSize;
 	}
 
 	else
 	{
-		std::cout << "ERROR: File provided is not a valid executable (potentially an object file?) Program will exit." << '\n';
-		exit(EXIT_FAILURE);
+		throw std::runtime_error("File provided is not a valid executable (potentially an object file?)");
+	}
+}
+
+void FormatPE::LoadOptionalHeader(int offset)
+{
+	ByteSequence bs(binDump, offset);
+
+	optionalHeader.magic = bs.ReadBytes<uint16_t>();
+
+	int directoriesOffset = 0;
+	if (optionalHeader.magic == PE32_MAGIC)
+	{
+		bs.offset = offset + 28;
+		optionalHeader.imageBase = bs.ReadBytes<uint32_t>();
+		directoriesOffset = offset + 92;
+	}
+
+	else if (optionalHeader.magic == PE32_PLUS_MAGIC)
+	{
+		// PE32+ drops the BaseOfData field and widens ImageBase and the stack/heap sizes to eight bytes
+		bs.offset = offset + 24;
+		optionalHeader.imageBase = bs.ReadBytes<uint64_t>();
+		directoriesOffset = offset + 108;
+	}
+
+	else
+	{
+		return;
+	}
+
+	if (directoriesOffset + 4 > coffHeader.optionalHeaderSize + offset)
+	{
+		return;
+	}
+
+	bs.offset = directoriesOffset;
+	uint32_t numDirectories = bs.ReadBytes<uint32_t>();
+	for (uint32_t i = 0; i < numDirectories && bs.offset + 8 <= static_cast<unsigned long>(offset + coffHeader.optionalHeaderSize); i++)
+	{
+		DataDirectory dir {};
+		dir.virtualAddress = bs.ReadBytes<uint32_t>();
+		dir.size = bs.ReadBytes<uint32_t>();
+		optionalHeader.dataDirectories.push_back(dir);
 	}
 }
 
@@ -19,6 +19,19 @@ struct COFFHeader
 	uint16_t characteristicFlags;
 };
 
+struct DataDirectory
+{
+	uint32_t virtualAddress;
+	uint32_t size;
+};
+
+struct OptionalHeader
+{
+	uint16_t magic; // 0x10b for PE32, 0x20b for PE32+
+	uint64_t imageBase;
+	std::vector<DataDirectory> dataDirectories;
+};
+
 struct SectionHeader
 {
 	std::string name;
@@ -41,11 +54,19 @@ public:
 	FormatPE(const std::vector<byte> * binDump);
 	void LoadMetadata(Metadata &metadata);
 	Segment GetCodeSegment();
+	Segment GetDataSegment();
+	std::vector<Symbol> GetSymbols();
+	std::vector<AddressRange> GetFunctionRanges();
+	std::vector<SectionRange> GetMappedSections();
 private:
 	COFFHeader coffHeader {};
+	OptionalHeader optionalHeader {};
 	std::vector<SectionHeader> sectionHeaders {};
 
 	void ParseBinDump();
 	int LoadCOFFHeader();
+	void LoadOptionalHeader(int offset);
 	void LoadSectionHeaders(int offset);
+	// Returns -1 if the address isn't backed by any section's raw data
+	long long RVAToFileOffset(uint32_t rva);
 };
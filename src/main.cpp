@@ -5,6 +5,8 @@
 
 #include "util/common.h"
 #include "exec.h"
+#include "util/trace.h"
+#include "util/alloc.h"
 
 class ProcessInstance 
 {
@@ -12,15 +14,87 @@ public:
 	ProcessInstance(std::string path)
 	{
 		this->exec = new Executable(path);
+		this->exec->Run();
 	}
 
 private:
 	Executable * exec;
 };
 
+AddressRange ParseRange(std::string value)
+// Ranges are given as "begin:end", either of which may be written in hex with a 0x prefix
+{
+	auto sep = value.find(':');
+	if (sep == std::string::npos)
+	{
+		std::cout << "ERROR: Address ranges must be given as begin:end." << '\n';
+		exit(EXIT_FAILURE);
+	}
+
+	AddressRange range {};
+	try
+	{
+		range.begin = std::stoull(value.substr(0, sep), nullptr, 0);
+		range.end = std::stoull(value.substr(sep + 1), nullptr, 0);
+	}
+	catch (const std::exception &e)
+	{
+		std::cout << "ERROR: Invalid address in range '" << value << "'." << '\n';
+		exit(EXIT_FAILURE);
+	}
+
+	if (range.Empty())
+	{
+		std::cout << "ERROR: Address range is empty." << '\n';
+		exit(EXIT_FAILURE);
+	}
+
+	return range;
+}
+
+uint64_t ParseAddress(std::string value)
+{
+	try
+	{
+		return std::stoull(value, nullptr, 0);
+	}
+	catch (const std::exception &e)
+	{
+		std::cout << "ERROR: Invalid address '" << value << "'." << '\n';
+		exit(EXIT_FAILURE);
+	}
+}
+
+unsigned int ParseDepth(std::string value)
+{
+	// Deeper gadgets are of no use, and the search back from each terminator grows with the depth
+	const unsigned long MAX_GADGET_DEPTH = 64;
+
+	std::size_t end = 0;
+	unsigned long depth = 0;
+	try
+	{
+		depth = std::stoul(value, &end, 10);
+	}
+	catch (const std::exception &e)
+	{
+		end = 0;
+	}
+
+	if (end == 0 || end != value.size() || value[0] == '-' || depth < 1 || depth > MAX_GADGET_DEPTH)
+	{
+		std::cout << "ERROR: Gadget depth must be a whole number from 1 to " << MAX_GADGET_DEPTH << ", not '" << value << "'." << '\n';
+		exit(EXIT_FAILURE);
+	}
+
+	return depth;
+}
+
 void ParseFlags(int argc, const char * argv[])
 {
-	const std::vector<std::string> validFlags = {"-d"};
+	const std::vector<std::string> validFlags = {"-d", "--strings", "--stats", "--skip-library", "--recursive", "--liveness", "--source", "--perf"};
+	// Flags that take a value in the form --flag=value
+	const std::vector<std::string> validValueFlags = {"--range", "--symbol", "--xref", "--search", "--signatures", "--diff", "--index-add", "--index-query", "--gadgets", "--trace"};
 
 	// No path or other arguments supplied
 	if (argc == 1)
@@ -36,26 +110,176 @@ void ParseFlags(int argc, const char * argv[])
 		for (int i = 1; i < argc - 1; i++)
 		{
 			std::string arg(argv[i]);
+			std::string value {};
+
+			auto sep = arg.find('=');
+			if (sep != std::string::npos)
+			{
+				value = arg.substr(sep + 1);
+				arg = arg.substr(0, sep);
+			}
+
 			// If invalid argument
-			if (std::find(validFlags.begin(), validFlags.end(), arg) == validFlags.end())	
+			if (std::find(validFlags.begin(), validFlags.end(), arg) == validFlags.end()
+			&& std::find(validValueFlags.begin(), validValueFlags.end(), arg) == validValueFlags.end())
 			{
 				std::cout << "ERROR: Invalid arguments supplied." << '\n';
 				exit(EXIT_FAILURE);
 			}
 
-			// Debug mode (to be implemented)
+			// Print the decoder counters (builds configured with DISASM_COUNTERS)
 			else if (arg == "-d")
 			{
 				processFlags.debug = true;
 			}
+
+			// List strings found in the data sections
+			else if (arg == "--strings")
+			{
+				processFlags.strings = true;
+			}
+
+			// Count the decoded instructions
+			else if (arg == "--stats")
+			{
+				processFlags.stats = true;
+			}
+
+			// Solve register liveness for each function
+			else if (arg == "--liveness")
+			{
+				processFlags.liveness = true;
+			}
+
+			// Print pseudo-C lifted from each function
+			else if (arg == "--source")
+			{
+				processFlags.source = true;
+			}
+
+			// Read hardware counters around the decode and format stages
+			else if (arg == "--perf")
+			{
+				processFlags.perf = true;
+			}
+
+			// Only decode what is reachable from the function starts
+			else if (arg == "--recursive")
+			{
+				processFlags.recursive = true;
+			}
+
+			// Only disassemble the given span of virtual addresses
+			else if (arg == "--range")
+			{
+				processFlags.range = ParseRange(value);
+			}
+
+			// Only disassemble the given function
+			else if (arg == "--symbol")
+			{
+				if (value.empty())
+				{
+					std::cout << "ERROR: No symbol name given." << '\n';
+					exit(EXIT_FAILURE);
+				}
+
+				processFlags.symbol = value;
+			}
+
+			// Only list cross references of the given address
+			else if (arg == "--xref")
+			{
+				processFlags.xref = true;
+				processFlags.xrefAddress = ParseAddress(value);
+			}
+
+			// Search for the signatures in the given file
+			else if (arg == "--search")
+			{
+				processFlags.searchPath = value;
+			}
+
+			// Recognise library functions with the given pattern file
+			else if (arg == "--signatures")
+			{
+				processFlags.signaturePath = value;
+			}
+
+			else if (arg == "--skip-library")
+			{
+				processFlags.skipLibrary = true;
+			}
+
+			// Compare functions with an older build of the executable
+			else if (arg == "--diff")
+			{
+				processFlags.diffPath = value;
+			}
+
+			// Add the functions to a similarity index
+			else if (arg == "--index-add")
+			{
+				processFlags.indexAddPath = value;
+			}
+
+			// List return and indirect branch gadgets
+			else if (arg == "--gadgets")
+			{
+				processFlags.gadgetDepth = ParseDepth(value);
+			}
+
+			// Find functions like these in a similarity index
+			else if (arg == "--index-query")
+			{
+				processFlags.indexQueryPath = value;
+			}
+
+			// Time the pipeline stages
+			else if (arg == "--trace")
+			{
+				processFlags.tracePath = value;
+			}
 		}
 	}
 
+	// Both select what to disassemble, so only one may be given
+	if (!processFlags.symbol.empty() && !processFlags.range.Empty())
+	{
+		std::cout << "ERROR: --symbol and --range can't be used together." << '\n';
+		exit(EXIT_FAILURE);
+	}
 }
 
 int main(int argc, const char * argv[])
 {
 	ParseFlags(argc, argv);
 
+	if (!processFlags.tracePath.empty())
+	{
+		Trace::Enable();
+	}
+
 	auto process = ProcessInstance(std::string(argv[argc-1]));
+
+	if (!processFlags.tracePath.empty())
+	{
+		try
+		{
+			Trace::Write(processFlags.tracePath);
+		}
+		catch (const std::exception &e)
+		{
+			std::cout << "ERROR: " << e.what() << "." << '\n';
+			exit(EXIT_FAILURE);
+		}
+	}
+
+#ifdef DISASM_ALLOC_PROFILE
+	// Kept apart from the listing on stdout
+	for (auto &line : Alloc::Report())
+	{
+		std::cerr << line << '\n';
+	}
+#endif
 }	
@@ -0,0 +1,237 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <iomanip>
+#include <new>
+#include <sstream>
+
+#include "alloc.h"
+
+namespace Alloc
+{
+
+namespace
+{
+
+const char * STAGE_NAMES[] = {"other", "load", "format", "reference", "decode", "translate"};
+
+// Atomics with constant initialisers, so they are ready before the first static constructor allocates
+struct StageTotals
+{
+	std::atomic<uint64_t> allocations {0};
+	std::atomic<uint64_t> bytes {0};
+	std::atomic<uint64_t> live {0};
+	std::atomic<uint64_t> peak {0};
+};
+
+StageTotals stages[static_cast<int>(Stage::COUNT)] {};
+StageTotals total {};
+std::atomic<uint64_t> instructions {0};
+
+thread_local Stage current = Stage::OTHER;
+
+Counts Read(const StageTotals &totals)
+{
+	Counts counts {};
+	counts.allocations = totals.allocations.load(std::memory_order_relaxed);
+	counts.bytes = totals.bytes.load(std::memory_order_relaxed);
+	counts.peak = totals.peak.load(std::memory_order_relaxed);
+	return counts;
+}
+
+std::string Line(const std::string &name, const Counts &counts, uint64_t decoded)
+{
+	std::stringstream line {};
+	line << std::left << std::setw(12) << name << std::right << std::setw(14) << counts.allocations << std::setw(16) << counts.bytes << std::setw(16) << counts.peak;
+	if (decoded != 0)
+	{
+		line << std::fixed << std::setprecision(3) << std::setw(16) << static_cast<double>(counts.allocations) / decoded;
+	}
+	return line.str();
+}
+
+};
+
+bool Enabled()
+{
+#ifdef DISASM_ALLOC_PROFILE
+	return true;
+#else
+	return false;
+#endif
+}
+
+Counts StageCounts(Stage stage)
+{
+	return Read(stages[static_cast<int>(stage)]);
+}
+
+Counts Totals()
+{
+	return Read(total);
+}
+
+void ResetPeaks()
+{
+	for (auto &stage : stages)
+	{
+		stage.peak.store(stage.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+	total.peak.store(total.live.load(std::memory_order_relaxed), std::memory_order_relaxed);
+}
+
+void AddInstructions(uint64_t count)
+{
+	instructions.fetch_add(count, std::memory_order_relaxed);
+}
+
+std::vector<std::string> Report()
+{
+	uint64_t decoded = instructions.load(std::memory_order_relaxed);
+
+	std::vector<std::string> lines {};
+	lines.push_back("Allocations by stage, over " + std::to_string(decoded) + " decoded instructions");
+
+	std::stringstream header {};
+	header << std::left << std::setw(12) << "stage" << std::right << std::setw(14) << "allocations" << std::setw(16) << "bytes" << std::setw(16) << "peak bytes";
+	if (decoded != 0)
+	{
+		header << std::setw(16) << "/instruction";
+	}
+	lines.push_back(header.str());
+
+	for (int i = 0; i < static_cast<int>(Stage::COUNT); i++)
+	{
+		lines.push_back(Line(STAGE_NAMES[i], Read(stages[i]), decoded));
+	}
+	lines.push_back(Line("total", Read(total), decoded));
+
+	return lines;
+}
+
+// ***** StageScope *****
+StageScope::StageScope(Stage stage)
+	: previous(current)
+{
+	current = stage;
+}
+
+StageScope::~StageScope()
+{
+	current = previous;
+}
+
+#ifdef DISASM_ALLOC_PROFILE
+namespace
+{
+
+// Put in front of every allocation, padded so the memory handed out keeps malloc's alignment
+struct alignas(std::max_align_t) Header
+{
+	std::size_t size;
+	Stage stage;
+};
+
+void RaisePeak(std::atomic<uint64_t> &peak, uint64_t live)
+{
+	uint64_t seen = peak.load(std::memory_order_relaxed);
+	while (live > seen && !peak.compare_exchange_weak(seen, live, std::memory_order_relaxed));
+}
+
+void Charge(StageTotals &totals, uint64_t size)
+{
+	totals.allocations.fetch_add(1, std::memory_order_relaxed);
+	totals.bytes.fetch_add(size, std::memory_order_relaxed);
+	RaisePeak(totals.peak, totals.live.fetch_add(size, std::memory_order_relaxed) + size);
+}
+
+void * Allocate(std::size_t size)
+{
+	Header * header = static_cast<Header *>(std::malloc(sizeof(Header) + size));
+	if (header == nullptr)
+	{
+		return nullptr;
+	}
+
+	header->size = size;
+	header->stage = current;
+	Charge(stages[static_cast<int>(current)], size);
+	Charge(total, size);
+	return header + 1;
+}
+
+void Free(void * p)
+{
+	if (p == nullptr)
+	{
+		return;
+	}
+
+	Header * header = static_cast<Header *>(p) - 1;
+	stages[static_cast<int>(header->stage)].live.fetch_sub(header->size, std::memory_order_relaxed);
+	total.live.fetch_sub(header->size, std::memory_order_relaxed);
+	std::free(header);
+}
+
+};
+#endif
+
+};
+
+#ifdef DISASM_ALLOC_PROFILE
+// Every form is replaced, so that no allocation or free skips the header
+void * operator new(std::size_t size)
+{
+	if (void * p = Alloc::Allocate(size))
+	{
+		return p;
+	}
+
+	throw std::bad_alloc();
+}
+
+void * operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+	return Alloc::Allocate(size);
+}
+
+void operator delete(void * p) noexcept
+{
+	Alloc::Free(p);
+}
+
+void operator delete(void * p, std::size_t) noexcept
+{
+	Alloc::Free(p);
+}
+
+void operator delete(void * p, const std::nothrow_t &) noexcept
+{
+	Alloc::Free(p);
+}
+
+void * operator new[](std::size_t size)
+{
+	return operator new(size);
+}
+
+void * operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+	return Alloc::Allocate(size);
+}
+
+void operator delete[](void * p) noexcept
+{
+	Alloc::Free(p);
+}
+
+void operator delete[](void * p, std::size_t) noexcept
+{
+	Alloc::Free(p);
+}
+
+void operator delete[](void * p, const std::nothrow_t &) noexcept
+{
+	Alloc::Free(p);
+}
+#endif
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Heap accounting by pipeline stage, only kept in builds configured with DISASM_ALLOC_PROFILE,
+// which replace the global operator new and delete. Each allocation is charged to the stage
+// of the thread that made it, and its free to that same stage
+
+namespace Alloc
+{
+
+enum class Stage : uint8_t
+{
+	OTHER, // Outside every marked stage, such as the analyses and printing
+	LOAD,
+	FORMAT,
+	REFERENCE,
+	DECODE,
+	TRANSLATE,
+	COUNT
+};
+
+struct Counts
+{
+	uint64_t allocations {};
+	uint64_t bytes {};
+	uint64_t peak {}; // Most bytes live at once
+};
+
+// Whether operator new is counted in this build
+bool Enabled();
+
+Counts StageCounts(Stage stage);
+Counts Totals();
+
+// Restarts the peaks at the bytes live now
+void ResetPeaks();
+
+// Instructions decoded so far, to rate the allocations by
+void AddInstructions(uint64_t count);
+
+// Listing of every stage's allocations, bytes and peak live bytes
+std::vector<std::string> Report();
+
+// Charges the allocations of the enclosing scope on this thread to a stage
+class StageScope
+{
+public:
+	explicit StageScope(Stage stage);
+	~StageScope();
+
+	StageScope(const StageScope &) = delete;
+	StageScope & operator=(const StageScope &) = delete;
+
+private:
+	Stage previous {};
+};
+
+};
+
+#ifdef DISASM_ALLOC_PROFILE
+#define ALLOC_STAGE(stage) Alloc::StageScope allocStage(Alloc::Stage::stage)
+#define ALLOC_INSTRUCTIONS(count) Alloc::AddInstructions(count)
+#else
+#define ALLOC_STAGE(stage) ((void)0)
+#define ALLOC_INSTRUCTIONS(count) ((void)0)
+#endif
@@ -0,0 +1,60 @@
+#include <cstdint>
+
+#include "arena.h"
+
+Arena::Arena(std::size_t blockSize)
+{
+	this->blockSize = blockSize;
+}
+
+void * Arena::Allocate(std::size_t size, std::size_t align)
+{
+	if (!blocks.empty())
+	{
+		auto &block = blocks.back();
+		auto base = reinterpret_cast<std::uintptr_t>(block.data.get());
+		std::size_t offset = ((base + used + align - 1) & ~(align - 1)) - base;
+
+		if (offset + size <= block.size)
+		{
+			usedTotal += (offset - used) + size;
+			used = offset + size;
+			return block.data.get() + offset;
+		}
+	}
+
+	// Doesn't fit, oversized requests get a block of their own
+	NewBlock(size + align);
+	return Allocate(size, align);
+}
+
+void Arena::Reset()
+{
+	if (blocks.size() > 1)
+	{
+		blocks.erase(blocks.begin() + 1, blocks.end());
+	}
+
+	reserved = blocks.empty() ? 0 : blocks.front().size;
+	used = 0;
+	usedTotal = 0;
+}
+
+std::size_t Arena::BytesUsed() const
+{
+	return usedTotal;
+}
+
+std::size_t Arena::BytesReserved() const
+{
+	return reserved;
+}
+
+void Arena::NewBlock(std::size_t minSize)
+{
+	std::size_t size = (minSize > blockSize) ? minSize : blockSize;
+
+	blocks.push_back({std::unique_ptr<byte[]>(new byte[size]), size});
+	reserved += size;
+	used = 0;
+}
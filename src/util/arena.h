@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <cstddef>
+#include <type_traits>
+#include <new>
+
+#include "common.h"
+
+class Arena
+// Bump allocator for data that is built once and released all at once, such as the
+// blocks of a control-flow graph. Nothing is freed individually, and destructors of
+// the objects placed in it are never run
+{
+public:
+	explicit Arena(std::size_t blockSize = 64 * 1024);
+	Arena(const Arena &) = delete;
+	Arena & operator=(const Arena &) = delete;
+
+	void * Allocate(std::size_t size, std::size_t align = alignof(std::max_align_t));
+
+	// Value-initialized array of count elements
+	template <typename T>
+	T * AllocateArray(std::size_t count)
+	{
+		static_assert(std::is_trivially_destructible<T>::value, "Arena objects are never destroyed");
+
+		T * array = static_cast<T *>(Allocate(sizeof(T) * count, alignof(T)));
+		for (std::size_t i = 0; i < count; i++)
+		{
+			new (&array[i]) T();
+		}
+
+		return array;
+	}
+
+	// Releases everything allocated so far, keeping the first block for reuse
+	void Reset();
+
+	std::size_t BytesUsed() const;
+	std::size_t BytesReserved() const;
+
+private:
+	struct Block
+	{
+		std::unique_ptr<byte[]> data;
+		std::size_t size;
+	};
+
+	std::vector<Block> blocks {};
+	std::size_t blockSize {};
+	std::size_t used {}; // Bytes used in the current (last) block
+	std::size_t usedTotal {};
+	std::size_t reserved {};
+
+	void NewBlock(std::size_t minSize);
+};
@@ -1,15 +1,44 @@
 #pragma once
 
 #include <string>
+#include <cstdint>
 
 using byte = unsigned char;
 const std::string DATA_PATH = "../data/";
 const int8_t INVALID = -127;
 
+// Half-open interval of virtual addresses [begin, end)
+struct AddressRange
+{
+	uint64_t begin {};
+	uint64_t end {};
+
+	bool Contains(uint64_t address) const { return address >= begin && address < end; }
+	bool Empty() const { return end <= begin; }
+};
+
 struct CLIFlags
 {
 	bool rawMachineCode {};
 	bool debug {};
+	std::string symbol {}; // Only disassemble the function with this name
+	AddressRange range {}; // Only disassemble this span of virtual addresses
+	bool xref {};
+	uint64_t xrefAddress {}; // List the references to and from this address instead of disassembling
+	bool strings {}; // List the strings in the data sections instead of disassembling
+	bool stats {}; // Print a JSON histogram of the decoded instructions instead of disassembling
+	std::string searchPath {}; // Signature file to search the image with instead of disassembling
+	std::string signaturePath {}; // Library function signatures (.pat) to recognise functions with
+	bool skipLibrary {}; // Leave recognised library functions out of the listing
+	std::string diffPath {}; // Older build to compare functions against instead of disassembling
+	std::string indexAddPath {}; // Similarity index to add the functions to
+	std::string indexQueryPath {}; // Similarity index to look the functions up in
+	unsigned int gadgetDepth {}; // List gadgets of up to this many instructions instead of disassembling
+	bool liveness {}; // List the live-in registers and dead register writes of each function instead of disassembling
+	bool source {}; // Print each function as pseudo-C instead of assembly
+	bool perf {}; // Report hardware counters for the decode and format stages
+	std::string tracePath {}; // Chrome trace-event JSON of the pipeline stages to write
+	bool recursive {}; // Follow control flow from the function starts instead of sweeping the section
 };
 
 extern CLIFlags processFlags;
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// Finaliser from splitmix64, spreads every input bit over the whole output
+inline uint64_t HashMix(uint64_t value)
+{
+	value ^= value >> 30;
+	value *= 0xBF58476D1CE4E5B9ULL;
+	value ^= value >> 27;
+	value *= 0x94D049BB133111EBULL;
+	value ^= value >> 31;
+	return value;
+}
+
+// Order dependent, so a sequence hashes differently from its permutations
+inline uint64_t HashCombine(uint64_t seed, uint64_t value)
+{
+	return HashMix(seed ^ (value + 0x9E3779B97F4A7C15ULL + (seed << 6) + (seed >> 2)));
+}
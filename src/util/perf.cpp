@@ -0,0 +1,181 @@
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "perf.h"
+
+namespace Perf
+{
+
+namespace
+{
+
+const char * COUNTER_NAMES[] = {"cycles", "instructions", "branch-misses", "cache-misses"};
+
+#ifdef __linux__
+const uint64_t COUNTER_CONFIGS[] = {PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+
+int OpenCounter(uint64_t config, int groupFd)
+{
+	perf_event_attr attr {};
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.disabled = (groupFd == -1); // Members follow the leader
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// This thread on any CPU
+	return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, groupFd, 0));
+}
+#endif
+
+};
+
+// ***** Group *****
+Group::Group()
+{
+#ifdef __linux__
+	leader = OpenCounter(COUNTER_CONFIGS[0], -1);
+	if (leader < 0)
+	{
+		error = std::string("perf_event_open failed: ") + std::strerror(errno);
+		return;
+	}
+	fds[0] = leader;
+
+	// A CPU or hypervisor without one of the other events still gets the rest counted
+	for (int i = 1; i < static_cast<int>(Counter::COUNT); i++)
+	{
+		fds[i] = OpenCounter(COUNTER_CONFIGS[i], leader);
+	}
+#else
+	error = "hardware counters are only read on Linux";
+#endif
+}
+
+Group::~Group()
+{
+#ifdef __linux__
+	for (int fd : fds)
+	{
+		if (fd >= 0)
+		{
+			close(fd);
+		}
+	}
+#endif
+}
+
+void Group::Start()
+{
+#ifdef __linux__
+	if (leader < 0)
+	{
+		return;
+	}
+
+	ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+	ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+}
+
+Sample Group::Stop()
+{
+	Sample sample {};
+#ifdef __linux__
+	if (leader < 0)
+	{
+		return sample;
+	}
+
+	ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+	// nr, time enabled, time running, then a value for each opened counter in the order they were opened
+	uint64_t buffer[3 + static_cast<int>(Counter::COUNT)] {};
+	if (read(leader, buffer, sizeof(buffer)) < static_cast<ssize_t>(3 * sizeof(uint64_t)))
+	{
+		return sample;
+	}
+
+	uint64_t enabled = buffer[1];
+	uint64_t running = buffer[2];
+	if (running == 0)
+	{
+		return sample;
+	}
+
+	sample.scaled = running < enabled;
+
+	uint64_t next = 0;
+	for (int i = 0; i < static_cast<int>(Counter::COUNT) && next < buffer[0]; i++)
+	{
+		if (fds[i] < 0)
+		{
+			continue;
+		}
+
+		uint64_t value = buffer[3 + next++];
+		sample.values[i] = sample.scaled ? static_cast<uint64_t>(static_cast<double>(value) * enabled / running) : value;
+		sample.counted[i] = true;
+	}
+#endif
+	return sample;
+}
+
+std::vector<std::string> Report(const std::string &stage, const Sample &sample, uint64_t bytes, uint64_t instructions)
+{
+	std::vector<std::string> lines {};
+	std::stringstream title {};
+	title << "Performance counters for " << stage << " (" << bytes << " bytes, " << instructions << " instructions)";
+	if (sample.scaled)
+	{
+		title << ", scaled from multiplexing";
+	}
+	lines.push_back(title.str());
+
+	for (int i = 0; i < static_cast<int>(Counter::COUNT); i++)
+	{
+		std::stringstream line {};
+		line << std::left << std::setw(16) << COUNTER_NAMES[i] << std::right;
+		if (!sample.counted[i])
+		{
+			line << std::setw(16) << "not counted";
+			lines.push_back(line.str());
+			continue;
+		}
+
+		line << std::setw(16) << sample.values[i] << std::fixed << std::setprecision(3);
+		if (bytes != 0)
+		{
+			line << std::setw(12) << static_cast<double>(sample.values[i]) / bytes << " /byte";
+		}
+		if (instructions != 0)
+		{
+			line << std::setw(12) << static_cast<double>(sample.values[i]) / instructions << " /instruction";
+		}
+		lines.push_back(line.str());
+	}
+
+	const int cycles = static_cast<int>(Counter::CYCLES);
+	const int retired = static_cast<int>(Counter::INSTRUCTIONS);
+	if (sample.counted[cycles] && sample.counted[retired] && sample.values[cycles] != 0)
+	{
+		std::stringstream ipc {};
+		ipc << "IPC " << std::fixed << std::setprecision(3) << static_cast<double>(sample.values[retired]) / sample.values[cycles];
+		lines.push_back(ipc.str());
+	}
+
+	return lines;
+}
+
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Hardware counters read through perf_event_open, one group per measured stage so that
+// the counters cover exactly the same instructions. Only available on Linux, and only
+// where the kernel lets this process count its own events
+
+namespace Perf
+{
+
+enum class Counter : uint8_t
+{
+	CYCLES,
+	INSTRUCTIONS,
+	BRANCH_MISSES,
+	CACHE_MISSES,
+	COUNT
+};
+
+struct Sample
+{
+	uint64_t values[static_cast<int>(Counter::COUNT)] {};
+	bool counted[static_cast<int>(Counter::COUNT)] {}; // Counters the kernel or CPU doesn't support stay false
+	bool scaled {}; // The group was multiplexed with other events and the values are estimates
+};
+
+class Group
+{
+public:
+	Group();
+	~Group();
+
+	Group(const Group &) = delete;
+	Group & operator=(const Group &) = delete;
+
+	// Whether the group opened, otherwise Error() says why
+	bool Available() const { return leader >= 0; }
+	const std::string & Error() const { return error; }
+
+	void Start();
+	Sample Stop();
+
+private:
+	int fds[static_cast<int>(Counter::COUNT)] {-1, -1, -1, -1};
+	int leader {-1};
+	std::string error {};
+};
+
+// Listing of a stage's counters, rated per byte of input and per decoded instruction
+std::vector<std::string> Report(const std::string &stage, const Sample &sample, uint64_t bytes, uint64_t instructions);
+
+};
@@ -0,0 +1,100 @@
+#include <array>
+
+#include "simd.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+void FindBytes(const byte * data, std::size_t size, const std::vector<byte> &needles, std::vector<uint32_t> &positions)
+{
+	std::size_t i = 0;
+
+#ifdef __SSE2__
+	if (!needles.empty() && needles.size() <= MAX_SIMD_NEEDLES)
+	{
+		__m128i splat[MAX_SIMD_NEEDLES];
+		for (unsigned int n = 0; n < needles.size(); n++)
+		{
+			splat[n] = _mm_set1_epi8(static_cast<char>(needles[n]));
+		}
+
+		for (; i + 16 <= size; i += 16)
+		{
+			__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+			__m128i hits = _mm_cmpeq_epi8(chunk, splat[0]);
+			for (unsigned int n = 1; n < needles.size(); n++)
+			{
+				hits = _mm_or_si128(hits, _mm_cmpeq_epi8(chunk, splat[n]));
+			}
+
+			// One bit per matching byte
+			unsigned int mask = _mm_movemask_epi8(hits);
+			while (mask != 0)
+			{
+				positions.push_back(i + __builtin_ctz(mask));
+				mask &= mask - 1;
+			}
+		}
+	}
+#endif
+
+	std::array<bool, 256> isNeedle {};
+	for (auto n : needles)
+	{
+		isNeedle[n] = true;
+	}
+
+	for (; i < size; i++)
+	{
+		if (isNeedle[data[i]])
+		{
+			positions.push_back(i);
+		}
+	}
+}
+
+void ClassifyText(const byte * data, std::size_t size, std::vector<uint64_t> &printable, std::vector<uint64_t> &zero)
+{
+	printable.assign((size + 63) / 64, 0);
+	zero.assign((size + 63) / 64, 0);
+
+	std::size_t i = 0;
+
+#ifdef __SSE2__
+	// Signed compares, so bytes of 0x80 and above are negative and fall outside 0x20-0x7E
+	const __m128i low = _mm_set1_epi8(0x1F);
+	const __m128i high = _mm_set1_epi8(0x7F);
+	const __m128i tab = _mm_set1_epi8('\t');
+	const __m128i newline = _mm_set1_epi8('\n');
+	const __m128i carriage = _mm_set1_epi8('\r');
+	const __m128i null = _mm_setzero_si128();
+
+	for (; i + 16 <= size; i += 16)
+	{
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+		__m128i text = _mm_and_si128(_mm_cmpgt_epi8(chunk, low), _mm_cmplt_epi8(chunk, high));
+		text = _mm_or_si128(text, _mm_cmpeq_epi8(chunk, tab));
+		text = _mm_or_si128(text, _mm_cmpeq_epi8(chunk, newline));
+		text = _mm_or_si128(text, _mm_cmpeq_epi8(chunk, carriage));
+
+		// i is a multiple of 16, so the 16 bits never straddle a word
+		printable[i / 64] |= static_cast<uint64_t>(_mm_movemask_epi8(text)) << (i % 64);
+		zero[i / 64] |= static_cast<uint64_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, null))) << (i % 64);
+	}
+#endif
+
+	for (; i < size; i++)
+	{
+		byte b = data[i];
+		if ((b >= 0x20 && b < 0x7F) || b == '\t' || b == '\n' || b == '\r')
+		{
+			printable[i / 64] |= 1ULL << (i % 64);
+		}
+
+		else if (b == 0)
+		{
+			zero[i / 64] |= 1ULL << (i % 64);
+		}
+	}
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <vector>
+#include <cstddef>
+
+#include "common.h"
+
+// Vectorised byte scans over raw section data. SSE2 is used when the target supports it,
+// otherwise (or for the unaligned tail) a scalar loop gives the same results
+
+// Most needles that FindBytes will compare in vector registers
+const int MAX_SIMD_NEEDLES = 8;
+
+// Appends the offset of every byte equal to one of the needles to positions, in ascending order
+void FindBytes(const byte * data, std::size_t size, const std::vector<byte> &needles, std::vector<uint32_t> &positions);
+
+// Bitmaps with one bit per byte, packed into 64-bit words. Bit i of printable is set for printable
+// ASCII, tab, newline and carriage return, bit i of zero is set for null bytes
+void ClassifyText(const byte * data, std::size_t size, std::vector<uint64_t> &printable, std::vector<uint64_t> &zero);
@@ -0,0 +1,141 @@
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <thread>
+
+#include "trace.h"
+
+namespace Trace
+{
+
+namespace
+{
+
+const uint64_t BUFFER_CAPACITY = 1 << 14; // Spans kept per thread, the oldest are overwritten first
+
+struct Event
+{
+	const char * name {};
+	uint64_t begin {};
+	uint64_t duration {};
+};
+
+struct ThreadBuffer
+{
+	Event events[BUFFER_CAPACITY] {};
+	std::atomic<uint64_t> head {0}; // Spans recorded so far, including overwritten ones
+	uint32_t threadId {};
+	bool main {}; // The thread that enabled tracing
+	ThreadBuffer * next {};
+};
+
+std::atomic<bool> enabled {false};
+std::chrono::steady_clock::time_point epoch {};
+std::thread::id mainThread {};
+
+// Every thread's buffer, pushed on the thread's first span. Buffers are never freed, so that
+// the spans of threads that have exited can still be written
+std::atomic<ThreadBuffer *> buffers {nullptr};
+std::atomic<uint32_t> threadCount {0};
+
+uint64_t Now()
+{
+	// Offset by one so that a span starting at the epoch isn't taken for an inactive one
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count() + 1;
+}
+
+ThreadBuffer & LocalBuffer()
+{
+	thread_local ThreadBuffer * buffer = nullptr;
+	if (buffer == nullptr)
+	{
+		buffer = new ThreadBuffer();
+		buffer->threadId = ++threadCount;
+		buffer->main = std::this_thread::get_id() == mainThread;
+
+		buffer->next = buffers.load(std::memory_order_relaxed);
+		while (!buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed));
+	}
+
+	return *buffer;
+}
+
+};
+
+void Enable()
+{
+	epoch = std::chrono::steady_clock::now();
+	mainThread = std::this_thread::get_id();
+	enabled.store(true, std::memory_order_release);
+}
+
+bool Enabled()
+{
+	return enabled.load(std::memory_order_relaxed);
+}
+
+void Write(const std::string &path)
+{
+	std::ofstream file(path);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("Failed to open trace file " + path);
+	}
+
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"disasm\"}}";
+
+	for (auto buffer = buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next)
+	{
+		file << ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << buffer->threadId;
+		file << ", \"args\": {\"name\": \"" << (buffer->main ? "main" : "worker " + std::to_string(buffer->threadId)) << "\"}}";
+
+		uint64_t head = buffer->head.load(std::memory_order_acquire);
+		uint64_t first = (head > BUFFER_CAPACITY) ? head - BUFFER_CAPACITY : 0;
+
+		// Timestamps are in microseconds, and the complete ("X") events nest by time
+		for (uint64_t i = first; i < head; i++)
+		{
+			const Event &event = buffer->events[i % BUFFER_CAPACITY];
+			file << ",\n{\"name\": \"" << event.name << "\", \"cat\": \"disasm\", \"ph\": \"X\", \"pid\": 1, \"tid\": " << buffer->threadId;
+			file << ", \"ts\": " << (event.begin - 1) / 1000.0 << ", \"dur\": " << event.duration / 1000.0 << "}";
+		}
+	}
+
+	file << "\n]}\n";
+	if (file.fail())
+	{
+		throw std::runtime_error("Failed to write trace file " + path);
+	}
+}
+
+// ***** Span *****
+Span::Span(const char * name)
+	: name(name)
+{
+	if (enabled.load(std::memory_order_relaxed))
+	{
+		begin = Now();
+	}
+}
+
+Span::~Span()
+{
+	if (begin == 0)
+	{
+		return;
+	}
+
+	uint64_t end = Now();
+	ThreadBuffer &buffer = LocalBuffer();
+
+	// Only this thread writes to its buffer, so the head just has to be published after the event
+	uint64_t head = buffer.head.load(std::memory_order_relaxed);
+	buffer.events[head % BUFFER_CAPACITY] = {name, begin, end - begin};
+	buffer.head.store(head + 1, std::memory_order_release);
+}
+
+};
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+// Scoped timing spans of the pipeline stages, written out as Chrome trace-event JSON for
+// Perfetto or about:tracing. Each thread records into its own ring buffer without locking,
+// and when tracing is off a span costs one flag check
+
+namespace Trace
+{
+
+// Starts recording, with timestamps taken relative to this call
+void Enable();
+bool Enabled();
+
+// Writes every thread's spans to the file. Only call once the traced threads have finished
+void Write(const std::string &path);
+
+class Span
+{
+public:
+	// The name must outlive the trace, which string literals do
+	explicit Span(const char * name);
+	~Span();
+
+	Span(const Span &) = delete;
+	Span & operator=(const Span &) = delete;
+
+private:
+	const char * name {};
+	uint64_t begin {}; // Nanoseconds since Enable, 0 when not recording
+};
+
+};
+
+#define TRACE_SPAN_NAME(line) traceSpan##line
+#define TRACE_SPAN_LINE(name, line) Trace::Span TRACE_SPAN_NAME(line)(name)
+// Records the rest of the enclosing scope as a span with the given name
+#define TRACE_SPAN(name) TRACE_SPAN_LINE(name, __LINE__)
@@ -11,6 +11,8 @@ ByteSequence::ByteSequence(const std::vector<byte> * binDump, unsigned long long
 
 std::string ByteSequence::ReadString(int size)
 {
+	CheckRead(size);
+
 	std::string out {};
 	for (int i = 0; i < size; i++)
 	{
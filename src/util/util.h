@@ -1,3 +1,6 @@
+#pragma once
+
+#include <stdexcept>
 #include <vector>
 
 #include "common.h"
@@ -11,12 +14,14 @@ public:
 	template <typename T>
 	T ReadBytes()
 	{
+		CheckRead(sizeof(T));
+
 		T ret = 0;
 		if (endianness == EndType::LSB)
 		{
 			for (unsigned int i = 0; i < sizeof(T); i++)	
 			{
-				T a = ((*binDump)[offset + i] << (8 * i)); 	
+				T a = (static_cast<T>((*binDump)[offset + i]) << (8 * i));	
 				ret += a;
 			}
 		}
@@ -33,6 +38,15 @@ public:
 	std::string ReadString(int size);
 
 private:
+	// Throws if size bytes from the offset run past the end of the file
+	void CheckRead(unsigned long long size) const
+	{
+		if (offset > binDump->size() || size > binDump->size() - offset)
+		{
+			throw std::runtime_error("Read past the end of the file");
+		}
+	}
+
 	EndType endianness;	
 	const std::vector<byte> * binDump;
 
@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "disasm.h"
+
+static int failures = 0;
+
+static void Check(int condition, const char * what)
+{
+	if (!condition)
+	{
+		fprintf(stderr, "FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+static void Put16(unsigned char * p, unsigned int value)
+{
+	p[0] = value & 0xFF;
+	p[1] = (value >> 8) & 0xFF;
+}
+
+static void Put32(unsigned char * p, unsigned long value)
+{
+	Put16(p, value & 0xFFFF);
+	Put16(p + 2, (value >> 16) & 0xFFFF);
+}
+
+/* A 32-bit ELF with a four byte .text at 52, its section names at 56 and three section
+ * headers (null, .text and .shstrtab) at 76 */
+#define ELF_SIZE 196
+#define ELF_SHOFF 76
+#define ELF_SHENTSIZE 40
+
+static void BuildELF(unsigned char * elf)
+{
+	static const unsigned char code[] = {0x90, 0x90, 0x90, 0xC3};
+	static const char names[] = "\0.text\0.shstrtab";
+	unsigned char * sh = NULL;
+
+	memset(elf, 0, ELF_SIZE);
+	memcpy(elf, "\x7F" "ELF", 4);
+	elf[4] = 1; /* ELFCLASS32 */
+	elf[5] = 1; /* ELFDATA2LSB */
+	elf[6] = 1;
+	Put16(elf + 16, 2); /* ET_EXEC */
+	Put16(elf + 18, 3); /* EM_386 */
+	Put32(elf + 20, 1);
+	Put32(elf + 24, 0x8049000);
+	Put32(elf + 32, ELF_SHOFF);
+	Put16(elf + 40, 52);
+	Put16(elf + 46, ELF_SHENTSIZE);
+	Put16(elf + 48, 3);
+	Put16(elf + 50, 2);
+
+	memcpy(elf + 52, code, sizeof(code));
+	memcpy(elf + 56, names, sizeof(names));
+
+	sh = elf + ELF_SHOFF + ELF_SHENTSIZE;
+	Put32(sh, 1);
+	Put32(sh + 4, 1); /* SHT_PROGBITS */
+	Put32(sh + 8, 6); /* SHF_ALLOC | SHF_EXECINSTR */
+	Put32(sh + 12, 0x8049000);
+	Put32(sh + 16, 52);
+	Put32(sh + 20, sizeof(code));
+
+	sh += ELF_SHENTSIZE;
+	Put32(sh, 7);
+	Put32(sh + 4, 3); /* SHT_STRTAB */
+	Put32(sh + 16, 56);
+	Put32(sh + 20, sizeof(names));
+}
+
+static disasm_status Open(const unsigned char * data, size_t size)
+{
+	disasm_image * image = NULL;
+	disasm_status status = disasm_image_open(data, size, &image);
+	Check((status == DISASM_OK) == (image != NULL), "an image is returned only on success");
+	disasm_image_close(image);
+	return status;
+}
+
+/* ***** ELF ***** */
+static void TestELF(void)
+{
+	unsigned char elf[ELF_SIZE];
+	unsigned char bad[ELF_SIZE];
+	disasm_image * image = NULL;
+	disasm_instruction instrs[8];
+	size_t count = 0;
+	size_t size = 0;
+
+	BuildELF(elf);
+	Check(disasm_image_open(elf, ELF_SIZE, &image) == DISASM_OK, "elf: the well formed image opens");
+	Check(disasm_decode(image, 0, 0, instrs, 8, &count) == DISASM_OK && count == 4, "elf: its code decodes");
+	disasm_image_close(image);
+
+	/* Every truncation runs out inside a header or a section */
+	for (size = 0; size < ELF_SIZE; size++)
+	{
+		Check(Open(elf, size) == DISASM_ERROR_FORMAT, "elf: a truncated image is a format error");
+	}
+
+	memcpy(bad, elf, ELF_SIZE);
+	Put32(bad + 32, 0xFFFFFFF0);
+	Check(Open(bad, ELF_SIZE) == DISASM_ERROR_FORMAT, "elf: section headers past the end");
+
+	memcpy(bad, elf, ELF_SIZE);
+	Put16(bad + 50, 7);
+	Check(Open(bad, ELF_SIZE) == DISASM_ERROR_FORMAT, "elf: string table index out of range");
+
+	memcpy(bad, elf, ELF_SIZE);
+	Put32(bad + ELF_SHOFF + ELF_SHENTSIZE + 20, 0x7FFFFFFF);
+	Check(Open(bad, ELF_SIZE) == DISASM_ERROR_FORMAT, "elf: section running past the end");
+
+	memcpy(bad, elf, ELF_SIZE);
+	Put32(bad + ELF_SHOFF + ELF_SHENTSIZE, 0xFFFFFF00);
+	Check(Open(bad, ELF_SIZE) == DISASM_ERROR_FORMAT, "elf: section name outside the file");
+
+	memcpy(bad, elf, ELF_SIZE);
+	bad[4] = 9;
+	Check(Open(bad, ELF_SIZE) == DISASM_ERROR_FORMAT, "elf: unknown class");
+}
+
+/* ***** PE ***** */
+static void TestPE(void)
+{
+	unsigned char pe[0x80];
+
+	memset(pe, 0, sizeof(pe));
+	pe[0] = 'M';
+	pe[1] = 'Z';
+	Check(Open(pe, 2) == DISASM_ERROR_FORMAT, "pe: only the magic");
+	Check(Open(pe, 0x3C) == DISASM_ERROR_FORMAT, "pe: no header offset");
+
+	/* A COFF header without an optional header is an object file, not an image */
+	pe[0x3C] = 0x40;
+	memcpy(pe + 0x40, "PE\0\0", 4);
+	Put16(pe + 0x44, 0x14C);
+	Put16(pe + 0x46, 1);
+	Check(Open(pe, sizeof(pe)) == DISASM_ERROR_FORMAT, "pe: object file");
+	Check(Open(pe, 0x48) == DISASM_ERROR_FORMAT, "pe: truncated COFF header");
+}
+
+/* ***** Decoding ***** */
+static void TestPrefixRun(void)
+{
+	unsigned char code[24];
+	disasm_image * image = NULL;
+	disasm_instruction instrs[8];
+	size_t count = 0;
+
+	memset(code, 0x66, sizeof(code));
+	code[sizeof(code) - 2] = 0x90;
+	code[sizeof(code) - 1] = 0xC3;
+
+	Check(disasm_image_open_raw(code, sizeof(code), 0x1000, &image) == DISASM_OK, "prefix run: raw image opens");
+	Check(disasm_decode(image, 0, 0, instrs, 8, &count) == DISASM_OK && count > 0 && instrs[0].size == 15, "prefix run: decodes");
+	disasm_image_close(image);
+}
+
+static void TestOther(void)
+{
+	static const unsigned char text[] = "not an executable";
+	disasm_image * image = NULL;
+
+	Check(Open(text, 0) == DISASM_ERROR_FORMAT, "empty buffer");
+	Check(Open(text, 3) == DISASM_ERROR_FORMAT, "short buffer");
+	Check(Open(text, sizeof(text)) == DISASM_ERROR_FORMAT, "text buffer");
+	Check(disasm_image_open(NULL, 4, &image) == DISASM_ERROR_ARGUMENT, "null buffer");
+}
+
+int main(int argc, const char * argv[])
+{
+	if (disasm_init(argc > 1 ? argv[1] : NULL) != DISASM_OK)
+	{
+		fprintf(stderr, "FAILED: disasm_init\n");
+		return EXIT_FAILURE;
+	}
+
+	TestELF();
+	TestPE();
+	TestPrefixRun();
+	TestOther();
+
+	if (failures > 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	printf("capi_test passed\n");
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,94 @@
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../src/arch/x86/context.h"
+#include "../src/arch/x86/decode.h"
+
+using namespace ISet_x86;
+
+namespace
+{
+
+int failures = 0;
+
+void Check(bool condition, const std::string &what)
+{
+	if (!condition)
+	{
+		std::cerr << "FAILED: " << what << '\n';
+		failures++;
+	}
+}
+
+// ***** Truncated instruction *****
+// A nop followed by the first byte of a two-byte opcode, which the section ends inside
+void TestTruncated(const DecoderContext &context)
+{
+	std::vector<byte> section = {0x90, 0x0F};
+	auto decoder = LinearDecoder(&section, 0, section.size(), context);
+	auto instrs = decoder.DecodeSection();
+
+	Check(!instrs.empty() && instrs[0].attrib.flags.resolved && instrs[0].attrib.runtime.size == 1, "truncated: the nop is decoded");
+
+#ifdef DISASM_COUNTERS
+	auto &counters = decoder.Counters();
+	Check(counters.entries[static_cast<int>(DecoderState::END_OF_SEGMENT)] == 1, "truncated: the end of the segment is counted once");
+	Check(counters.events[static_cast<int>(DecoderEvent::TRUNCATED)] == 1, "truncated: the cut off instruction is counted");
+
+	// A section that ends between instructions isn't truncated
+	std::vector<byte> whole = {0x90, 0xC3};
+	auto wholeDecoder = LinearDecoder(&whole, 0, whole.size(), context);
+	wholeDecoder.DecodeSection();
+	Check(wholeDecoder.Counters().events[static_cast<int>(DecoderEvent::TRUNCATED)] == 0, "truncated: a whole section isn't counted");
+#endif
+}
+
+// ***** Prefix runs *****
+// More prefixes than an instruction keeps, and more than fit in one at all
+void TestPrefixRun(const DecoderContext &context)
+{
+	std::vector<byte> section = {0x66, 0x66, 0x66, 0x66, 0x66, 0x66, 0xF3, 0x90, 0xC3};
+	auto decoder = LinearDecoder(&section, 0, section.size(), context);
+	auto instrs = decoder.DecodeSection();
+
+	Check(instrs.size() == 2, "prefix run: two instructions");
+	Check(instrs.size() == 2 && instrs[0].attrib.runtime.size == 8 && instrs[0].attrib.runtime.prefixCount == 7, "prefix run: every prefix is counted");
+	Check(instrs.size() == 2 && instrs[1].attrib.runtime.segmentByteOffset == 8 && instrs[1].attrib.flags.resolved, "prefix run: the ret after it decodes");
+
+	std::vector<byte> overlong(20, 0x66);
+	overlong.push_back(0x90);
+	auto overlongDecoder = LinearDecoder(&overlong, 0, overlong.size(), context);
+	auto overlongInstrs = overlongDecoder.DecodeSection();
+
+	Check(!overlongInstrs.empty() && !overlongInstrs[0].attrib.flags.resolved && overlongInstrs[0].attrib.runtime.size == MAX_INSTRUCTION_SIZE,
+		"prefix run: fifteen prefixes fail as one instruction");
+
+	unsigned int covered = 0;
+	for (auto &instr : overlongInstrs)
+	{
+		Check(instr.attrib.runtime.segmentByteOffset == covered && instr.attrib.runtime.size <= MAX_INSTRUCTION_SIZE, "prefix run: instructions follow on");
+		covered += instr.attrib.runtime.size;
+	}
+	Check(covered == overlong.size(), "prefix run: every byte is decoded");
+}
+
+};
+
+int main(int argc, const char * argv[])
+{
+	std::string dataPath = (argc > 1) ? std::string(argv[1]) + "/" : DATA_PATH;
+	DecoderContext context(dataPath);
+
+	TestTruncated(context);
+	TestPrefixRun(context);
+
+	if (failures > 0)
+	{
+		return EXIT_FAILURE;
+	}
+
+	std::cout << "decode_test passed" << '\n';
+	return EXIT_SUCCESS;
+}